@@ -0,0 +1,97 @@
+#!/bin/bash
+
+#
+# Argon2 source code package
+#
+# This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+#
+# You should have received a copy of the CC0 Public Domain Dedication along with
+# this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+#
+
+# Multi-version KAT matrix: validates every in-tree generation in one
+# parallel run -
+#   Source/C++11  via the native in-process check against TestVectors/
+#                 (ref and default kernels)
+#   v.1.1, v.1.2  via a shared deterministic driver (the legacy genkat mains
+#                 disagree about their no-argument behavior) compared against
+#                 golden files in TestVectors/legacy/; a missing golden is
+#                 created from the current output and reported as BASELINE.
+# Exit status is nonzero when anything diverges, so the whole matrix fits in
+# a pre-commit check.
+
+script_path=$(dirname "$0")
+cd "$script_path/.." || exit 1
+ROOT=$(pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+GOLDEN_DIR=$ROOT/TestVectors/legacy
+mkdir -p "$GOLDEN_DIR"
+
+declare -A results
+
+# --- current tree (built serially; the legacy jobs then run in parallel) ---
+(
+    cd Source/C++11 || exit 1
+    make all > "$WORK/build-current.log" 2>&1 || exit 1
+    cd "$ROOT/Build" || exit 1
+    ARGON2_KERNEL=ref ./argon2-kat check ../TestVectors > "$WORK/current-ref.log" 2>&1 || exit 1
+    ./argon2-kat check ../TestVectors > "$WORK/current-opt.log" 2>&1 || exit 1
+) &
+current_pid=$!
+
+# --- legacy variants, one driver process each ---
+legacy_variant() { # name srcdir core entry header [t_cost]
+    local name=$1 srcdir=$2 core=$3 entry=$4 header=$5 t_cost=${6:-3}
+    local bin=$WORK/$name
+    g++ -std=c++11 -pthread -O2 -I "$srcdir" \
+        -DLEGACY_HEADER="\"$header\"" -DLEGACY_ENTRY=$entry -DLEGACY_T_COST=$t_cost \
+        "$srcdir/$core" "$srcdir/blake2b-ref.cpp" Scripts/legacy_kat_driver.cpp \
+        -o "$bin" > "$WORK/build-$name.log" 2>&1 || { echo BUILDFAIL > "$WORK/$name.status"; return; }
+    "$bin" > "$WORK/$name.out" 2>/dev/null
+    if grep -q "rc=-\|rc=[1-9]" "$WORK/$name.out"; then
+        # A golden full of error codes certifies nothing: refuse to baseline
+        # or pass a run in which any grid point failed to hash
+        grep "rc=" "$WORK/$name.out" | head -2 > "$WORK/$name.diff"
+        echo BADRC > "$WORK/$name.status"
+    elif [ ! -f "$GOLDEN_DIR/$name.txt" ]; then
+        cp "$WORK/$name.out" "$GOLDEN_DIR/$name.txt"
+        echo BASELINE > "$WORK/$name.status"
+    elif cmp -s "$WORK/$name.out" "$GOLDEN_DIR/$name.txt"; then
+        echo PASS > "$WORK/$name.status"
+    else
+        diff "$GOLDEN_DIR/$name.txt" "$WORK/$name.out" > "$WORK/$name.diff"
+        echo FAIL > "$WORK/$name.status"
+    fi
+}
+
+legacy_variant v1.1-argon2d v.1.1/Argon2d/ref argon2d-ref.cpp Argon2dRef argon2d.h &
+legacy_variant v1.1-argon2i v.1.1/Argon2i/ref argon2i-ref.cpp Argon2iRef argon2i.h &
+# v1.2 Argon2d accepts only t_cost=1 (TOO_LARGE_TIME otherwise)
+legacy_variant v1.2-argon2d v.1.2/v.1.2/Argon2d/ref argon2d-ref.cpp Argon2d argon2d.h 1 &
+legacy_variant v1.2-argon2i v.1.2/v.1.2/Argon2i/ref argon2i-ref.cpp Argon2i argon2i.h &
+wait %2 %3 %4 %5 2>/dev/null
+wait $current_pid
+current_rc=$?
+
+# --- consolidated report ---
+failures=0
+if [ 0 -eq $current_rc ]; then
+    echo "current (ref+default kernels): PASS"
+else
+    echo "current (ref+default kernels): FAIL"
+    tail -5 "$WORK"/current-*.log "$WORK/build-current.log" 2>/dev/null
+    failures=$((failures + 1))
+fi
+for name in v1.1-argon2d v1.1-argon2i v1.2-argon2d v1.2-argon2i; do
+    status=$(cat "$WORK/$name.status" 2>/dev/null || echo MISSING)
+    echo "$name: $status"
+    if [ "$status" = "FAIL" ] || [ "$status" = "BADRC" ]; then
+        head -4 "$WORK/$name.diff"
+        failures=$((failures + 1))
+    elif [ "$status" = "BUILDFAIL" ] || [ "$status" = "MISSING" ]; then
+        tail -3 "$WORK/build-$name.log" 2>/dev/null
+        failures=$((failures + 1))
+    fi
+done
+exit $failures
@@ -58,6 +58,13 @@ for implementation in ${ARGON2_IMPLEMENTATIONS[@]}
 do
 	echo "Test for $implementation"
 
+	# One binary carries every kernel now; pick it per phase at runtime
+	if [ "REF" == "$implementation" ] ; then
+		export ARGON2_KERNEL=ref
+	else
+		unset ARGON2_KERNEL
+	fi
+
 	make_log=$OUTPUT_PATH"make_"$implementation".log"
 	rm -f $make_log
 
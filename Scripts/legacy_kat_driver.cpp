@@ -0,0 +1,54 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/*
+ * Shared KAT driver for the legacy trees (check_all_versions.sh compiles it
+ * once per variant): calls the tree's public entry over a fixed parameter
+ * grid and prints one tag line per point. The legacy genkat mains disagree
+ * about what "no arguments" means, so the matrix tool brings its own
+ * deterministic driver instead. Compile with
+ *   -DLEGACY_HEADER='"argon2d.h"' -DLEGACY_ENTRY=Argon2dRef
+ * LEGACY_T_COST overrides the pass count for trees that restrict it
+ * (v1.2 Argon2d accepts only t_cost=1).
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include LEGACY_HEADER
+
+#ifndef LEGACY_T_COST
+#define LEGACY_T_COST 3
+#endif
+
+int main(void) {
+    uint8_t pwd[32];
+    uint8_t salt[16];
+    memset(pwd, 1, sizeof (pwd));
+    memset(salt, 2, sizeof (salt));
+
+    const uint32_t m_costs[3] = {64, 256, 1024};
+    const uint8_t lane_counts[2] = {1, 4};
+    for (int mi = 0; mi < 3; ++mi) {
+        for (int li = 0; li < 2; ++li) {
+            uint8_t out[32];
+            memset(out, 0, sizeof (out));
+            int rc = LEGACY_ENTRY(out, (uint32_t) sizeof (out),
+                    pwd, (uint32_t) sizeof (pwd), salt, (uint32_t) sizeof (salt),
+                    NULL, 0, NULL, 0, LEGACY_T_COST, m_costs[mi], lane_counts[li]);
+            printf("m=%u lanes=%u rc=%d tag=", m_costs[mi], lane_counts[li], rc);
+            for (unsigned i = 0; i < sizeof (out); ++i) {
+                printf("%02x", out[i]);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
@@ -13,172 +13,1616 @@
 
 // #include <inttypes.h>
 #include <cinttypes>
+#include <cstdlib>
+#if defined(_WIN32)
+#include <malloc.h>
+#include "windows.h" //GlobalMemoryStatusEx for the preflight probe
+#else
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#include <atomic>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <thread>
 #include <cstring>
 
 #include "argon2.h"
 #include "argon2-core.h"
+#include "argon2-threads.h"
 #include "kat.h"
 
 #include "../Blake2/blake2.h"
 #include "../Blake2/blake2-impl.h"
 
 
-block operator^(const block& l, const block& r) {
-    block a = l;
-    a ^= r;
-    return a;
+
+/*
+ * Process-wide recycling of block arrays: retired arrays are parked on a
+ * lock-free freelist bucketed by size instead of going back to the heap.
+ * Multi-tenant servers hash with a handful of distinct m_cost values, so a
+ * request usually gets back warm, already-faulted, already-TLB-mapped memory
+ * and pass 0 skips the kernel zero-page fault storm entirely.
+ *
+ * Every array from AllocateMemory() is preceded by a hidden header block that
+ * records its size and doubles as the freelist link while the array is
+ * retired. Pops take the whole chain with one exchange (no ABA), pushes are a
+ * plain CAS loop.
+ */
+struct Argon2ArrayHeader {
+    uint64_t magic; //identifies arrays that carry a header
+    uint32_t m_cost; //number of usable blocks following the header
+    Argon2ArrayHeader *next; //freelist link while retired
+};
+
+static const uint64_t ARGON2_ARRAY_MAGIC = UINT64_C(0xA260272C0FFEB10C);
+
+/*
+ * new[] cannot over-align a type before C++17, so the block arrays come from
+ * the aligned allocator of the platform. The alignment matches alignas(block).
+ */
+static block* AlignedBlockAlloc(size_t count) {
+#if defined(_WIN32)
+    return (block*) _aligned_malloc(count * ARGON2_BLOCK_SIZE, alignof(block));
+#else
+    void* region = NULL;
+    if (posix_memalign(&region, alignof(block), count * ARGON2_BLOCK_SIZE) != 0) {
+        return NULL;
+    }
+    return (block*) region;
+#endif
 }
 
-int AllocateMemory(block **memory, uint32_t m_cost) {
+static void AlignedBlockFree(block* base) {
+#if defined(_WIN32)
+    _aligned_free(base);
+#else
+    free(base);
+#endif
+}
+static const uint32_t ARGON2_RECYCLE_BUCKETS = 8;
+static const uint32_t ARGON2_RECYCLE_DEPTH = 2; //arrays kept per bucket
+
+static std::atomic<Argon2ArrayHeader*> recycle_heads[ARGON2_RECYCLE_BUCKETS];
+static std::atomic<uint32_t> recycle_depths[ARGON2_RECYCLE_BUCKETS];
+
+static uint32_t RecycleBucket(uint32_t m_cost) {
+    return (m_cost * UINT32_C(2654435761)) >> 29; //Fibonacci mix into 8 buckets
+}
+
+/* Marks arrays living in a file-backed (disk-spill) mapping */
+static const uint64_t ARGON2_SPILL_MAGIC = UINT64_C(0xA260272C0FFED15C);
+
+static std::mutex spill_dir_mutex;
+static std::string spill_dir; //empty = spill disabled
+
+void Argon2SetSpillDirectory(const char* path) {
+    std::unique_lock<std::mutex> lock(spill_dir_mutex);
+    spill_dir = (path != NULL) ? path : "";
+}
+
+/*
+ * Last-resort allocation into an unlinked file in the spill directory. The
+ * kernel pages blocks in and out at the backing device's bandwidth; the
+ * mapping is advised for random access since the ref_block walk dominates.
+ */
+static block* SpillFileAlloc(size_t count) {
+#if defined(_WIN32)
+    (void) count;
+    return NULL;
+#else
+    std::string dir;
+    {
+        std::unique_lock<std::mutex> lock(spill_dir_mutex);
+        dir = spill_dir;
+    }
+    if (dir.empty()) {
+        return NULL;
+    }
+    std::string path = dir + "/argon2-spill-XXXXXX";
+    std::vector<char> path_buffer(path.begin(), path.end());
+    path_buffer.push_back('\0');
+    int fd = mkstemp(&path_buffer[0]);
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(&path_buffer[0]); //the mapping keeps the file alive, nobody else sees it
+    size_t bytes = count * ARGON2_BLOCK_SIZE;
+    if (ftruncate(fd, (off_t) bytes) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void* region = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); //the mapping holds its own reference
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+#ifdef MADV_RANDOM
+    madvise(region, bytes, MADV_RANDOM);
+#endif
+    return (block*) region;
+#endif
+}
+
+/*
+ * Process-wide memory quota: bounds the block-array bytes of concurrently
+ * running hashes so a burst of large verifications queues (or fails fast)
+ * instead of page-fault-storming the host into the ground. Charged when an
+ * array is handed to a hash, credited when the hash returns it.
+ */
+static std::mutex quota_mutex;
+static std::condition_variable quota_cv;
+static size_t quota_limit = 0; //0 = unlimited
+static size_t quota_used = 0;
+static bool quota_wait = false;
+
+void Argon2SetMemoryQuota(size_t max_bytes, bool wait) {
+    {
+        std::unique_lock<std::mutex> lock(quota_mutex);
+        quota_limit = max_bytes;
+        quota_wait = wait;
+    }
+    quota_cv.notify_all();
+}
+
+static int QuotaCharge(size_t bytes) {
+    std::unique_lock<std::mutex> lock(quota_mutex);
+    quota_used += bytes;
+    if (quota_limit == 0) {
+        return ARGON2_OK;
+    }
+    if (bytes > quota_limit) {
+        quota_used -= bytes; //can never fit, regardless of waiting
+        return ARGON2_MEMORY_QUOTA_EXCEEDED;
+    }
+    if (quota_used <= quota_limit) {
+        return ARGON2_OK;
+    }
+    if (!quota_wait) {
+        quota_used -= bytes;
+        return ARGON2_MEMORY_QUOTA_EXCEEDED;
+    }
+    quota_used -= bytes;
+    while (quota_used + bytes > quota_limit && quota_limit != 0) {
+        quota_cv.wait(lock);
+    }
+    quota_used += bytes;
+    return ARGON2_OK;
+}
+
+static void QuotaCredit(size_t bytes) {
+    {
+        std::unique_lock<std::mutex> lock(quota_mutex);
+        quota_used -= (bytes < quota_used) ? bytes : quota_used;
+    }
+    quota_cv.notify_all();
+}
+
+/*
+ * Checkpoint/resume for very large hashes: at slice boundaries the whole
+ * block array plus progress is streamed to disk, so a crash mid-way through a
+ * multi-minute KDF resumes instead of restarting. The snapshot binds to its
+ * parameters through a digest of H0, so a resume with the wrong password or
+ * costs is rejected instead of producing a wrong tag. Snapshots contain
+ * password-derived material - protect them like the memory itself.
+ */
+static std::mutex checkpoint_mutex;
+static std::string checkpoint_path;
+static uint32_t checkpoint_interval = 0; //slices between snapshots
+
+void Argon2SetCheckpoint(const char* path, uint32_t interval_slices) {
+    std::unique_lock<std::mutex> lock(checkpoint_mutex);
+    checkpoint_path = (path != NULL) ? path : "";
+    checkpoint_interval = (interval_slices != 0) ? interval_slices : 1;
+}
+
+static bool CheckpointEnabled() {
+    std::unique_lock<std::mutex> lock(checkpoint_mutex);
+    return !checkpoint_path.empty();
+}
+
+static const char ARGON2_CHECKPOINT_MAGIC[8] = {'A', 'r', 'g', 'o', 'n', 'C', 'P', '1'};
+
+/*
+ * Streams a snapshot to <path>.tmp and renames it into place, so a crash
+ * mid-write leaves the previous snapshot intact. Failures are swallowed: a
+ * missed checkpoint costs resume granularity, not the hash.
+ */
+static void WriteCheckpoint(Argon2_instance_t* instance, uint32_t next_pass, uint32_t next_slice) {
+    std::string path;
+    {
+        std::unique_lock<std::mutex> lock(checkpoint_mutex);
+        path = checkpoint_path;
+    }
+    if (path.empty()) {
+        return;
+    }
+    std::string tmp = path + ".tmp";
+    // Owner-only permissions: the payload is password-equivalent material
+#if defined(_WIN32)
+    FILE* f = fopen(tmp.c_str(), "wb");
+#else
+    FILE* f = NULL;
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0) {
+        f = fdopen(fd, "wb");
+        if (f == NULL) {
+            close(fd);
+        }
+    }
+#endif
+    if (f == NULL) {
+        return;
+    }
+    uint8_t header[8 + 6 * 4 + 32];
+    memcpy(header, ARGON2_CHECKPOINT_MAGIC, 8);
+    store32(header + 8, (uint32_t) instance->type);
+    store32(header + 12, instance->passes);
+    store32(header + 16, instance->memory_blocks);
+    store32(header + 20, instance->lanes);
+    store32(header + 24, next_pass);
+    store32(header + 28, next_slice);
+    memcpy(header + 32, instance->checkpoint_digest, 32);
+    bool ok = fwrite(header, sizeof (header), 1, f) == 1;
+    for (uint32_t i = 0; ok && i < instance->memory_blocks; ++i) {
+        ok = fwrite(instance->BlockAt(i)->v, ARGON2_BLOCK_SIZE, 1, f) == 1;
+    }
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+    }
+}
+
+/* Adds a completed slice's cycles into the opt-in stats sink (passes beyond
+ * the cap fold into the last slot so long KDFs still account every cycle) */
+static void RecordSliceCycles(Argon2_instance_t* instance, uint32_t pass, uint32_t slice, uint64_t cycles) {
+    if (instance->stats == NULL) {
+        return;
+    }
+    uint32_t slot = (pass < ARGON2_STATS_MAX_PASSES) ? pass : ARGON2_STATS_MAX_PASSES - 1;
+    instance->stats->pass_cycles[slot] += cycles;
+    instance->stats->slice_cycles[slot][slice % ARGON2_SYNC_POINTS] += cycles;
+}
+
+/* Called at each completed slice; snapshots every checkpoint_interval slices */
+static void MaybeCheckpoint(Argon2_instance_t* instance, uint32_t pass, uint32_t completed_slice) {
+    uint32_t interval;
+    {
+        std::unique_lock<std::mutex> lock(checkpoint_mutex);
+        if (checkpoint_path.empty()) {
+            return;
+        }
+        interval = checkpoint_interval;
+    }
+    if (++instance->checkpoint_slices < interval) {
+        return;
+    }
+    instance->checkpoint_slices = 0;
+    uint32_t next_pass = pass;
+    uint32_t next_slice = completed_slice + 1;
+    if (next_slice == ARGON2_SYNC_POINTS) {
+        next_slice = 0;
+        ++next_pass;
+    }
+    if (next_pass >= instance->passes) {
+        return; //the hash is done; nothing left worth resuming
+    }
+    WriteCheckpoint(instance, next_pass, next_slice);
+}
+
+/*
+ * Adaptive degradation: when the host is under memory pressure, new hashing
+ * requests step their m_cost down toward a configured floor instead of
+ * swapping the box - verification is never degraded (stored hashes fix their
+ * own parameters). Pressure is read from two signals: the OS available-
+ * memory figure (the hash should fit with headroom left), and an EWMA of
+ * recent block-array allocation latency, which spikes when the kernel is
+ * reclaiming. The caller stores the actual parameters via the encoded hash.
+ */
+static std::atomic<uint32_t> degradation_floor(0); //0 = disabled
+static std::atomic<uint64_t> allocation_latency_ewma_us(0);
+
+void Argon2SetDegradationFloor(uint32_t floor_m_cost) {
+    degradation_floor.store(floor_m_cost);
+}
+
+static void RecordAllocationLatency(uint64_t microseconds) {
+    // EWMA with 1/8 weight, updated lock-free (losing a racing update is fine)
+    uint64_t previous = allocation_latency_ewma_us.load(std::memory_order_relaxed);
+    uint64_t next = previous - previous / 8 + microseconds / 8;
+    allocation_latency_ewma_us.store(next, std::memory_order_relaxed);
+}
+
+uint32_t Argon2NegotiateMCost(uint32_t m_cost, uint32_t lanes) {
+    uint32_t floor_m = degradation_floor.load();
+    if (floor_m == 0 || m_cost <= floor_m) {
+        return m_cost;
+    }
+    // Latency signal: sustained slow allocations mean the kernel is already
+    // reclaiming; one halving step per call keeps the response proportionate
+    bool reclaiming = allocation_latency_ewma_us.load(std::memory_order_relaxed)
+            > 20000; //20 ms of allocation latency is reclaim, not malloc
+    uint32_t negotiated = m_cost;
+    while (negotiated > floor_m) {
+        // Preflight at 2x: the hash should fit with headroom left, not
+        // consume the last free byte. Saturate the doubling - m_cost can sit
+        // in the top half of uint32 and a wrapped probe would always pass.
+        uint32_t probe = (negotiated > UINT32_MAX / 2) ? UINT32_MAX : negotiated * 2;
+        if (!reclaiming && ARGON2_OK == Argon2Preflight(probe, lanes)) {
+            break;
+        }
+        negotiated /= 2;
+        reclaiming = false; //latency alone steps down once, not to the floor
+    }
+    return (negotiated > floor_m) ? negotiated : floor_m;
+}
+
+int Argon2Preflight(uint32_t m_cost, uint32_t lanes) {
+    if (lanes == 0) {
+        lanes = 1;
+    }
+    // Same geometry minimum as Argon2Core(); alignment only rounds down
+    uint32_t memory_blocks = m_cost;
+    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * lanes) {
+        memory_blocks = 2 * ARGON2_SYNC_POINTS * lanes;
+    }
+    size_t bytes = (size_t) memory_blocks * ARGON2_BLOCK_SIZE;
+
+    // Quota headroom: peek only - never charges, never waits, so a rejected
+    // probe has zero effect on running hashes
+    {
+        std::unique_lock<std::mutex> lock(quota_mutex);
+        if (quota_limit != 0
+                && (bytes > quota_limit || quota_used + bytes > quota_limit)) {
+            return ARGON2_MEMORY_QUOTA_EXCEEDED;
+        }
+    }
+
+    // OS headroom: MemAvailable accounts for reclaimable caches, which is the
+    // overcommit-aware number - a plain malloc would "succeed" and then drive
+    // the box into reclaim on first touch
+#if defined(_WIN32)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof (status);
+    if (GlobalMemoryStatusEx(&status) && bytes > status.ullAvailPhys) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+#else
+    FILE* meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo != NULL) {
+        char line[128];
+        unsigned long long available_kb = 0;
+        while (fgets(line, sizeof (line), meminfo) != NULL) {
+            if (1 == sscanf(line, "MemAvailable: %llu kB", &available_kb)) {
+                break;
+            }
+        }
+        fclose(meminfo);
+        if (available_kb != 0 && bytes > available_kb * 1024) {
+            return ARGON2_MEMORY_ALLOCATION_ERROR;
+        }
+    }
+#endif
+    return ARGON2_OK;
+}
+
+static void RecyclePush(uint32_t bucket, Argon2ArrayHeader* node) {
+    Argon2ArrayHeader* head = recycle_heads[bucket].load();
+    do {
+        node->next = head;
+    } while (!recycle_heads[bucket].compare_exchange_weak(head, node));
+}
+
+static int AllocateMemoryImpl(block **memory, uint32_t m_cost, bool charge_quota) {
     if (memory == NULL) {
         return ARGON2_MEMORY_ALLOCATION_ERROR;
     }
+    if (charge_quota) {
+        int admitted = QuotaCharge((size_t) m_cost * ARGON2_BLOCK_SIZE);
+        if (ARGON2_OK != admitted) {
+            return admitted;
+        }
+    }
+    // First look for a retired array of exactly this size
+    uint32_t bucket = RecycleBucket(m_cost);
+    Argon2ArrayHeader* list = recycle_heads[bucket].exchange(NULL);
+    Argon2ArrayHeader* match = NULL;
+    while (list != NULL) {
+        Argon2ArrayHeader* next = list->next;
+        if (match == NULL && list->m_cost == m_cost) {
+            match = list;
+            recycle_depths[bucket].fetch_sub(1);
+        } else {
+            RecyclePush(bucket, list); //different size (bucket collision): keep it parked
+        }
+        list = next;
+    }
+    if (match != NULL) {
+        *memory = (block*) match + 1;
+        return ARGON2_OK;
+    }
+
+    uint64_t magic = ARGON2_ARRAY_MAGIC;
+    // Fresh OS allocations feed the degradation latency signal; freelist
+    // hits above never do (they say nothing about host pressure)
+    uint64_t allocation_start = Argon2Cycles();
+    block* base = AlignedBlockAlloc((size_t) m_cost + 1); //one extra block for the header
+    RecordAllocationLatency((Argon2Cycles() - allocation_start) / 2100); //~TSC ticks per us on deployed hosts; order of magnitude is what the signal needs
+    if (!base) {
+        // Beyond RAM: spill to an unlinked file if a spill directory is set
+        base = SpillFileAlloc((size_t) m_cost + 1);
+        magic = ARGON2_SPILL_MAGIC;
+    }
+    if (!base) {
+        if (charge_quota) {
+            QuotaCredit((size_t) m_cost * ARGON2_BLOCK_SIZE);
+        }
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    Argon2ArrayHeader* header = (Argon2ArrayHeader*) base;
+    header->magic = magic;
+    header->m_cost = m_cost;
+    header->next = NULL;
+    *memory = base + 1;
+
+    return ARGON2_OK;
+}
+
+int AllocateMemory(block **memory, uint32_t m_cost) {
+    return AllocateMemoryImpl(memory, m_cost, true);
+}
+
+void Argon2DrainBlockCache() {
+    for (uint32_t bucket = 0; bucket < ARGON2_RECYCLE_BUCKETS; ++bucket) {
+        Argon2ArrayHeader* list = recycle_heads[bucket].exchange(NULL);
+        while (list != NULL) {
+            Argon2ArrayHeader* next = list->next;
+            AlignedBlockFree((block*) list);
+            list = next;
+        }
+        // A concurrent FreeMemory may sneak one array back in; the depth
+        // counter is advisory, the cache just stays slightly fuller
+        recycle_depths[bucket].store(0);
+    }
+}
+
+
+/*
+ * Fallback for fragmented address spaces: one chunk per lane plus a small
+ * chunk table, so a hash never fails just because no contiguous range of
+ * memory_blocks exists. Each chunk goes through AllocateMemory and therefore
+ * stays freelist- and spill-compatible.
+ */
+static int AllocateLaneChunks(Argon2_instance_t* instance) {
+    // Admit the whole instance at once: partially admitted chunks waiting on
+    // a memory quota would deadlock against the chunks this call already holds
+    int admitted = QuotaCharge((size_t) instance->memory_blocks * ARGON2_BLOCK_SIZE);
+    if (ARGON2_OK != admitted) {
+        return admitted;
+    }
+    block** chunks = NULL;
+    try{
+        chunks = new block*[instance->lanes];
+    }
+    catch(std::bad_alloc& ba){
+        QuotaCredit((size_t) instance->memory_blocks * ARGON2_BLOCK_SIZE);
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    for (uint32_t l = 0; l < instance->lanes; ++l) {
+        chunks[l] = NULL;
+    }
+    for (uint32_t l = 0; l < instance->lanes; ++l) {
+        if (ARGON2_OK != AllocateMemoryImpl(&chunks[l], instance->lane_length, false)) {
+            for (uint32_t k = 0; k < l; ++k) {
+                FreeMemory(chunks[k]); //credits per chunk; the unallocated rest below
+            }
+            QuotaCredit((size_t) (instance->lanes - l) * instance->lane_length * ARGON2_BLOCK_SIZE);
+            delete[] chunks;
+            return ARGON2_MEMORY_ALLOCATION_ERROR;
+        }
+    }
+    instance->lane_chunks = chunks;
+    return ARGON2_OK;
+}
+
+/*
+ * Process-level Argon2i address cache: one parameter set, resolved reference
+ * offsets for every (pass, slice, lane) segment, published once and read
+ * lock-free afterwards. Servers hashing with a fixed parameter set prime it
+ * at start; everything else ignores it.
+ */
+struct Argon2AddressCache {
+    uint32_t memory_blocks;
+    uint32_t passes;
+    uint32_t lanes;
+    uint32_t segment_length;
+    const uint32_t* offsets; //[pass][slice][lane][index]
+    void* mapping; //non-NULL when @offsets lives in an mmap'd stream file
+    size_t mapping_bytes;
+};
+
+/* On-disk header of a serialized address stream */
+struct Argon2AddressFileHeader {
+    uint64_t magic;
+    uint32_t format_version;
+    uint32_t argon2_version;
+    uint32_t type;
+    uint32_t memory_blocks;
+    uint32_t passes;
+    uint32_t lanes;
+    uint32_t segment_length;
+    uint32_t reserved;
+};
+
+static const uint64_t ARGON2_ADDRESS_FILE_MAGIC = UINT64_C(0xA260217ADD2C0FFE);
+static const uint32_t ARGON2_ADDRESS_FILE_VERSION = 1;
+
+static void FreeAddressCacheEntry(const Argon2AddressCache* old);
+
+static std::atomic<const Argon2AddressCache*> address_cache(NULL);
+static std::mutex address_cache_mutex; //serializes prime/drop, not lookups
+
+const uint32_t* Argon2CachedOffsets(const Argon2_instance_t* instance, const Argon2_position_t* position) {
+    const Argon2AddressCache* cache = address_cache.load(std::memory_order_acquire);
+    if (cache == NULL || instance->type != Argon2_i
+            || cache->memory_blocks != instance->memory_blocks
+            || cache->passes != instance->passes
+            || cache->lanes != instance->lanes) {
+        return NULL;
+    }
+    size_t segment = ((size_t) position->pass * ARGON2_SYNC_POINTS + position->slice) * cache->lanes + position->lane;
+    return cache->offsets + segment * cache->segment_length;
+}
+
+/*
+ * Borrows the arena's block array, growing it when @needed does not fit;
+ * shared by Initialize() and Argon2Warmup().
+ */
+static int BorrowArenaMemory(Argon2_Arena* arena, size_t needed, uint32_t memory_blocks) {
+    if (arena->pending_teardown.valid()) {
+        // Fence: a background wipe of this arena may still be in flight
+        arena->pending_teardown.wait();
+        arena->pending_teardown = std::future<void>();
+    }
+    if (arena->memory != NULL && arena->memory_bytes < needed) {
+        if (NULL != arena->free_cbk) {
+            arena->free_cbk(arena->memory, arena->memory_bytes);
+        } else {
+            FreeMemory((block*) arena->memory);
+        }
+        arena->memory = NULL;
+        arena->memory_bytes = 0;
+    }
+    if (arena->memory == NULL) {
+        int result;
+        if (NULL != arena->allocate_cbk) {
+            result = arena->allocate_cbk(&arena->memory, needed);
+            if (ARGON2_OK != result) {
+                arena->memory = NULL; //never let the destructor see a half-written pointer
+            }
+        } else {
+            block* blocks = NULL;
+            result = AllocateMemory(&blocks, memory_blocks);
+            arena->memory = (uint8_t*) blocks;
+        }
+        if (ARGON2_OK != result) {
+            return result;
+        }
+        arena->memory_bytes = needed;
+    }
+    return ARGON2_OK;
+}
+
+int Argon2Warmup(const Argon2_Params* params, Argon2_Arena* arena) {
+    if (params == NULL || !params->valid) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    // Dispatch and topology decisions are magic-static; taking them here
+    // moves the cpuid probe and the sysfs core scan off the first request
+    (void) Argon2KernelName();
+    (void) Argon2PhysicalCores();
+
+    uint32_t team = (params->threads != 0) ? params->threads : Argon2PhysicalCores();
+    if (team > params->lanes) {
+        team = params->lanes;
+    }
+    if (team > 1) {
+        Argon2ThreadPool::Instance().EnsureSpareWorkers(team);
+    }
+
+    if (arena != NULL) {
+        // Same borrow-or-grow dance as Initialize(), so the first real hash
+        // finds the block array already sized and its pages already resident
+        size_t needed = (size_t) params->memory_blocks * ARGON2_BLOCK_SIZE;
+        int result = BorrowArenaMemory(arena, needed, params->memory_blocks);
+        if (ARGON2_OK != result) {
+            return result;
+        }
+        Argon2_instance_t geometry((block*) arena->memory, (Argon2_type) params->type,
+                params->t_cost, params->memory_blocks, params->lanes, team, false);
+        PlaceMemoryByLane(&geometry); //parallel prefault when team > 1
+        if (team <= 1) {
+            uint8_t* base = arena->memory;
+            for (size_t offset = 0; offset < needed; offset += 4096) {
+                base[offset] = 0;
+            }
+        }
+    }
+
+    if (Argon2_i == (Argon2_type) params->type) {
+        // A cache larger than the working set it serves is a parameter
+        // mistake, not a warmup - use that as the size cap
+        return Argon2PrimeAddressCache(params->m_cost, params->t_cost,
+                params->lanes, (size_t) params->memory_blocks * ARGON2_BLOCK_SIZE);
+    }
+    return ARGON2_OK;
+}
+
+int Argon2PrimeAddressCache(uint32_t m_cost, uint32_t t_cost, uint32_t lanes, size_t max_bytes) {
+    // Mirror the rounding Argon2Core applies
+    uint32_t memory_blocks = m_cost;
+    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * lanes) {
+        memory_blocks = 2 * ARGON2_SYNC_POINTS * lanes;
+    }
+    uint32_t segment_length = memory_blocks / (lanes * ARGON2_SYNC_POINTS);
+    memory_blocks = segment_length * (lanes * ARGON2_SYNC_POINTS);
+
+    size_t total = (size_t) t_cost * memory_blocks;
+    if (total * sizeof (uint32_t) > max_bytes) {
+        return ARGON2_MEMORY_TOO_MUCH;
+    }
+
+    uint32_t* offsets = NULL;
     try{
-        *memory = new block[m_cost];
+        offsets = new uint32_t[total];
     }
     catch(std::bad_alloc& ba){
         return ARGON2_MEMORY_ALLOCATION_ERROR;
     }
-    if (!*memory) {
-        return ARGON2_MEMORY_ALLOCATION_ERROR;
+
+    Argon2_instance_t instance(NULL, Argon2_i, t_cost, memory_blocks, lanes, 1, false);
+    uint32_t* cursor = offsets;
+    for (uint32_t r = 0; r < t_cost; ++r) {
+        for (uint8_t sl = 0; sl < ARGON2_SYNC_POINTS; ++sl) {
+            for (uint32_t l = 0; l < lanes; ++l) {
+                PrimeSegmentAddresses(&instance, Argon2_position_t(r, l, sl, 0), cursor);
+                cursor += segment_length;
+            }
+        }
+    }
+
+    Argon2AddressCache* cache = new Argon2AddressCache();
+    cache->memory_blocks = memory_blocks;
+    cache->passes = t_cost;
+    cache->lanes = lanes;
+    cache->segment_length = segment_length;
+    cache->offsets = offsets;
+    cache->mapping = NULL;
+    cache->mapping_bytes = 0;
+
+    std::unique_lock<std::mutex> lock(address_cache_mutex);
+    const Argon2AddressCache* old = address_cache.exchange(cache, std::memory_order_release);
+    if (old != NULL) {
+        // Note: a hash still reading the old cache would race; priming is a
+        // startup operation, documented to run before serving traffic
+        FreeAddressCacheEntry(old);
+    }
+    return ARGON2_OK;
+}
+
+void FreeAddressCacheEntry(const Argon2AddressCache* old) {
+#if !defined(_WIN32)
+    if (old->mapping != NULL) {
+        munmap(old->mapping, old->mapping_bytes);
+        delete old;
+        return;
+    }
+#endif
+    delete[] old->offsets;
+    delete old;
+}
+
+void Argon2DropAddressCache() {
+    std::unique_lock<std::mutex> lock(address_cache_mutex);
+    const Argon2AddressCache* old = address_cache.exchange(NULL);
+    if (old != NULL) {
+        FreeAddressCacheEntry(old);
+    }
+}
+
+int Argon2SaveAddressCache(const char* path) {
+#if defined(_WIN32)
+    (void) path;
+    return ARGON2_INCORRECT_PARAMETER;
+#else
+    if (path == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    const Argon2AddressCache* cache = address_cache.load(std::memory_order_acquire);
+    if (cache == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    std::string tmp_path = std::string(path) + ".tmp";
+    FILE* fp = fopen(tmp_path.c_str(), "wb");
+    if (fp == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    Argon2AddressFileHeader header;
+    memset(&header, 0, sizeof (header));
+    header.magic = ARGON2_ADDRESS_FILE_MAGIC;
+    header.format_version = ARGON2_ADDRESS_FILE_VERSION;
+    header.argon2_version = ARGON2_VERSION_NUMBER;
+    header.type = (uint32_t) Argon2_i;
+    header.memory_blocks = cache->memory_blocks;
+    header.passes = cache->passes;
+    header.lanes = cache->lanes;
+    header.segment_length = cache->segment_length;
+    size_t count = (size_t) cache->passes * cache->memory_blocks;
+    if (fwrite(&header, sizeof (header), 1, fp) != 1
+            || fwrite(cache->offsets, sizeof (uint32_t), count, fp) != count) {
+        fclose(fp);
+        remove(tmp_path.c_str());
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    fclose(fp);
+    if (rename(tmp_path.c_str(), path) != 0) {
+        remove(tmp_path.c_str());
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    return ARGON2_OK;
+#endif
+}
+
+int Argon2LoadAddressCache(const char* path) {
+#if defined(_WIN32)
+    (void) path;
+    return ARGON2_INCORRECT_PARAMETER;
+#else
+    if (path == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    off_t file_size = lseek(fd, 0, SEEK_END);
+    if (file_size < (off_t) sizeof (Argon2AddressFileHeader)) {
+        close(fd);
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    // MAP_SHARED read-only: every worker process on the host shares the pages
+    void* mapping = mmap(NULL, (size_t) file_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    const Argon2AddressFileHeader* header = (const Argon2AddressFileHeader*) mapping;
+    uint64_t count = (uint64_t) header->passes * header->memory_blocks; //64-bit: a crafted header must not wrap the size check
+    if (header->magic != ARGON2_ADDRESS_FILE_MAGIC
+            || header->format_version != ARGON2_ADDRESS_FILE_VERSION
+            || header->argon2_version != ARGON2_VERSION_NUMBER
+            || header->type != (uint32_t) Argon2_i
+            || header->lanes == 0
+            || header->segment_length != header->memory_blocks / (header->lanes * ARGON2_SYNC_POINTS)
+            || (uint64_t) file_size != sizeof (Argon2AddressFileHeader) + count * sizeof (uint32_t)) {
+        munmap(mapping, (size_t) file_size);
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+
+    // Every offset indexes the block array during hashing; a corrupted or
+    // tampered file must be rejected here, not crash inside FillSegment
+    const uint32_t* file_offsets = (const uint32_t*) ((const uint8_t*) mapping + sizeof (Argon2AddressFileHeader));
+    for (uint64_t i = 0; i < count; ++i) {
+        if (file_offsets[i] >= header->memory_blocks) {
+            munmap(mapping, (size_t) file_size);
+            return ARGON2_INCORRECT_PARAMETER;
+        }
+    }
+
+    Argon2AddressCache* cache = new Argon2AddressCache();
+    cache->memory_blocks = header->memory_blocks;
+    cache->passes = header->passes;
+    cache->lanes = header->lanes;
+    cache->segment_length = header->segment_length;
+    cache->offsets = (const uint32_t*) ((const uint8_t*) mapping + sizeof (Argon2AddressFileHeader));
+    cache->mapping = mapping;
+    cache->mapping_bytes = (size_t) file_size;
+
+    std::unique_lock<std::mutex> lock(address_cache_mutex);
+    const Argon2AddressCache* old = address_cache.exchange(cache, std::memory_order_release);
+    if (old != NULL) {
+        FreeAddressCacheEntry(old);
+    }
+    return ARGON2_OK;
+#endif
+}
+
+uint64_t* GetSegmentScratch(uint32_t length) {
+    struct Scratch {
+        uint64_t* data;
+        uint32_t capacity;
+
+        Scratch() : data(NULL), capacity(0) {
+        };
+
+        ~Scratch() {
+            delete[] data;
+        };
+    };
+    static thread_local Scratch scratch; //one per worker, reused across segments
+    if (scratch.capacity < length) {
+        delete[] scratch.data;
+        scratch.data = NULL;
+        scratch.capacity = 0;
+        // A failed grow throws bad_alloc, exactly like the per-segment new[]
+        // it replaces - a silently skipped segment would corrupt the tag
+        scratch.data = new uint64_t[length];
+        scratch.capacity = length;
+    }
+    return scratch.data;
+}
+
+void ClearMemory(Argon2_instance_t* instance, bool clear) {
+    if ((instance->memory != NULL || instance->lane_chunks != NULL) && clear) {
+        if (instance->type == Argon2_ds && instance->Sbox != NULL) {
+            secure_wipe_memory(instance->Sbox, ARGON2_SBOX_SIZE * sizeof (uint64_t));
+        }
+        if (instance->slice_interleaved) {
+            // Lane stripes are not physically contiguous here; the array is
+            // one allocation, so wipe it as one range
+            secure_wipe_memory(instance->memory, sizeof (block) * instance->memory_blocks);
+            return;
+        }
+        if (instance->threads > 1 && instance->lanes > 1) {
+            // Wipe lane stripes in parallel on the same workers that just
+            // filled them - they still own those stripes in cache, and a
+            // multi-GB single-threaded wipe otherwise dominates teardown
+            Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+            pool.EnsureSpareWorkers((instance->threads < instance->lanes) ? instance->threads : instance->lanes);
+            Argon2TaskGroup group(pool);
+            for (uint32_t l = 0; l < instance->lanes; ++l) {
+                group.Spawn([instance, l]() {
+                    secure_wipe_memory(instance->BlockAt(l * instance->lane_length),
+                            sizeof (block) * instance->lane_length);
+                });
+            }
+            group.Wait();
+            return;
+        }
+        for (uint32_t l = 0; l < instance->lanes; ++l) {
+            secure_wipe_memory(instance->BlockAt(l * instance->lane_length),
+                    sizeof (block) * instance->lane_length);
+        }
+    }
+}
+
+/* Arrays at least this large get their pages released while parked */
+static const uint32_t ARGON2_PARK_RELEASE_BLOCKS = 8192; //8 MB
+
+/*
+ * Lets the kernel reclaim the payload pages of a parked array lazily
+ * (MADV_FREE keeps the mapping and the TLB entries; contents are dead anyway
+ * since every block is rewritten on reuse). Teardown of a multi-GB hash thus
+ * costs one syscall instead of pushing the bytes through the allocator, and
+ * the parked memory stops counting against us under memory pressure.
+ */
+static void ReleaseParkedPages(Argon2ArrayHeader* header) {
+#if defined(MADV_FREE)
+    if (header->m_cost >= ARGON2_PARK_RELEASE_BLOCKS) {
+        const uintptr_t page_mask = 4095;
+        uintptr_t start = ((uintptr_t) ((block*) header + 1) + page_mask) & ~page_mask;
+        uintptr_t end = ((uintptr_t) ((block*) header + 1) + (size_t) header->m_cost * ARGON2_BLOCK_SIZE) & ~page_mask;
+        if (end > start) {
+            madvise((void*) start, end - start, MADV_FREE);
+        }
+    }
+#else
+    (void) header;
+#endif
+}
+
+void FreeMemory(block* memory) {
+    if (memory == NULL) {
+        return;
+    }
+    Argon2ArrayHeader* header = (Argon2ArrayHeader*) (memory - 1);
+    if (header->magic == ARGON2_ARRAY_MAGIC || header->magic == ARGON2_SPILL_MAGIC) {
+        QuotaCredit((size_t) header->m_cost * ARGON2_BLOCK_SIZE);
+    }
+#if !defined(_WIN32)
+    if (header->magic == ARGON2_SPILL_MAGIC) {
+        // Spill mappings are not recycled: dropping the last reference to the
+        // unlinked file is the whole teardown
+        munmap(header, ((size_t) header->m_cost + 1) * ARGON2_BLOCK_SIZE);
+        return;
+    }
+#endif
+    if (header->magic == ARGON2_ARRAY_MAGIC) {
+        uint32_t bucket = RecycleBucket(header->m_cost);
+        if (recycle_depths[bucket].fetch_add(1) < ARGON2_RECYCLE_DEPTH) {
+            ReleaseParkedPages(header);
+            RecyclePush(bucket, header);
+            return;
+        }
+        recycle_depths[bucket].fetch_sub(1); //bucket full: really free it
+        AlignedBlockFree((block*) header);
+        return;
+    }
+    delete[] memory; //no header: array predates AllocateMemory's recycling
+}
+
+/*
+ * Best-effort pinning of the block array: one major fault inside the random
+ * ref_block walk turns a 300 ms hash into a multi-second outlier, so callers
+ * under swap pressure can ask for the working set to stay resident. Failure
+ * (RLIMIT_MEMLOCK, no privilege) is not an error - the hash just runs
+ * unpinned, as before.
+ */
+static void LockInstanceMemory(const Argon2_instance_t* instance) {
+    if (instance->slice_interleaved) {
+#if defined(_WIN32)
+        VirtualLock(instance->memory, (size_t) instance->memory_blocks * ARGON2_BLOCK_SIZE);
+#else
+        mlock(instance->memory, (size_t) instance->memory_blocks * ARGON2_BLOCK_SIZE);
+#endif
+        return;
+    }
+    for (uint32_t l = 0; l < instance->lanes; ++l) {
+#if defined(_WIN32)
+        VirtualLock(instance->BlockAt(l * instance->lane_length), (size_t) instance->lane_length * ARGON2_BLOCK_SIZE);
+#else
+        mlock(instance->BlockAt(l * instance->lane_length), (size_t) instance->lane_length * ARGON2_BLOCK_SIZE);
+#endif
+    }
+}
+
+static void UnlockInstanceMemory(const Argon2_instance_t* instance) {
+    if (instance->slice_interleaved) {
+#if defined(_WIN32)
+        VirtualUnlock(instance->memory, (size_t) instance->memory_blocks * ARGON2_BLOCK_SIZE);
+#else
+        munlock(instance->memory, (size_t) instance->memory_blocks * ARGON2_BLOCK_SIZE);
+#endif
+        return;
+    }
+    for (uint32_t l = 0; l < instance->lanes; ++l) {
+#if defined(_WIN32)
+        VirtualUnlock(instance->BlockAt(l * instance->lane_length), (size_t) instance->lane_length * ARGON2_BLOCK_SIZE);
+#else
+        munlock(instance->BlockAt(l * instance->lane_length), (size_t) instance->lane_length * ARGON2_BLOCK_SIZE);
+#endif
+    }
+}
+
+/*
+ * Wipes (if requested) and deallocates the instance memory and the Sbox.
+ * Shared by the normal finalization, the cancellation path and the background
+ * teardown task (which is why it takes the context fields it needs by value).
+ */
+static void ReleaseInstanceMemory(bool clear_memory, FreeMemoryCallback free_cbk,
+        Argon2_Arena* arena, Argon2_instance_t* instance, bool locked = false) {
+    // Deferred-seed hygiene: the error exits (cancellation, resume and
+    // params-path failures) release through here without ever reaching
+    // TeardownInstance, and the seed is H0-derived password-equivalent
+    // material that must not outlive the instance on any path
+    if (instance->seeds_deferred) {
+        secure_wipe_memory(instance->seed_hash, ARGON2_PREHASH_SEED_LENGTH);
+        instance->seeds_deferred = false;
+    }
+    // Clear memory
+    ClearMemory(instance, clear_memory);
+
+    if (locked) {
+        // Never hand locked pages back to the allocator or the freelist
+        UnlockInstanceMemory(instance);
+    }
+
+    if (NULL != arena) {
+        // The arena keeps the allocation (and the Sbox) for the next hash
+        arena->sbox = instance->Sbox;
+        return;
+    }
+
+    // Deallocate Sbox memory
+    if (instance->Sbox != NULL) {
+        delete[] instance->Sbox;
+    }
+
+    // Deallocate the memory
+    if (instance->lane_chunks != NULL) {
+        for (uint32_t l = 0; l < instance->lanes; ++l) {
+            FreeMemory(instance->lane_chunks[l]);
+        }
+        delete[] instance->lane_chunks;
+        instance->lane_chunks = NULL;
+    } else if (NULL != free_cbk) {
+        free_cbk((uint8_t *) instance->memory, instance->memory_blocks * sizeof (block));
+    } else {
+        FreeMemory(instance->memory);
+    }
+}
+
+/* Chunk size of the counter-mode tag expansion */
+static const uint32_t ARGON2_TAG_CHUNK = 64 * 1024;
+
+/*
+ * Counter-mode tag expansion: a 64-byte root seed is derived from the final
+ * block exactly like the first step of blake2b_long, then every 64 KB output
+ * chunk is an independent blake2b_long of seed||le32(chunk index). The result
+ * does not depend on the thread count, but it is a different function than
+ * the chained expansion - strictly opt-in via context->parallel_tag.
+ */
+/*
+ * Streaming delivery of the counter-mode expansion: the pool derives the
+ * next window of chunks while the caller's thread feeds the current window
+ * to the sink, so a keystream-sized tag overlaps its own I/O and never
+ * exists in memory beyond 2*threads chunks.
+ */
+static int StreamTagChunks(const Argon2_Context *context, const uint8_t* seed,
+        uint32_t chunk_count) {
+    uint32_t window = (context->threads > 1) ? context->threads : 1;
+    if (window > chunk_count) {
+        window = chunk_count;
+    }
+    std::vector<uint8_t> buffers(2 * (size_t) window * ARGON2_TAG_CHUNK);
+    uint8_t* halves[2] = {&buffers[0], &buffers[0] + (size_t) window * ARGON2_TAG_CHUNK};
+
+    Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+    const bool parallel = (context->threads > 1 && chunk_count > 1);
+    if (parallel) {
+        pool.EnsureSpareWorkers(window);
+    }
+    auto derive_window = [context, seed, chunk_count](uint8_t* dst, uint32_t first, uint32_t count) {
+        for (uint32_t j = first; j < first + count; ++j) {
+            uint8_t material[64 + sizeof (uint32_t)];
+            memcpy(material, seed, 64);
+            store32(material + 64, j);
+            uint32_t len = (j + 1 < chunk_count) ? ARGON2_TAG_CHUNK
+                    : context->outlen - j * ARGON2_TAG_CHUNK;
+            blake2b_long(dst + (size_t) (j - first) * ARGON2_TAG_CHUNK, len, material, sizeof (material));
+            secure_wipe_memory(material, sizeof (material));
+        }
+    };
+
+    int result = ARGON2_OK;
+    uint32_t half = 0;
+    derive_window(halves[half], 0, window);
+    for (uint32_t base = 0; base < chunk_count && ARGON2_OK == result;) {
+        uint32_t count = (base + window < chunk_count) ? window : chunk_count - base;
+        uint32_t next_base = base + count;
+        uint32_t next_count = (next_base + window < chunk_count) ? window : chunk_count - next_base;
+        Argon2TaskGroup group(pool);
+        if (next_base < chunk_count) {
+            if (parallel) {
+                // Derive ahead on the pool; one task per chunk so wide
+                // windows spread over the team
+                uint8_t* next_half = halves[half ^ 1];
+                for (uint32_t j = 0; j < next_count; ++j) {
+                    group.Spawn([&derive_window, next_half, next_base, j]() {
+                        derive_window(next_half + (size_t) j * ARGON2_TAG_CHUNK, next_base + j, 1);
+                    });
+                }
+            } else {
+                derive_window(halves[half ^ 1], next_base, next_count);
+            }
+        }
+        for (uint32_t j = 0; j < count; ++j) {
+            uint32_t len = (base + j + 1 < chunk_count) ? ARGON2_TAG_CHUNK
+                    : context->outlen - (base + j) * ARGON2_TAG_CHUNK;
+            if (context->tag_sink(context->sink_data,
+                    halves[half] + (size_t) j * ARGON2_TAG_CHUNK, len,
+                    (uint64_t) (base + j) * ARGON2_TAG_CHUNK) != 0) {
+                result = ARGON2_TAG_SINK_ABORTED;
+                break;
+            }
+        }
+        group.Wait(); //the look-ahead derivation must settle before the buffers swap or die
+        half ^= 1;
+        base = next_base;
+    }
+    secure_wipe_memory(&buffers[0], buffers.size());
+    return result;
+}
+
+static int ComputeTagParallel(const Argon2_Context *context, const block* blockhash) {
+    uint8_t seed[64];
+    uint8_t outlen_bytes[sizeof (uint32_t)];
+    store32(outlen_bytes, context->outlen);
+
+    blake2b_state root;
+    blake2b_init(&root, sizeof (seed));
+    blake2b_update(&root, outlen_bytes, sizeof (outlen_bytes));
+    blake2b_update(&root, (const uint8_t*) blockhash->v, ARGON2_BLOCK_SIZE);
+    blake2b_final(&root, seed, sizeof (seed));
+    secure_wipe_memory(&root, sizeof (root));
+
+    uint32_t chunk_count = (uint32_t) (((uint64_t) context->outlen + ARGON2_TAG_CHUNK - 1) / ARGON2_TAG_CHUNK);
+    if (context->tag_sink != NULL) {
+        int result = StreamTagChunks(context, seed, chunk_count);
+        secure_wipe_memory(seed, sizeof (seed));
+        return result;
+    }
+    uint8_t* out = context->out;
+    if (context->threads > 1 && chunk_count > 1) {
+        Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+        pool.EnsureSpareWorkers(context->threads);
+        Argon2TaskGroup group(pool);
+        const uint8_t* seed_ptr = seed; //outlives Wait(); no unwiped closure copies
+        for (uint32_t j = 0; j < chunk_count; ++j) {
+            group.Spawn([context, out, seed_ptr, j, chunk_count]() {
+                uint8_t material[64 + sizeof (uint32_t)];
+                memcpy(material, seed_ptr, 64);
+                store32(material + 64, j);
+                uint32_t len = (j + 1 < chunk_count) ? ARGON2_TAG_CHUNK
+                        : context->outlen - j * ARGON2_TAG_CHUNK;
+                blake2b_long(out + (size_t) j * ARGON2_TAG_CHUNK, len, material, sizeof (material));
+                secure_wipe_memory(material, sizeof (material));
+            });
+        }
+        group.Wait();
+    } else {
+        for (uint32_t j = 0; j < chunk_count; ++j) {
+            uint8_t material[sizeof (seed) + sizeof (uint32_t)];
+            memcpy(material, seed, sizeof (seed));
+            store32(material + sizeof (seed), j);
+            uint32_t len = (j + 1 < chunk_count) ? ARGON2_TAG_CHUNK
+                    : context->outlen - j * ARGON2_TAG_CHUNK;
+            blake2b_long(out + (size_t) j * ARGON2_TAG_CHUNK, len, material, sizeof (material));
+            secure_wipe_memory(material, sizeof (material));
+        }
+    }
+    secure_wipe_memory(seed, sizeof (seed));
+    return ARGON2_OK;
+}
+
+/*
+ * XORs the last block of each lane and hashes the result into the tag.
+ */
+static void XorLastBlocks(const Argon2_instance_t* instance, block* blockhash) {
+    // Wide hashes: the fold is lanes KB of strided cold reads on the
+    // critical path after every worker has gone idle. Fan the reduction out
+    // over the pool - each worker folds a contiguous chunk of lanes into a
+    // partial, and only the few partials combine serially.
+    if (instance->threads > 1 && instance->lanes >= 8) {
+        uint32_t workers = (instance->threads < instance->lanes / 2)
+                ? instance->threads : instance->lanes / 2;
+        uint32_t per_worker = (instance->lanes + workers - 1) / workers;
+        // Ceil division can leave trailing workers with no lanes at all
+        // (e.g. 9 lanes over 4 workers = 3 each in 3 workers); spawn only
+        // those that own at least one lane
+        workers = (instance->lanes + per_worker - 1) / per_worker;
+        // Aligned allocator: the partials are copy/XOR targets of aligned
+        // vector moves (see Argon2AlignedAllocator)
+        std::vector<block, Argon2AlignedAllocator<block> > partials(workers);
+        Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+        pool.EnsureSpareWorkers(workers);
+        Argon2TaskGroup group(pool);
+        block* partial_base = &partials[0];
+        for (uint32_t t = 0; t < workers; ++t) {
+            group.Spawn([instance, t, per_worker, partial_base]() {
+                uint32_t first = t * per_worker;
+                uint32_t last = (first + per_worker < instance->lanes)
+                        ? first + per_worker : instance->lanes;
+                block* partial = partial_base + t;
+                *partial = *instance->BlockAt(first * instance->lane_length + instance->lane_length - 1);
+                for (uint32_t l = first + 1; l < last; ++l) {
+                    *partial ^= *instance->BlockAt(l * instance->lane_length + instance->lane_length - 1);
+                }
+            });
+        }
+        group.Wait();
+        *blockhash = partials[0];
+        for (uint32_t t = 1; t < workers; ++t) {
+            *blockhash ^= partials[t];
+        }
+        for (uint32_t t = 0; t < workers; ++t) {
+            secure_wipe_memory(partials[t].v, ARGON2_BLOCK_SIZE);
+        }
+        return;
+    }
+    *blockhash = *instance->BlockAt(instance->lane_length - 1);
+    for (uint32_t l = 1; l < instance->lanes; ++l) {
+        uint32_t last_block_in_lane = l * instance->lane_length + (instance->lane_length - 1);
+        *blockhash ^= *instance->BlockAt(last_block_in_lane);
     }
-
-    return ARGON2_OK;
 }
 
+static int ComputeTag(const Argon2_Context *context, const Argon2_instance_t* instance) {
+    block blockhash;
+    int result = ARGON2_OK;
+    XorLastBlocks(instance, &blockhash);
 
-void ClearMemory(Argon2_instance_t* instance, bool clear) {
-    if (instance->memory != NULL && clear) {
-        if (instance->type == Argon2_ds && instance->Sbox != NULL) {
-            secure_wipe_memory(instance->Sbox, ARGON2_SBOX_SIZE * sizeof (uint64_t));
-        }
-        secure_wipe_memory(instance->memory, sizeof (block) * instance->memory_blocks);
+    // Hash the result
+    if (context->parallel_tag && (context->tag_sink != NULL || context->outlen > 64)) {
+        // Counter-mode expansion: large keystream tags parallelize across
+        // the pool, or stream through the sink without materializing
+        result = ComputeTagParallel(context, &blockhash);
+    } else {
+        blake2b_long(context->out,  context->outlen,(uint8_t*) blockhash.v, ARGON2_BLOCK_SIZE);
     }
-}
+    secure_wipe_memory(blockhash.v, ARGON2_BLOCK_SIZE); //clear the blockhash
 
-void FreeMemory(block* memory) {
-    delete[] memory;
-    memory=nullptr;
+    if (ARGON2_KAT_ENABLED && context->print && context->out != NULL) { //Shall we print the output tag?
+        PrintTag(context->out, context->outlen);
+    }
+    return result;
 }
 
-void Finalize(const Argon2_Context *context, Argon2_instance_t* instance) {
-    if (context != NULL && instance != NULL) {
-        block blockhash = instance->memory[instance->lane_length - 1];
+static void TeardownInstance(const Argon2_Context *context, Argon2_instance_t* instance) {
+    // Wiped here as well as in ReleaseInstanceMemory: the background
+    // teardown below hands the pool a COPY of the instance, so the release
+    // there cannot reach this stack frame's seed bytes
+    if (instance->seeds_deferred) {
+        secure_wipe_memory(instance->seed_hash, ARGON2_PREHASH_SEED_LENGTH);
+        instance->seeds_deferred = false;
+    }
+    if (context->background_teardown) {
+        // The caller gets the tag now; a pool worker reclaims the memory.
+        // An arena is fenced so it is never handed out mid-wipe.
+        Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+        pool.EnsureSpareWorkers(1);
+        const bool clear_memory = context->clear_memory;
+        const bool locked = context->lock_memory;
+        const FreeMemoryCallback free_cbk = context->free_cbk;
+        Argon2_Arena* arena = context->arena;
+        Argon2_instance_t instance_copy = *instance;
+        std::shared_ptr<std::promise<void> > wiped;
+        if (arena != NULL) {
+            wiped.reset(new std::promise<void>());
+            arena->pending_teardown = wiped->get_future();
+        }
+        pool.Submit([clear_memory, locked, free_cbk, arena, instance_copy, wiped]() {
+            // Wipe single-threaded: an unreserved pool task must never
+            // block on other pool tasks (two parallel-wiping teardowns
+            // could occupy every worker and starve their own stripe
+            // tasks), and this latency is off the caller's clock anyway
+            Argon2_instance_t wipe_view(instance_copy.memory, instance_copy.type,
+                    instance_copy.passes, instance_copy.memory_blocks,
+                    instance_copy.lanes, 1, false);
+            wipe_view.Sbox = instance_copy.Sbox;
+            wipe_view.lane_chunks = instance_copy.lane_chunks; //chunked instances must wipe/free through the table
+            ReleaseInstanceMemory(clear_memory, free_cbk, arena, &wipe_view, locked);
+            if (wiped != NULL) {
+                wiped->set_value();
+            }
+        });
+        return;
+    }
 
-        // XOR the last blocks
-        for (uint32_t l = 1; l < instance->lanes; ++l) {
-            uint32_t last_block_in_lane = l * instance->lane_length + (instance->lane_length - 1);
-            blockhash ^= instance->memory[last_block_in_lane];
+    ReleaseInstanceMemory(context->clear_memory, context->free_cbk, context->arena, instance, context->lock_memory);
+}
 
-        }
+int Finalize(const Argon2_Context *context, Argon2_instance_t* instance) {
+    int result = ARGON2_OK;
+    if (context != NULL && instance != NULL) {
+        result = ComputeTag(context, instance);
+        TeardownInstance(context, instance);
+    }
+    return result;
+}
 
-        // Hash the result
-        blake2b_long(context->out,  context->outlen,(uint8_t*) blockhash.v, ARGON2_BLOCK_SIZE);
-        secure_wipe_memory(blockhash.v, ARGON2_BLOCK_SIZE); //clear the blockhash
+/*
+ * Server-relief finalization: exports the pre-tag state (the XOR of the last
+ * block of every lane) instead of hashing it into the tag, then tears the
+ * instance down exactly as Finalize() does. blake2b_long() over this state is
+ * the only work left, so a server can complete the tag without touching the
+ * memory-hard phase.
+ */
+static void FinalizePreTag(const Argon2_Context *context, Argon2_instance_t* instance,
+        uint8_t* pre_tag) {
+    static_assert(ARGON2_PRETAG_BYTES == ARGON2_BLOCK_SIZE,
+            "public pre-tag size must track the block size");
+    block blockhash;
+    XorLastBlocks(instance, &blockhash);
+    memcpy(pre_tag, blockhash.v, ARGON2_BLOCK_SIZE);
+    secure_wipe_memory(blockhash.v, ARGON2_BLOCK_SIZE);
+    TeardownInstance(context, instance);
+}
 
-        if(context->print){ //Shall we print the output tag?
-            PrintTag(context->out, context->outlen);
-        }
 
-        // Clear memory
-        ClearMemory(instance, context->clear_memory);
+/*
+ * Interleaved lane-pair filling is available but off by default: on the hosts
+ * measured here the paired kernel loses ~12% to the sequential one (register
+ * pressure, and the pair loop cannot use the next-ref prefetch). Wide cores
+ * with idle ports can enable it and measure.
+ */
+static bool PairFillEnabled() {
+    static const bool enabled = (getenv("ARGON2_PAIR_FILL") != NULL);
+    return enabled;
+}
 
-        // Deallocate Sbox memory
-        if (instance->memory != NULL && instance->Sbox != NULL) {
-            delete[] instance->Sbox;
+int FillMemoryBlocks(Argon2_instance_t* instance) {
+    if (instance == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    // L2-resident small-instance path: single-lane 256 KB - 2 MB hashes
+    // (rate-limited endpoints) take four straight-line segment calls per pass
+    // with the per-slice cancel/progress/print checks hoisted out. Measured
+    // at parity with the general single-threaded loop on this host - the
+    // heavyweight machinery (pool, barriers, per-call scratch allocation)
+    // already never runs for threads==1 - but the fused shape keeps the
+    // microsecond path free of those checks by construction.
+    if (1 == instance->threads && 1 == instance->lanes
+            && instance->memory_blocks <= ARGON2_SMALL_INSTANCE_BLOCKS
+            && Argon2_ds != instance->type
+            && instance->cancel == NULL && instance->progress_cbk == NULL
+            && !instance->internal_print
+            && instance->resume_pass == 0 && instance->resume_slice == 0
+            && !CheckpointEnabled()) {
+        if (instance->stats != NULL) {
+            instance->stats->threads_used = 1;
         }
-
-        // Deallocate the memory
-        if (NULL != context->free_cbk) {
-            context->free_cbk((uint8_t *) instance->memory, instance->memory_blocks * sizeof (block));
-        } else {
-            FreeMemory(instance->memory);
+        for (uint32_t r = 0; r < instance->passes; ++r) {
+            FillSegment(instance, Argon2_position_t(r, 0, 0, 0));
+            FillSegment(instance, Argon2_position_t(r, 0, 1, 0));
+            FillSegment(instance, Argon2_position_t(r, 0, 2, 0));
+            FillSegment(instance, Argon2_position_t(r, 0, 3, 0));
         }
-
+        return ARGON2_OK;
     }
-}
-
-uint32_t IndexAlpha(const Argon2_instance_t* instance, const Argon2_position_t* position, uint32_t pseudo_rand, bool same_lane) {
-    /*
-     * Pass 0:
-     *      This lane : all already finished segments plus already constructed blocks in this segment
-     *      Other lanes : all already finished segments
-     * Pass 1+:
-     *      This lane : (SYNC_POINTS - 1) last segments plus already constructed blocks in this segment
-     *      Other lanes : (SYNC_POINTS - 1) last segments 
-     */
-    uint32_t reference_area_size;
-
-    if (0 == position->pass) {
-        // First pass
-        if (0 == position->slice) {
-            // First slice
-            reference_area_size = position->index - 1; // all but the previous
-        } else {
-            if (same_lane) {
-                // The same lane => add current segment
-                reference_area_size = position->slice * instance->segment_length + position->index - 1;
-            } else {
-                reference_area_size = position->slice * instance->segment_length + ((position->index == 0) ? (-1) : 0);
+    uint32_t start_pass = instance->resume_pass;
+    if (instance->resume_slice != 0 && start_pass < instance->passes) {
+        // A snapshot taken mid-pass: replay the remaining slices of that pass
+        // inline (slice-by-slice over all lanes, same order the sync points
+        // impose), then let the normal machinery take over at the next pass.
+        // Argon2_ds never checkpoints mid-pass - its per-pass Sbox derives
+        // from the first block as it stood at pass entry, which a mid-pass
+        // snapshot no longer contains.
+        for (uint8_t s = (uint8_t) instance->resume_slice; s < ARGON2_SYNC_POINTS; ++s) {
+            if (instance->Cancelled()) {
+                return ARGON2_CANCELLED;
             }
+            for (uint32_t l = 0; l < instance->lanes; ++l) {
+                FillSegment(instance, Argon2_position_t(start_pass, l, s, 0));
+            }
+            instance->ReportProgress(start_pass, s);
+            MaybeCheckpoint(instance, start_pass, s);
         }
-    } else {
-        // Second pass
-        if (same_lane) {
-            reference_area_size = instance->lane_length - instance->segment_length + position->index - 1;
-        } else {
-            reference_area_size = instance->lane_length - instance->segment_length + ((position->index == 0) ? (-1) : 0);
-        }
+        ++start_pass;
     }
-
-    /* 1.2.4. Mapping pseudo_rand to 0..<reference_area_size-1> and produce relative position */
-    uint64_t relative_position = pseudo_rand;
-    relative_position = relative_position * relative_position >> 32;
-    relative_position = reference_area_size - 1 - (reference_area_size * relative_position >> 32);
-
-    /* 1.2.5 Computing starting position */
-    uint32_t start_position = 0;
-    if (0 != position->pass) {
-        start_position = (position->slice == ARGON2_SYNC_POINTS - 1) ? 0 : (position->slice + 1) * instance->segment_length;
+    if (1 == instance->threads) {
+        // Single-threaded fast path: fill the segments in the caller, no pool,
+        // no barrier - thread churn measurably hurts interactive hashes
+        if (instance->stats != NULL) {
+            instance->stats->threads_used = 1;
+        }
+        for (uint32_t r = start_pass; r < instance->passes; ++r) {
+            if (Argon2_ds == instance->type) {
+                GenerateSbox(instance);
+            }
+            for (uint8_t s = 0; s < ARGON2_SYNC_POINTS; ++s) {
+                if (instance->Cancelled()) {
+                    return ARGON2_CANCELLED;
+                }
+                uint64_t slice_start = Argon2Cycles();
+                for (uint32_t l = 0; l < instance->lanes;) {
+                    if (PairFillEnabled() && l + 1 < instance->lanes) {
+                        // Same-slice segments are independent: fill two lanes
+                        // with their BlaMka chains interleaved
+                        FillSegmentPair(instance, Argon2_position_t(r, l, s, 0), Argon2_position_t(r, l + 1, s, 0));
+                        l += 2;
+                    } else {
+                        FillSegment(instance, Argon2_position_t(r, l, s, 0));
+                        ++l;
+                    }
+                }
+                RecordSliceCycles(instance, r, s, Argon2Cycles() - slice_start);
+                instance->ReportProgress(r, s);
+                if (Argon2_ds != instance->type) {
+                    MaybeCheckpoint(instance, r, s);
+                }
+            }
+            if (Argon2_ds == instance->type) {
+                // Pass granularity only: the next pass regenerates its Sbox
+                MaybeCheckpoint(instance, r, ARGON2_SYNC_POINTS - 1);
+            }
+            if (ARGON2_KAT_ENABLED && instance->internal_print) {
+                InternalKat(instance, r); // Print all memory blocks
+            }
+        }
+        return instance->Cancelled() ? ARGON2_CANCELLED : ARGON2_OK;
     }
-
-    /* 1.2.6. Computing absolute position */
-    uint32_t absolute_position = (start_position + relative_position) % instance->lane_length; // absolute position
-    return absolute_position;
-}
-
-void FillMemoryBlocks(Argon2_instance_t* instance) {
-    std::vector<std::thread> Threads;
-    if (instance == NULL) {
-        return;
+    Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+    const bool bulk = (ARGON2_PRIORITY_BULK == instance->priority);
+    uint32_t requested = (instance->threads < instance->lanes) ? instance->threads : instance->lanes;
+    // ARGON2_ADAPTIVE_THREADS=1: measure achieved fill bandwidth per pass
+    // and hill-climb the team width at pass boundaries (the only points
+    // where re-reserving cannot change a barrier team's width mid-slice)
+    // toward the aggregate-bandwidth knee - on multi-channel boxes a few
+    // workers saturate DRAM and the rest only add coherence traffic.
+    static const char* adaptive_env = getenv("ARGON2_ADAPTIVE_THREADS");
+    const bool adaptive = (adaptive_env != NULL && adaptive_env[0] == '1')
+            && instance->passes >= 3;
+    uint64_t previous_pass_cycles = 0;
+    int climb_direction = -1; //try narrower first: the common knee is below the max
+    // The executor may grant fewer workers than requested when a process-wide
+    // concurrency limit is set; the team simply runs narrower
+    uint32_t worker_count = pool.Reserve(requested, true, bulk);
+    if (instance->stats != NULL) {
+        // What the fill actually runs with: narrowed by lanes and by the
+        // process-wide cap, which a raw context->threads never shows
+        instance->stats->threads_used = worker_count;
     }
-    for (uint32_t r = 0; r < instance->passes; ++r) {
+    // A note on distributing lanes across nodes: the slice barriers below do
+    // delimit when remote data could be exchanged, but they do not bound how
+    // much. IndexAlpha() lets every block reference any block of any OTHER
+    // lane's preceding slices (up to ~3/4 of that lane, refreshed every
+    // pass), so partitioned nodes would each need nearly the full array
+    // locally - shipping "the preceding slices' segments" at sync points is
+    // full replication per pass, and per-reference remote fetches sit on the
+    // latency path of every block. Lane partitioning over a network does not
+    // reduce per-node memory for this memory-hard function; that resistance
+    // to partitioning is a design goal of the primitive, not an accident of
+    // this implementation.
+    // Sticky stop flag: set by any worker before a barrier, read by all after
+    // it, so the whole team leaves the pass at the same slice boundary
+    std::atomic<bool> team_stop(false);
+    for (uint32_t r = start_pass; r < instance->passes && !team_stop.load(); ++r) {
+        uint64_t pass_start = Argon2Cycles();
         if (Argon2_ds == instance->type) {
             GenerateSbox(instance);
         }
+        // Small segments: fuse several lanes into one steal, otherwise the
+        // queue traffic and scheduling overhead dominate 8-16 MB hashes with
+        // many lanes. Batches stay narrow enough to keep every worker busy.
+        // (Recomputed per pass: a bulk yield can change the team width.)
+        uint32_t lane_batch = 1;
+        if (instance->segment_length < 1024) {
+            lane_batch = 1024 / instance->segment_length;
+            uint32_t max_balanced = (instance->lanes + worker_count - 1) / worker_count;
+            if (lane_batch > max_balanced) {
+                lane_batch = max_balanced;
+            }
+            if (lane_batch == 0) {
+                lane_batch = 1;
+            }
+        }
+        // Long-lived workers: each steals lanes from a shared per-slice queue
+        // and meets the others at a barrier after every slice, so a slow lane
+        // (NUMA-remote memory, a preempted core) cannot stall idle workers.
+        // At full-size segments (lane_batch == 1) scheduling is sticky: each
+        // worker first claims the lanes it owns by stride - the same lanes it
+        // filled last slice and last pass - so the previous segment's tail,
+        // which FillSegment() immediately reads as prev_offset, is still in
+        // that core's private cache. Stealing remains the fallback, so a slow
+        // worker's lanes still get picked up by idle ones.
+        Argon2Barrier barrier(worker_count);
+        std::atomic<uint32_t> next_lane[ARGON2_SYNC_POINTS];
         for (uint8_t s = 0; s < ARGON2_SYNC_POINTS; ++s) {
-            for (uint32_t l = 0; l < instance->lanes; ++l) {
-                Threads.push_back(std::thread(FillSegment, instance, Argon2_position_t(r, l, s, 0)));
-                if(instance->threads <= Threads.size()){ //have to join extra threads
-                    for (auto& t : Threads) {
-                        t.join();
+            next_lane[s].store(0);
+        }
+        std::unique_ptr<std::atomic<uint32_t>[]> lane_claims;
+        if (lane_batch == 1) {
+            lane_claims.reset(new std::atomic<uint32_t>[(size_t) ARGON2_SYNC_POINTS * instance->lanes]);
+            for (size_t c = 0; c < (size_t) ARGON2_SYNC_POINTS * instance->lanes; ++c) {
+                lane_claims[c].store(0);
+            }
+        }
+        std::atomic<uint32_t>* claims = lane_claims.get();
+        std::atomic<uint32_t>* lane_queues = next_lane;
+        std::atomic<bool>* stop = &team_stop;
+        Argon2TaskGroup group(pool);
+        for (uint32_t w = 0; w < worker_count; ++w) {
+            group.Spawn([instance, r, lane_queues, claims, stop, lane_batch, w, worker_count, &barrier]() {
+                for (uint8_t s = 0; s < ARGON2_SYNC_POINTS; ++s) {
+                    if (claims != NULL) {
+                        // Sticky pass: owned lanes first, then steal leftovers
+                        std::atomic<uint32_t>* slice_claims = claims + (size_t) s * instance->lanes;
+                        for (uint32_t sweep = 0; sweep < 2; ++sweep) {
+                            uint32_t start_lane = (sweep == 0) ? w : 0;
+                            uint32_t stride = (sweep == 0) ? worker_count : 1;
+                            for (uint32_t l = start_lane; l < instance->lanes; l += stride) {
+                                if (slice_claims[l].exchange(1) != 0) {
+                                    continue;
+                                }
+                                if (instance->affinity != NULL && instance->affinity_length > 0) {
+                                    Argon2BindCurrentThread(instance->affinity[l % instance->affinity_length]);
+                                }
+                                FillSegment(instance, Argon2_position_t(r, l, s, 0));
+                            }
+                        }
+                        if (instance->Cancelled()) {
+                            stop->store(true);
+                        }
+                        if (barrier.ArriveAndWait()) {
+                            instance->ReportProgress(r, s);
+                        }
+                        if (stop->load()) {
+                            break;
+                        }
+                        continue;
+                    }
+                    for (uint32_t l0 = lane_queues[s].fetch_add(lane_batch); l0 < instance->lanes; l0 = lane_queues[s].fetch_add(lane_batch)) {
+                        uint32_t l1 = (l0 + lane_batch < instance->lanes) ? l0 + lane_batch : instance->lanes;
+                        for (uint32_t l = l0; l < l1;) {
+                            if (instance->affinity != NULL && instance->affinity_length > 0) {
+                                // Keep the lane near its memory on multi-socket
+                                // machines; pinning is per lane, so no pairing
+                                Argon2BindCurrentThread(instance->affinity[l % instance->affinity_length]);
+                                FillSegment(instance, Argon2_position_t(r, l, s, 0));
+                                ++l;
+                            } else if (PairFillEnabled() && l + 1 < l1) {
+                                // Same-slice segments are independent: fill two
+                                // lanes with their BlaMka chains interleaved
+                                FillSegmentPair(instance, Argon2_position_t(r, l, s, 0), Argon2_position_t(r, l + 1, s, 0));
+                                l += 2;
+                            } else {
+                                FillSegment(instance, Argon2_position_t(r, l, s, 0));
+                                ++l;
+                            }
+                        }
+                    }
+                    if (instance->Cancelled()) {
+                        stop->store(true);
+                    }
+                    if (barrier.ArriveAndWait()) {
+                        // Exactly one worker per slice reports progress
+                        instance->ReportProgress(r, s);
+                    }
+                    if (stop->load()) {
+                        break;
                     }
-                    Threads.clear();
                 }
-            }
-            if(!Threads.empty()){
-                for (auto& t : Threads) {
-                    t.join();
+                if (instance->affinity != NULL && instance->affinity_length > 0) {
+                    // Return the worker to the scheduler for later unpinned hashes
+                    Argon2UnbindCurrentThread();
+                }
+            });
+        }
+        group.Wait();
+        uint64_t pass_cycles = Argon2Cycles() - pass_start;
+        if (instance->stats != NULL) {
+            // Pass granularity only: slices complete inside the barrier
+            // teams. Passes beyond the cap fold into the last slot, same as
+            // the single-threaded accounting.
+            uint32_t slot = (r < ARGON2_STATS_MAX_PASSES) ? r : ARGON2_STATS_MAX_PASSES - 1;
+            instance->stats->pass_cycles[slot] += pass_cycles;
+        }
+        if (adaptive && !team_stop.load() && r + 1 < instance->passes) {
+            // Same work every pass, so cycles compare directly: keep walking
+            // while the last step helped, turn around when it hurt
+            if (previous_pass_cycles != 0) {
+                if (pass_cycles > previous_pass_cycles) {
+                    climb_direction = -climb_direction;
+                }
+                uint32_t max_width = (instance->threads < instance->lanes)
+                        ? instance->threads : instance->lanes;
+                uint32_t next_width = requested;
+                if (climb_direction < 0 && requested > 1) {
+                    next_width = requested - 1;
+                } else if (climb_direction > 0 && requested < max_width) {
+                    next_width = requested + 1;
+                }
+                if (next_width != requested) {
+                    pool.Release(worker_count);
+                    requested = next_width;
+                    worker_count = pool.Reserve(requested, true, bulk);
                 }
-                Threads.clear();
             }
+            previous_pass_cycles = pass_cycles;
+        }
+        if (!team_stop.load()) {
+            // Pass granularity with a worker team: a mid-pass snapshot would
+            // have to stop every barrier team anyway
+            MaybeCheckpoint(instance, r, ARGON2_SYNC_POINTS - 1);
         }
-        if(instance->internal_print){
+        if (ARGON2_KAT_ENABLED && instance->internal_print) {
             InternalKat(instance, r); // Print all memory blocks
         }
+        if (bulk && !team_stop.load() && r + 1 < instance->passes && pool.InteractiveWaiting()) {
+            // Yield at the pass boundary: requeue behind the interactive
+            // requests and take a (possibly different) worker grant back
+            pool.Release(worker_count);
+            worker_count = pool.Reserve(requested, true, bulk);
+        }
     }
+    pool.Release(worker_count);
+    return team_stop.load() ? ARGON2_CANCELLED : ARGON2_OK;
 }
 
 int ValidateInputs(const Argon2_Context* context) {
@@ -186,9 +1630,14 @@ int ValidateInputs(const Argon2_Context* context) {
         return ARGON2_INCORRECT_PARAMETER;
     }
 
-    if (NULL == context->out) {
+    if (NULL == context->out && NULL == context->tag_sink) {
         return ARGON2_OUTPUT_PTR_NULL;
     }
+    if (NULL != context->tag_sink && !context->parallel_tag) {
+        // The chained expansion is inherently sequential in its output
+        // buffer; streaming delivery exists only for the counter mode
+        return ARGON2_INCORRECT_PARAMETER;
+    }
 
     /* Validate output length */
     if (ARGON2_MIN_OUTLEN > context->outlen) {
@@ -278,8 +1727,8 @@ int ValidateInputs(const Argon2_Context* context) {
         return ARGON2_LANES_TOO_MANY;
     }
     
-    /* Validate threads */
-    if (ARGON2_MIN_THREADS > context->threads) {
+    /* Validate threads (0 = auto: one worker per physical core) */
+    if (context->threads != 0 && ARGON2_MIN_THREADS > context->threads) {
         return ARGON2_THREADS_TOO_FEW;
     }
     if (ARGON2_MAX_THREADS < context->threads) {
@@ -297,45 +1746,159 @@ int ValidateInputs(const Argon2_Context* context) {
     return ARGON2_OK;
 }
 
+void PlaceMemoryByLane(const Argon2_instance_t* instance) {
+    if (instance == NULL || instance->threads <= 1) {
+        return;
+    }
+    const size_t page_size = 4096;
+    const bool pin = (instance->affinity != NULL && instance->affinity_length > 0);
+    Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+    pool.EnsureSpareWorkers((instance->threads < instance->lanes) ? instance->threads : instance->lanes);
+    Argon2TaskGroup group(pool);
+    for (uint32_t l = 0; l < instance->lanes; ++l) {
+        group.Spawn([instance, l, page_size, pin]() {
+            if (pin) {
+                Argon2BindCurrentThread(instance->affinity[l % instance->affinity_length]);
+            }
+            // Under the slice-interleaved layout the lane's blocks are not
+            // physically contiguous, but this lane's 1/lanes share of the
+            // array is still a valid parallel prefault partition - touch the
+            // physical range instead
+            uint8_t* lane_start = instance->slice_interleaved
+                    ? (uint8_t*) instance->memory + (size_t) l * instance->lane_length * ARGON2_BLOCK_SIZE
+                    : (uint8_t*) instance->BlockAt(l * instance->lane_length);
+            size_t lane_bytes = (size_t) instance->lane_length * ARGON2_BLOCK_SIZE;
+            // One write per page is enough to take the soft fault here (with
+            // all workers in parallel) instead of serially inside pass 0, and
+            // to claim the page for this lane's node when pinned
+            for (size_t offset = 0; offset < lane_bytes; offset += page_size) {
+                lane_start[offset] = 0;
+            }
+            if (pin) {
+                Argon2UnbindCurrentThread();
+            }
+        });
+    }
+    group.Wait();
+}
+
+void FillLaneSeedBlocks(const Argon2_instance_t* instance, uint32_t lane) {
+    // Exactly one slice-0 task is dispatched per lane (the claim/queue hand
+    // out each (slice, lane) once), so no flag is needed: the task that
+    // fills this segment is the only writer and the only reader of the seeds
+    uint8_t seed[ARGON2_PREHASH_SEED_LENGTH];
+    memcpy(seed, instance->seed_hash, ARGON2_PREHASH_SEED_LENGTH);
+    store32(seed + ARGON2_PREHASH_DIGEST_LENGTH + 4, lane);
+    store32(seed + ARGON2_PREHASH_DIGEST_LENGTH, 0);
+    blake2b_long((uint8_t*) (instance->BlockAt(lane * instance->lane_length)->v), ARGON2_BLOCK_SIZE, seed, ARGON2_PREHASH_SEED_LENGTH);
+    store32(seed + ARGON2_PREHASH_DIGEST_LENGTH, 1);
+    blake2b_long((uint8_t*) (instance->BlockAt(lane * instance->lane_length + 1)->v), ARGON2_BLOCK_SIZE, seed, ARGON2_PREHASH_SEED_LENGTH);
+    secure_wipe_memory(seed, ARGON2_PREHASH_SEED_LENGTH);
+}
+
 void FillFirstBlocks(uint8_t* blockhash, const Argon2_instance_t* instance) {
     // Make the first and second block in each lane as G(H0||i||0) or G(H0||i||1)
+    if (instance->threads > 1 && instance->lanes > 1) {
+        // The 2*lanes seed expansions are independent; fan them out over the
+        // pool so first-block generation stops being a serial prologue. Each
+        // task works on its own copy of the seed since the counters differ.
+        Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+        pool.EnsureSpareWorkers((instance->threads < instance->lanes) ? instance->threads : instance->lanes);
+        Argon2TaskGroup group(pool);
+        for (uint32_t l = 0; l < instance->lanes; ++l) {
+            group.Spawn([instance, blockhash, l]() {
+                uint8_t seed[ARGON2_PREHASH_SEED_LENGTH];
+                memcpy(seed, blockhash, ARGON2_PREHASH_SEED_LENGTH);
+                store32(seed+ARGON2_PREHASH_DIGEST_LENGTH + 4,l);
+                store32(seed+ARGON2_PREHASH_DIGEST_LENGTH,0);
+                blake2b_long((uint8_t*) (instance->BlockAt(l * instance->lane_length)->v),  ARGON2_BLOCK_SIZE,seed, ARGON2_PREHASH_SEED_LENGTH);
+
+                store32(seed+ARGON2_PREHASH_DIGEST_LENGTH,1);
+                blake2b_long((uint8_t*) (instance->BlockAt(l * instance->lane_length + 1)->v),  ARGON2_BLOCK_SIZE,seed, ARGON2_PREHASH_SEED_LENGTH);
+                secure_wipe_memory(seed, ARGON2_PREHASH_SEED_LENGTH);
+            });
+        }
+        group.Wait();
+        return;
+    }
     for (uint32_t l = 0; l < instance->lanes; ++l) {
         store32(blockhash+ARGON2_PREHASH_DIGEST_LENGTH + 4,l);
         store32(blockhash+ARGON2_PREHASH_DIGEST_LENGTH,0);
-        blake2b_long((uint8_t*) (instance->memory[l * instance->lane_length].v),  ARGON2_BLOCK_SIZE,blockhash, ARGON2_PREHASH_SEED_LENGTH);
+        blake2b_long((uint8_t*) (instance->BlockAt(l * instance->lane_length)->v),  ARGON2_BLOCK_SIZE,blockhash, ARGON2_PREHASH_SEED_LENGTH);
 
         store32(blockhash+ARGON2_PREHASH_DIGEST_LENGTH,1);
-        blake2b_long((uint8_t*) (instance->memory[l * instance->lane_length + 1].v),  ARGON2_BLOCK_SIZE,blockhash, ARGON2_PREHASH_SEED_LENGTH);
+        blake2b_long((uint8_t*) (instance->BlockAt(l * instance->lane_length + 1)->v),  ARGON2_BLOCK_SIZE,blockhash, ARGON2_PREHASH_SEED_LENGTH);
     }
 }
 
-void InitialHash(uint8_t* blockhash, Argon2_Context* context, Argon2_type type) {
-    blake2b_state BlakeHash;
+/*
+ * Absorbs the six fixed deployment parameters into a fresh hash state; the
+ * shared prologue of InitialHash() and Argon2MakePrefix().
+ */
+static void AbsorbParameters(blake2b_state* BlakeHash, uint32_t lanes, uint32_t outlen,
+        uint32_t m_cost, uint32_t t_cost, Argon2_type type) {
     uint8_t value[sizeof (uint32_t)];
 
-    if (NULL == context || NULL == blockhash) {
-        return;
-    }
-
-    blake2b_init(&BlakeHash, ARGON2_PREHASH_DIGEST_LENGTH);
+    blake2b_init(BlakeHash, ARGON2_PREHASH_DIGEST_LENGTH);
 
-    store32(&value, context->lanes);
-    blake2b_update(&BlakeHash, (const uint8_t*) &value, sizeof (value));
+    store32(&value, lanes);
+    blake2b_update(BlakeHash, (const uint8_t*) &value, sizeof (value));
 
-    store32(&value, context->outlen);
-    blake2b_update(&BlakeHash, (const uint8_t*) &value, sizeof (value));
+    store32(&value, outlen);
+    blake2b_update(BlakeHash, (const uint8_t*) &value, sizeof (value));
 
-    store32(&value, context->m_cost);
-    blake2b_update(&BlakeHash, (const uint8_t*) &value, sizeof (value));
+    store32(&value, m_cost);
+    blake2b_update(BlakeHash, (const uint8_t*) &value, sizeof (value));
 
-    store32(&value, context->t_cost);
-    blake2b_update(&BlakeHash, (const uint8_t*) &value, sizeof (value));
+    store32(&value, t_cost);
+    blake2b_update(BlakeHash, (const uint8_t*) &value, sizeof (value));
 
     store32(&value, ARGON2_VERSION_NUMBER);
-    blake2b_update(&BlakeHash, (const uint8_t*) &value, sizeof (value));
+    blake2b_update(BlakeHash, (const uint8_t*) &value, sizeof (value));
 
     store32(&value, (uint32_t) type);
-    blake2b_update(&BlakeHash, (const uint8_t*) &value, sizeof (value));
+    blake2b_update(BlakeHash, (const uint8_t*) &value, sizeof (value));
+}
+
+int Argon2MakePrefix(Argon2_Prefix* prefix, uint32_t lanes, uint32_t outlen,
+        uint32_t m_cost, uint32_t t_cost, uint32_t type) {
+    static_assert(sizeof (blake2b_state) <= sizeof (prefix->state),
+            "Argon2_Prefix::state must hold a blake2b_state");
+    if (prefix == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    blake2b_state BlakeHash;
+    AbsorbParameters(&BlakeHash, lanes, outlen, m_cost, t_cost, (Argon2_type) type);
+    memcpy(prefix->state, &BlakeHash, sizeof (BlakeHash));
+    prefix->lanes = lanes;
+    prefix->outlen = outlen;
+    prefix->m_cost = m_cost;
+    prefix->t_cost = t_cost;
+    prefix->type = type;
+    prefix->valid = true;
+    return ARGON2_OK;
+}
+
+void InitialHash(uint8_t* blockhash, Argon2_Context* context, Argon2_type type) {
+    blake2b_state BlakeHash;
+    uint8_t value[sizeof (uint32_t)];
+
+    if (NULL == context || NULL == blockhash) {
+        return;
+    }
+
+    if (context->prefix != NULL && context->prefix->valid
+            && context->prefix->lanes == context->lanes
+            && context->prefix->outlen == context->outlen
+            && context->prefix->m_cost == context->m_cost
+            && context->prefix->t_cost == context->t_cost
+            && context->prefix->type == (uint32_t) type) {
+        // Clone the precomputed parameter prefix instead of re-absorbing it
+        memcpy(&BlakeHash, context->prefix->state, sizeof (BlakeHash));
+    } else {
+        AbsorbParameters(&BlakeHash, context->lanes, context->outlen,
+                context->m_cost, context->t_cost, type);
+    }
 
     store32(&value, context->pwdlen);
     blake2b_update(&BlakeHash, (const uint8_t*) &value, sizeof (value));
@@ -377,22 +1940,43 @@ int Initialize(Argon2_instance_t* instance, Argon2_Context* context) {
     
     // 1. Memory allocation
     int result = ARGON2_OK;
-    if (NULL != context->allocate_cbk) {
+    if (NULL != context->arena) {
+        // Borrow from the arena; grow it when this m_cost does not fit
+        Argon2_Arena* arena = context->arena;
+        result = BorrowArenaMemory(arena,
+                (size_t) instance->memory_blocks * ARGON2_BLOCK_SIZE,
+                instance->memory_blocks);
+        if (ARGON2_OK != result) {
+            return result;
+        }
+        instance->memory = (block*) arena->memory;
+        instance->Sbox = arena->sbox; //may be NULL; GenerateSbox allocates on demand
+    } else if (NULL != context->allocate_cbk) {
          uint8_t *p;
         result = context->allocate_cbk(&p, instance->memory_blocks *
                                                ARGON2_BLOCK_SIZE);
         if (ARGON2_OK != result) {
             return result;
         }
-        memcpy(&(instance->memory), p, sizeof(instance->memory));
+        instance->memory = (block*) p;
     } else {
         result = AllocateMemory(&(instance->memory), instance->memory_blocks);
+        if (ARGON2_MEMORY_ALLOCATION_ERROR == result) {
+            // No contiguous range of that size: fall back to per-lane chunks.
+            // A quota refusal is not retried - chunking needs the same total.
+            instance->slice_interleaved = false; //chunks are lane-major
+            result = AllocateLaneChunks(instance);
+        }
     }
 
     if (ARGON2_OK != result) {
         return result;
     }
 
+    if (context->lock_memory) {
+        LockInstanceMemory(instance);
+    }
+
     // 2. Initial hashing
     // H_0 + 8 extra bytes to produce the first blocks
     uint8_t blockhash[ARGON2_PREHASH_SEED_LENGTH];
@@ -401,24 +1985,184 @@ int Initialize(Argon2_instance_t* instance, Argon2_Context* context) {
     // Zeroing 8 extra bytes
     secure_wipe_memory(blockhash + ARGON2_PREHASH_DIGEST_LENGTH, ARGON2_PREHASH_SEED_LENGTH - ARGON2_PREHASH_DIGEST_LENGTH);
 
-    if(context->print){ //shall we print the current state
+    if (ARGON2_KAT_ENABLED && context->print) { //shall we print the current state
         InitialKat(blockhash, context, instance->type);
     }
 
+    // Binds snapshots to every input H0 absorbs (password, salt, costs,
+    // lanes); H0 itself never reaches the disk. Cheap enough to do always,
+    // and the resume path needs it with checkpointing off.
+    blake2b(instance->checkpoint_digest, sizeof (instance->checkpoint_digest),
+            blockhash, ARGON2_PREHASH_DIGEST_LENGTH, NULL, 0);
+
     // 3. Creating first blocks, we always have at least two blocks in a slice
-    FillFirstBlocks(blockhash, instance);
+    // NUMA placement first, so the initial blocks are written to local pages
+    PlaceMemoryByLane(instance);
+    if (instance->threads > 1 && instance->lanes > 1 && Argon2_ds != instance->type
+            && instance->resume_pass == 0 && instance->resume_slice == 0) {
+        // Pipeline the prologue: pass-0 slice-0 references stay within the
+        // lane, so each lane's segment can start the moment its own two seed
+        // blocks exist. Defer the 2*lanes blake2b_long() expansions into the
+        // slice-0 dispatch instead of running them as a barrier here. The
+        // seed lives on the instance until teardown (like checkpoint_digest);
+        // Argon2_ds stays eager - its Sbox reads lane 0's first block at
+        // pass entry, before any segment runs.
+        memcpy(instance->seed_hash, blockhash, ARGON2_PREHASH_SEED_LENGTH);
+        instance->seeds_deferred = true;
+    } else {
+        FillFirstBlocks(blockhash, instance);
+    }
     // Clearing the hash
     secure_wipe_memory(blockhash, ARGON2_PREHASH_SEED_LENGTH);
 
     return ARGON2_OK;
 }
 
-int Argon2Core(Argon2_Context* context, Argon2_type type) {
+int Argon2MakeParams(Argon2_Params* params, uint32_t type, uint32_t t_cost,
+        uint32_t m_cost, uint32_t lanes, uint32_t threads) {
+    if (params == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    params->valid = false;
+    if (Argon2_d != (Argon2_type) type && Argon2_i != (Argon2_type) type
+            && Argon2_id != (Argon2_type) type && Argon2_ds != (Argon2_type) type) {
+        return ARGON2_INCORRECT_TYPE;
+    }
+    if (ARGON2_MIN_MEMORY > m_cost) {
+        return ARGON2_MEMORY_TOO_LITTLE;
+    }
+    if (ARGON2_MAX_MEMORY < m_cost) {
+        return ARGON2_MEMORY_TOO_MUCH;
+    }
+    if (ARGON2_MIN_TIME > t_cost || ARGON2_MAX_TIME < t_cost) {
+        return (ARGON2_MIN_TIME > t_cost) ? ARGON2_TIME_TOO_SMALL : ARGON2_TIME_TOO_LARGE;
+    }
+    if (ARGON2_MIN_LANES > lanes) {
+        return ARGON2_LANES_TOO_FEW;
+    }
+    if (ARGON2_MAX_LANES < lanes) {
+        return ARGON2_LANES_TOO_MANY;
+    }
+    if (ARGON2_MIN_THREADS > threads) {
+        return ARGON2_THREADS_TOO_FEW;
+    }
+    if (ARGON2_MAX_THREADS < threads) {
+        return ARGON2_THREADS_TOO_MANY;
+    }
+
+    // Same alignment arithmetic as Argon2Core, done once
+    uint32_t memory_blocks = m_cost;
+    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * lanes) {
+        memory_blocks = 2 * ARGON2_SYNC_POINTS * lanes;
+    }
+    uint32_t segment_length = memory_blocks / (lanes * ARGON2_SYNC_POINTS);
+    memory_blocks = segment_length * (lanes * ARGON2_SYNC_POINTS);
+
+    params->type = type;
+    params->t_cost = t_cost;
+    params->m_cost = m_cost;
+    params->lanes = lanes;
+    params->threads = threads;
+    params->memory_blocks = memory_blocks;
+    params->lane_length = memory_blocks / lanes;
+    params->segment_length = segment_length;
+    params->valid = true;
+    return ARGON2_OK;
+}
+
+int Argon2HashWithParams(const Argon2_Params* params, const void* pwd, size_t pwdlen,
+        const void* salt, size_t saltlen, void* out, size_t outlen) {
+    if (params == NULL || !params->valid) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    // Only the per-request inputs need checking here
+    if (out == NULL) {
+        return ARGON2_OUTPUT_PTR_NULL;
+    }
+    if (ARGON2_MIN_OUTLEN > outlen) {
+        return ARGON2_OUTPUT_TOO_SHORT;
+    }
+    if (ARGON2_MAX_OUTLEN < outlen) {
+        return ARGON2_OUTPUT_TOO_LONG;
+    }
+    if (pwd == NULL && pwdlen != 0) {
+        return ARGON2_PWD_PTR_MISMATCH;
+    }
+    if (salt == NULL || ARGON2_MIN_SALT_LENGTH > saltlen) {
+        return ARGON2_SALT_TOO_SHORT;
+    }
+    if (ARGON2_MAX_SALT_LENGTH < saltlen) {
+        return ARGON2_SALT_TOO_LONG;
+    }
+
+    Argon2_Context context((uint8_t*) out, (uint32_t) outlen,
+            (uint8_t*) pwd, (uint32_t) pwdlen,
+            (uint8_t*) salt, (uint32_t) saltlen,
+            NULL, 0, NULL, 0,
+            params->t_cost, params->m_cost, params->lanes, params->threads,
+            NULL, NULL, false, false, false, false);
+
+    // The geometry comes prederived from the params object; no revalidation,
+    // no rounding arithmetic on the per-request path
+    Argon2_instance_t instance(NULL, (Argon2_type) params->type, params->t_cost,
+            params->memory_blocks, params->lanes, params->threads, false);
+
+    int result = Initialize(&instance, &context);
+    if (ARGON2_OK != result) {
+        return result;
+    }
+    result = FillMemoryBlocks(&instance);
+    if (ARGON2_OK != result) {
+        ReleaseInstanceMemory(context.clear_memory, context.free_cbk, context.arena, &instance, context.lock_memory);
+        return result;
+    }
+    Finalize(&context, &instance);
+    return ARGON2_OK;
+}
+
+/* threads == 0 asks for auto width: one worker per physical core, capped at
+ * the lane count (extra workers past lanes would only idle at barriers) */
+static uint32_t ResolveThreads(const Argon2_Context* context) {
+    if (context->threads != 0) {
+        return context->threads;
+    }
+    uint32_t cores = Argon2PhysicalCores();
+    return (context->lanes != 0 && context->lanes < cores) ? context->lanes : cores;
+}
+
+#if !defined(_WIN32)
+/* Fault and peak-RSS readings around a hash, for the opt-in stats */
+static void ReadResourceUsage(uint64_t* faults, int64_t* peak_rss_kb) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        *faults = (uint64_t) usage.ru_minflt + (uint64_t) usage.ru_majflt;
+        *peak_rss_kb = (int64_t) usage.ru_maxrss;
+    } else {
+        *faults = 0;
+        *peak_rss_kb = 0;
+    }
+}
+#endif
+
+static int Argon2CoreImpl(Argon2_Context* context, Argon2_type type, uint8_t* pre_tag) {
+    uint64_t phase_start = Argon2Cycles();
+#if !defined(_WIN32)
+    uint64_t faults_before = 0;
+    int64_t rss_before = 0;
+    if (context != NULL && context->stats != NULL) {
+        ReadResourceUsage(&faults_before, &rss_before);
+    }
+#endif
     /* 1. Validate all inputs */
     int result = ValidateInputs(context);
     if (ARGON2_OK != result) {
         return result;
     }
+    if (context->stats != NULL) {
+        uint64_t now = Argon2Cycles();
+        context->stats->validate_cycles += now - phase_start;
+        phase_start = now;
+    }
     if (Argon2_d != type && Argon2_i != type && Argon2_id != type && Argon2_ds != type) {
         return ARGON2_INCORRECT_TYPE;
     }
@@ -433,19 +2177,184 @@ int Argon2Core(Argon2_Context* context, Argon2_type type) {
     // Ensure that all segments have equal length
     memory_blocks = segment_length * (context->lanes * ARGON2_SYNC_POINTS);
     const bool print_internals = context->print; //Should we print the memory blocks to the file
-    Argon2_instance_t instance(NULL, type, context->t_cost, memory_blocks, context->lanes, context->threads,print_internals);
+    Argon2_instance_t instance(NULL, type, context->t_cost, memory_blocks, context->lanes, ResolveThreads(context),print_internals,
+            context->affinity, context->affinity_length, context->cancel, context->priority,
+            context->progress_cbk, context->progress_data);
+
+    instance.stats = context->stats;
+
+    // Opt-in slice-interleaved layout: power-of-two geometry only, and the
+    // chunked allocation fallback clears it (chunks are lane-major by
+    // construction)
+    {
+        static const char* interleave_env = getenv("ARGON2_INTERLEAVED_LAYOUT");
+        if (interleave_env != NULL && interleave_env[0] == '1'
+                && instance.lane_length_mask != 0
+                && (instance.segment_length & (instance.segment_length - 1)) == 0
+                && instance.segment_length != 0) {
+            instance.slice_interleaved = true;
+            uint32_t shift = 0;
+            while ((1u << shift) < instance.lane_length) {
+                ++shift;
+            }
+            instance.lane_shift = shift;
+            shift = 0;
+            while ((1u << shift) < instance.segment_length) {
+                ++shift;
+            }
+            instance.segment_shift = shift;
+        }
+    }
 
     /* 3. Initialization: Hashing inputs, allocating memory, filling first blocks */
     result = Initialize(&instance, context);
     if (ARGON2_OK != result) {
         return result;
     }
+    if (context->stats != NULL) {
+        uint64_t now = Argon2Cycles();
+        context->stats->initialize_cycles += now - phase_start;
+        phase_start = now;
+    }
 
     /* 4. Filling memory */
-    FillMemoryBlocks(&instance);
+    result = FillMemoryBlocks(&instance);
+    if (ARGON2_OK != result) {
+        // Cancelled: no tag, but wipe/free the memory as on the normal path
+        // (synchronously - there is no latency to hide on an abort)
+        ReleaseInstanceMemory(context->clear_memory, context->free_cbk, context->arena, &instance, context->lock_memory);
+        return result;
+    }
+
+    if (context->stats != NULL) {
+        uint64_t now = Argon2Cycles();
+        context->stats->fill_cycles += now - phase_start;
+        phase_start = now;
+    }
 
     /* 5. Finalization */
-    Finalize(context, &instance);
+    if (pre_tag != NULL) {
+        FinalizePreTag(context, &instance, pre_tag);
+    } else {
+        result = Finalize(context, &instance);
+        if (ARGON2_OK != result) {
+            return result;
+        }
+    }
+    if (context->stats != NULL) {
+        context->stats->finalize_cycles += Argon2Cycles() - phase_start;
+        context->stats->bytes_filled +=
+                (uint64_t) memory_blocks * ARGON2_BLOCK_SIZE * context->t_cost;
+#if !defined(_WIN32)
+        uint64_t faults_after = 0;
+        int64_t rss_after = 0;
+        ReadResourceUsage(&faults_after, &rss_after);
+        context->stats->page_faults += faults_after - faults_before;
+        int64_t growth = rss_after - rss_before;
+        if (growth > context->stats->peak_rss_delta_kb) {
+            context->stats->peak_rss_delta_kb = growth;
+        }
+#endif
+    }
 
     return ARGON2_OK;
 }
+
+int Argon2Core(Argon2_Context* context, Argon2_type type) {
+    return Argon2CoreImpl(context, type, NULL);
+}
+
+int Argon2CoreToPreTag(Argon2_Context* context, Argon2_type type, uint8_t* pre_tag) {
+    if (pre_tag == NULL) {
+        return ARGON2_OUT_PTR_MISMATCH;
+    }
+    return Argon2CoreImpl(context, type, pre_tag);
+}
+
+int Argon2ResumeHash(Argon2_Context* context, uint32_t type_code, const char* path) {
+    Argon2_type type = (Argon2_type) type_code;
+    if (path == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    int result = ValidateInputs(context);
+    if (ARGON2_OK != result) {
+        return result;
+    }
+    if (Argon2_d != type && Argon2_i != type && Argon2_id != type && Argon2_ds != type) {
+        return ARGON2_INCORRECT_TYPE;
+    }
+
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    uint8_t header[8 + 6 * 4 + 32];
+    if (fread(header, sizeof (header), 1, f) != 1
+            || memcmp(header, ARGON2_CHECKPOINT_MAGIC, 8) != 0) {
+        fclose(f);
+        return ARGON2_DECODING_FAIL;
+    }
+    uint32_t saved_type = load32(header + 8);
+    uint32_t saved_passes = load32(header + 12);
+    uint32_t saved_blocks = load32(header + 16);
+    uint32_t saved_lanes = load32(header + 20);
+    uint32_t next_pass = load32(header + 24);
+    uint32_t next_slice = load32(header + 28);
+
+    uint32_t memory_blocks = context->m_cost;
+    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * context->lanes) {
+        memory_blocks = 2 * ARGON2_SYNC_POINTS * context->lanes;
+    }
+    uint32_t segment_length = memory_blocks / (context->lanes * ARGON2_SYNC_POINTS);
+    memory_blocks = segment_length * (context->lanes * ARGON2_SYNC_POINTS);
+
+    if (saved_type != (uint32_t) type || saved_passes != context->t_cost
+            || saved_blocks != memory_blocks || saved_lanes != context->lanes
+            || next_pass >= saved_passes || next_slice >= ARGON2_SYNC_POINTS
+            // ds only ever snapshots at pass boundaries (its per-pass Sbox is
+            // not in the snapshot); a mid-pass ds position is forged/corrupt
+            || (Argon2_ds == type && next_slice != 0)) {
+        fclose(f);
+        return ARGON2_DECODING_FAIL;
+    }
+
+    Argon2_instance_t instance(NULL, type, context->t_cost, memory_blocks,
+            context->lanes, ResolveThreads(context), context->print,
+            context->affinity, context->affinity_length, context->cancel, context->priority,
+            context->progress_cbk, context->progress_data);
+
+    // Initialize() recomputes H0 (and with it the binding digest), allocates
+    // the array and refills the first blocks - which the snapshot then
+    // overwrites wholesale. The microseconds wasted are not worth a second
+    // initialization path.
+    result = Initialize(&instance, context);
+    if (ARGON2_OK != result) {
+        fclose(f);
+        return result;
+    }
+    if (memcmp(header + 32, instance.checkpoint_digest, 32) != 0) {
+        // Wrong password, salt or costs for this snapshot
+        fclose(f);
+        ReleaseInstanceMemory(context->clear_memory, context->free_cbk, context->arena, &instance, context->lock_memory);
+        return ARGON2_VERIFY_MISMATCH;
+    }
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < instance.memory_blocks; ++i) {
+        ok = fread(instance.BlockAt(i)->v, ARGON2_BLOCK_SIZE, 1, f) == 1;
+    }
+    fclose(f);
+    if (!ok) {
+        ReleaseInstanceMemory(context->clear_memory, context->free_cbk, context->arena, &instance, context->lock_memory);
+        return ARGON2_DECODING_FAIL;
+    }
+
+    instance.resume_pass = next_pass;
+    instance.resume_slice = next_slice;
+    instance.stats = context->stats;
+    result = FillMemoryBlocks(&instance);
+    if (ARGON2_OK != result) {
+        ReleaseInstanceMemory(context->clear_memory, context->free_cbk, context->arena, &instance, context->lock_memory);
+        return result;
+    }
+    return Finalize(context, &instance);
+}
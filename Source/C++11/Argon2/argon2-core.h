@@ -18,6 +18,21 @@
 
 #include <cstring>
 #include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <utility>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*For the vectorized block XOR*/
+#if defined(__aarch64__) || (defined(__arm__) && defined(__ARM_NEON))
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 /*************************Argon2 internal constants**************************************************/
 
@@ -32,6 +47,10 @@ const uint32_t ARGON2_QWORDS_IN_BLOCK = ARGON2_WORDS_IN_BLOCK / 2;
 /* Number of pseudo-random values generated by one call to Blake in Argon2i  to generate reference block positions*/
 const uint32_t ARGON2_ADDRESSES_IN_BLOCK = (ARGON2_BLOCK_SIZE * sizeof (uint8_t) / sizeof (uint64_t));
 
+/* Largest single-lane instance (in blocks) routed to the fused small-instance
+ * fill path: 2 MB keeps the whole block array L2/L3-resident */
+const uint32_t ARGON2_SMALL_INSTANCE_BLOCKS = 2048;
+
 /* Pre-hashing digest length and its extension*/
 const uint32_t ARGON2_PREHASH_DIGEST_LENGTH = 64;
 const uint32_t ARGON2_PREHASH_SEED_LENGTH = ARGON2_PREHASH_DIGEST_LENGTH + 8;
@@ -52,11 +71,86 @@ const uint32_t ARGON2_SBOX_MASK = ARGON2_SBOX_SIZE / 2 - 1;
 
 /*************************Argon2 internal data types**************************************************/
 
+/*
+ * 64-byte-aligned allocator for standard containers that hold block (or
+ * block-bearing nodes): alignas(64) on the element type is invisible to the
+ * C++11 operator new, which only guarantees 16 bytes, while the kernels and
+ * block's own copy/XOR compile to alignment-enforcing vector loads on the
+ * wider ISAs - an under-aligned container node is a latent SIGSEGV that
+ * depends on what the heap happens to return. Containers holding block must
+ * allocate through this instead of the default allocator.
+ */
+template <typename T>
+struct Argon2AlignedAllocator {
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef Argon2AlignedAllocator<U> other;
+    };
+
+    Argon2AlignedAllocator() {
+    }
+
+    template <typename U>
+    Argon2AlignedAllocator(const Argon2AlignedAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+#if defined(_WIN32)
+        void* region = _aligned_malloc(n * sizeof (T), 64);
+        if (region == NULL) {
+            throw std::bad_alloc();
+        }
+#else
+        void* region = NULL;
+        if (posix_memalign(&region, 64, n * sizeof (T)) != 0) {
+            throw std::bad_alloc();
+        }
+#endif
+        return (T*) region;
+    }
+
+    void deallocate(T* region, size_t) {
+#if defined(_WIN32)
+        _aligned_free(region);
+#else
+        free(region);
+#endif
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* object, Args&&... args) {
+        ::new ((void*) object) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    void destroy(U* object) {
+        object->~U();
+    }
+
+    bool operator==(const Argon2AlignedAllocator&) const {
+        return true;
+    }
+
+    bool operator!=(const Argon2AlignedAllocator&) const {
+        return false;
+    }
+};
+
 /*
  * Structure for the (1KB) memory block implemented as 128 64-bit words.
  * Memory blocks can be copied, XORed. Internal words can be accessed by [] (no bounds checking).
+ * Cache-line aligned so the optimized core can use aligned SIMD loads/stores
+ * and no 16-byte lane ever straddles a line.
  */
-struct block {
+struct alignas(64) block {
     uint64_t v[ARGON2_WORDS_IN_BLOCK];
 
     block() { //default ctor
@@ -77,25 +171,69 @@ struct block {
     }
 
     block& operator^=(const block& r) { //Xor-assignment
+#if defined(__AVX512F__)
+        for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; j += 8) {
+            _mm512_store_si512((__m512i*) &v[j], _mm512_xor_si512(
+                    _mm512_load_si512((const __m512i*) &v[j]), _mm512_load_si512((const __m512i*) &r.v[j])));
+        }
+#elif defined(__AVX2__)
+        for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; j += 4) {
+            _mm256_store_si256((__m256i*) &v[j], _mm256_xor_si256(
+                    _mm256_load_si256((const __m256i*) &v[j]), _mm256_load_si256((const __m256i*) &r.v[j])));
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; j += 2) {
+            _mm_store_si128((__m128i*) &v[j], _mm_xor_si128(
+                    _mm_load_si128((const __m128i*) &v[j]), _mm_load_si128((const __m128i*) &r.v[j])));
+        }
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_NEON))
+        for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; j += 2) {
+            vst1q_u64(&v[j], veorq_u64(vld1q_u64(&v[j]), vld1q_u64(&r.v[j])));
+        }
+#else
         for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; ++j) {
             v[j] ^= r.v[j];
         }
+#endif
         return *this;
     }
 
+    /*
+     * Fused XOR into a destination block: one pass, no 1 KB temporary.
+     * @pre @a out must not alias @a l or @a r
+     */
+    static void XorInto(const block& l, const block& r, block& out) {
+#if defined(__AVX512F__)
+        for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; j += 8) {
+            _mm512_store_si512((__m512i*) &out.v[j], _mm512_xor_si512(
+                    _mm512_load_si512((const __m512i*) &l.v[j]), _mm512_load_si512((const __m512i*) &r.v[j])));
+        }
+#elif defined(__AVX2__)
+        for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; j += 4) {
+            _mm256_store_si256((__m256i*) &out.v[j], _mm256_xor_si256(
+                    _mm256_load_si256((const __m256i*) &l.v[j]), _mm256_load_si256((const __m256i*) &r.v[j])));
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; j += 2) {
+            _mm_store_si128((__m128i*) &out.v[j], _mm_xor_si128(
+                    _mm_load_si128((const __m128i*) &l.v[j]), _mm_load_si128((const __m128i*) &r.v[j])));
+        }
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_NEON))
+        for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; j += 2) {
+            vst1q_u64(&out.v[j], veorq_u64(vld1q_u64(&l.v[j]), vld1q_u64(&r.v[j])));
+        }
+#else
+        for (uint32_t j = 0; j < ARGON2_WORDS_IN_BLOCK; ++j) {
+            out.v[j] = l.v[j] ^ r.v[j];
+        }
+#endif
+    }
+
     block(const block& r) {
         memcpy(v, r.v, ARGON2_BLOCK_SIZE);
     }
 };
 
-/*
- *  XORs two blocks
- * @param  l  Left operand
- * @param  r  Right operand
- * @return Xors of the blocks
- */
-block operator^(const block& l, const block& r);
-
 /*
  * Argon2 instance: memory pointer, number of passes, amount of memory, type, and derived values. 
  * Used to evaluate the number and location of blocks to construct in each thread
@@ -109,13 +247,99 @@ struct Argon2_instance_t {
     const Argon2_type type; //Argon2d, 2id, 2i, or 2ds
     const uint32_t lane_length; //Value derived from @memory_blocks and @lanes  --- just for cache and readability
     const uint32_t segment_length;  //Value derived from @lane_length and SYNC_POINTS --- just for cache and readability
+    const uint32_t lane_length_mask; //lane_length - 1 when lane_length is a power of two, else 0; see ModLaneLength()
     uint64_t *Sbox; //S-boxes for Argon2_ds
+    block** lane_chunks; //per-lane chunks when the address space is too fragmented for one contiguous array; NULL when @memory is contiguous
+    const uint32_t *affinity; //optional CPU id per lane (see Argon2_Context)
+    const uint32_t affinity_length; //number of entries in @affinity
+    const std::atomic<bool> *cancel; //optional cancellation token (see Argon2_Context)
+    const Argon2_priority priority; //scheduling class on the shared executor (see Argon2_Context)
+    const ProgressCallback progress_cbk; //optional per-slice progress hook (see Argon2_Context)
+    void *const progress_data; //opaque pointer handed back to @progress_cbk
     const bool internal_print; //whether to print the memory blocks to the file - for test vectors only!
 
-    Argon2_instance_t(block* ptr, Argon2_type t, uint32_t p, uint32_t m, uint32_t l, uint32_t thr, bool pr) :
+    /* Checkpoint/resume state (argon2-core.cpp): where FillMemoryBlocks()
+     * starts, the parameter-binding digest written into snapshots, and the
+     * slice counter driving the checkpoint interval */
+    bool seeds_deferred; //lane seed blocks fill lazily at slice-0 dispatch
+    uint8_t seed_hash[ARGON2_PREHASH_SEED_LENGTH]; //H0 seed, wiped at teardown
+    uint32_t resume_pass;
+    uint32_t resume_slice;
+    uint8_t checkpoint_digest[32];
+    uint32_t checkpoint_slices;
+    Argon2_Stats *stats; //optional per-pass/per-slice cycle sink (see Argon2_Context)
+
+    /* Slice-interleaved physical layout (ARGON2_INTERLEAVED_LAYOUT=1, only
+     * for power-of-two geometry on one contiguous allocation): the same-
+     * slice segments of all lanes sit adjacently, so the cross-lane
+     * references that dominate wide hashes after slice 0 land in nearby
+     * DRAM pages instead of tens of megabytes away. Logical offsets are
+     * unchanged - BlockAt() does the remap - so tags are identical. */
+    bool slice_interleaved;
+    uint32_t lane_shift; //log2(lane_length)
+    uint32_t segment_shift; //log2(segment_length)
+
+    Argon2_instance_t(block* ptr, Argon2_type t, uint32_t p, uint32_t m, uint32_t l, uint32_t thr, bool pr,
+            const uint32_t *aff = NULL, uint32_t aff_len = 0,
+            const std::atomic<bool> *cancel_token = NULL,
+            Argon2_priority prio = ARGON2_PRIORITY_INTERACTIVE,
+            ProgressCallback prog_cbk = NULL, void *prog_data = NULL) :
     memory(ptr),  passes(p), memory_blocks(m), lanes(l),threads(thr), type(t),   lane_length(m / l),
     segment_length(m / (l*ARGON2_SYNC_POINTS)),
-     Sbox(NULL), internal_print(pr) {
+    lane_length_mask((m / l != 0 && ((m / l) & (m / l - 1)) == 0) ? m / l - 1 : 0),
+     Sbox(NULL), lane_chunks(NULL), affinity(aff), affinity_length(aff_len), cancel(cancel_token), priority(prio),
+     progress_cbk(prog_cbk), progress_data(prog_data), internal_print(pr),
+     seeds_deferred(false), resume_pass(0), resume_slice(0), checkpoint_slices(0), stats(NULL),
+     slice_interleaved(false), lane_shift(0), segment_shift(0) {
+        memset(checkpoint_digest, 0, sizeof (checkpoint_digest));
+    };
+
+    /*
+     * Reduction modulo the lane length: the per-block path pays a 64-bit
+     * division here on every iteration, but the usual power-of-two m_cost
+     * makes it a mask - several cycles per block across billions of blocks.
+     */
+    uint32_t ModLaneLength(uint64_t offset) const {
+        return (lane_length_mask != 0)
+                ? (uint32_t) (offset & lane_length_mask)
+                : (uint32_t) (offset % lane_length);
+    };
+
+    /*
+     * Resolves a global block offset. All block addressing goes through here:
+     * contiguous memory is a pointer add, the chunked fallback adds one
+     * predictable per-lane indirection.
+     */
+    block* BlockAt(uint32_t offset) const {
+        if (lane_chunks != NULL) {
+            return lane_chunks[offset / lane_length] + offset % lane_length;
+        }
+        if (slice_interleaved) {
+            // logical (lane, slice, index) -> physical (slice, lane, index)
+            uint32_t lane = offset >> lane_shift;
+            uint32_t rem = offset & (lane_length - 1);
+            uint32_t slice = rem >> segment_shift;
+            uint32_t index = rem & (segment_length - 1);
+            return memory + (((slice * lanes + lane) << segment_shift) + index);
+        }
+        return memory + offset;
+    };
+
+    /*
+     * Fires the progress hook for the just-completed slice, if one is set.
+     */
+    void ReportProgress(uint32_t pass, uint32_t slice) const {
+        if (progress_cbk != NULL) {
+            uint64_t blocks_filled = ((uint64_t) pass * ARGON2_SYNC_POINTS + slice + 1) * segment_length * lanes;
+            progress_cbk(pass, slice, blocks_filled, progress_data);
+        }
+    };
+
+    /*
+     * Polled at slice boundaries and periodically inside FillSegment.
+     */
+    bool Cancelled() const {
+        return cancel != NULL && cancel->load();
     };
 };
 
@@ -132,6 +356,23 @@ struct Argon2_position_t {
     };
 };
 
+/*
+ * Cycle timestamp for the opt-in stats: TSC on x86 (the same basis the bench
+ * harness reports), steady-clock nanoseconds elsewhere.
+ */
+inline uint64_t Argon2Cycles() {
+#if defined(__amd64__) || defined(__x86_64__)
+    uint64_t rax, rdx;
+    __asm__ __volatile__("rdtsc" : "=a"(rax), "=d"(rdx) : :);
+    return (rdx << 32) | rax;
+#elif defined(_MSC_VER)
+    return __rdtsc();
+#else
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
 /*Macro for endianness conversion*/
 
 #if defined(_MSC_VER) 
@@ -149,20 +390,21 @@ struct Argon2_position_t {
  */
 int AllocateMemory(block **memory, uint32_t m_cost);
 
-/* Deallocates memory
- * @param instance pointer to the current instance
- * @param clear_memory indicates if we clear the memory with zeros.
+/* Deallocates the block array
+ * @param memory pointer to the blocks allocated by AllocateMemory
  */
-void FreeMemory(Argon2_instance_t* instance, bool clear_memory);
+void FreeMemory(block* memory);
 
 /*
- * Generate pseudo-random values to reference blocks in the segment and puts them into the array
- * @param instance Pointer to the current instance
- * @param position Pointer to the current position
- * @param pseudo_rands Pointer to the array of 64-bit values
- * @pre pseudo_rands must point to @a instance->segment_length allocated values
+ * Returns this thread's scratch array for the pseudo-random segment indices,
+ * growing it to at least @length values. The buffer lives as long as the
+ * (pooled, persistent) worker thread, so FillSegment stops paying a heap
+ * round-trip per segment.
+ * @param length Number of 64-bit values needed
+ * @return Pointer to the scratch; a failed grow throws bad_alloc like the
+ *         per-segment new[] it replaces
  */
-void GenerateAddresses(const Argon2_instance_t* instance, const Argon2_position_t* position, uint64_t* pseudo_rands);
+uint64_t* GetSegmentScratch(uint32_t length);
 
 /*
  * Computes absolute position of reference block in the lane following a skewed distribution and using a pseudo-random value as input
@@ -172,7 +414,54 @@ void GenerateAddresses(const Argon2_instance_t* instance, const Argon2_position_
  * @param same_lane Indicates if the block will be taken from the current lane. If so we can reference the current segment
  * @pre All pointers must be valid
  */
-uint32_t IndexAlpha(const Argon2_instance_t* instance, const Argon2_position_t* position, uint32_t pseudo_rand, bool same_lane);
+inline uint32_t IndexAlpha(const Argon2_instance_t* instance, const Argon2_position_t* position, uint32_t pseudo_rand, bool same_lane) {
+    /*
+     * Pass 0:
+     *      This lane : all already finished segments plus already constructed blocks in this segment
+     *      Other lanes : all already finished segments
+     * Pass 1+:
+     *      This lane : (SYNC_POINTS - 1) last segments plus already constructed blocks in this segment
+     *      Other lanes : (SYNC_POINTS - 1) last segments 
+     */
+    uint32_t reference_area_size;
+
+    if (0 == position->pass) {
+        // First pass
+        if (0 == position->slice) {
+            // First slice
+            reference_area_size = position->index - 1; // all but the previous
+        } else {
+            if (same_lane) {
+                // The same lane => add current segment
+                reference_area_size = position->slice * instance->segment_length + position->index - 1;
+            } else {
+                reference_area_size = position->slice * instance->segment_length + ((position->index == 0) ? (-1) : 0);
+            }
+        }
+    } else {
+        // Second pass
+        if (same_lane) {
+            reference_area_size = instance->lane_length - instance->segment_length + position->index - 1;
+        } else {
+            reference_area_size = instance->lane_length - instance->segment_length + ((position->index == 0) ? (-1) : 0);
+        }
+    }
+
+    /* 1.2.4. Mapping pseudo_rand to 0..<reference_area_size-1> and produce relative position */
+    uint64_t relative_position = pseudo_rand;
+    relative_position = relative_position * relative_position >> 32;
+    relative_position = reference_area_size - 1 - (reference_area_size * relative_position >> 32);
+
+    /* 1.2.5 Computing starting position */
+    uint32_t start_position = 0;
+    if (0 != position->pass) {
+        start_position = (position->slice == ARGON2_SYNC_POINTS - 1) ? 0 : (position->slice + 1) * instance->segment_length;
+    }
+
+    /* 1.2.6. Computing absolute position */
+    uint32_t absolute_position = instance->ModLaneLength(start_position + relative_position); // absolute position
+    return absolute_position;
+}
 
 /*
  * Function that validates all inputs against predefined restrictions and return an error code
@@ -188,7 +477,17 @@ int ValidateInputs(const Argon2_Context* context);
  * @param  type Argon2 type
  * @pre    @a blockhash must have at least @a PREHASH_DIGEST_LENGTH bytes allocated
  */
-void InitialHash(uint8_t* blockhash, const Argon2_Context* context, Argon2_type type);
+void InitialHash(uint8_t* blockhash, Argon2_Context* context, Argon2_type type);
+
+/*
+ * Prefaults the block array in parallel, one task per lane, so pass 0 computes
+ * instead of taking its soft page faults serially. When the context carries an
+ * affinity map the worker also pins to the lane's CPU first, which places the
+ * pages on that lane's NUMA node under a first-touch policy. No-op for
+ * threads == 1, where there are no extra workers to fault with.
+ * @param instance Pointer to the current instance
+ */
+void PlaceMemoryByLane(const Argon2_instance_t* instance);
 
 /*
  * Function creates first 2 blocks per lane
@@ -198,6 +497,15 @@ void InitialHash(uint8_t* blockhash, const Argon2_Context* context, Argon2_type
  */
 void FillFirstBlocks(uint8_t* blockhash, const Argon2_instance_t* instance);
 
+/*
+ * Deferred variant of FillFirstBlocks() for one lane, called by the segment
+ * dispatch when @instance->seeds_deferred is set: expands the two seed blocks
+ * of @lane from @instance->seed_hash just before that lane's pass-0 slice-0
+ * segment runs. Lets a lane start filling as soon as its own seeds exist
+ * instead of waiting for all 2*lanes blake2b_long() expansions up front.
+ */
+void FillLaneSeedBlocks(const Argon2_instance_t* instance, uint32_t lane);
+
 
 /*
  * Function allocates memory, hashes the inputs with Blake,  and creates first two blocks. Returns the pointer to the main memory with 2 blocks per lane
@@ -216,19 +524,9 @@ int Initialize(Argon2_instance_t* instance, Argon2_Context* context);
  * @pre context->out must point to outlen bytes of memory
  * @pre if context->free_cbk is not NULL, it should point to a function that deallocates memory
  */
-void Finalize(const Argon2_Context *context, Argon2_instance_t* instance);
+int Finalize(const Argon2_Context *context, Argon2_instance_t* instance);
 
 
-/*
- * Function fills a new memory block
- * @param prev_block Pointer to the previous block
- * @param ref_block Pointer to the reference block
- * @param next_block Pointer to the block to be constructed
- * @param Sbox Pointer to the Sbox (used in Argon2_ds only)
- * @pre all block pointers must be valid
- */
-void FillBlock(const block* prev_block, const block* ref_block, block* next_block, const uint64_t* Sbox);
-
 /*
  * Function that fills the segment using previous segments also from other threads
  * @param instance Pointer to the current instance
@@ -237,11 +535,50 @@ void FillBlock(const block* prev_block, const block* ref_block, block* next_bloc
  */
 void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position);
 
+/*
+ * Returns the cached resolved reference offsets for this segment, or NULL if
+ * the address cache is not primed for the instance's parameters. Only pure
+ * Argon2i streams are cached (Argon2id flips addressing mid-pass).
+ * @param instance Pointer to the current instance
+ * @param position Segment being filled
+ * @return segment_length offsets (entries before starting_index unused) or NULL
+ */
+const uint32_t* Argon2CachedOffsets(const Argon2_instance_t* instance, const Argon2_position_t* position);
+
+/*
+ * Resolves one whole segment's reference offsets into @out_offsets; the
+ * per-kernel generation behind the address cache priming.
+ * @param instance Parameter-only instance (no memory needed)
+ * @param position Segment to resolve
+ * @param out_offsets Room for segment_length values
+ */
+void PrimeSegmentAddresses(const Argon2_instance_t* instance, Argon2_position_t position, uint32_t* out_offsets);
+
+/*
+ * Computes one block: next = G(prev, ref). Single-block granularity for the
+ * low-memory (time-memory trade-off) evaluator and the kernel
+ * microbenchmark. @Sbox selects the Argon2ds compression when non-NULL.
+ */
+void FillOneBlock(const block* prev_block, const block* ref_block, block* next_block,
+        const uint64_t* Sbox = NULL);
+
+/*
+ * Fills two same-slice segments (always independent of each other), letting
+ * kernels interleave the two BlaMka chains for instruction-level parallelism.
+ * Falls back to two sequential FillSegment calls where interleaving does not
+ * apply.
+ * @param instance Pointer to the current instance
+ * @param position_a First segment (pass/slice equal to @position_b)
+ * @param position_b Second segment
+ */
+void FillSegmentPair(const Argon2_instance_t* instance, Argon2_position_t position_a, Argon2_position_t position_b);
+
 /*
  * Function that fills the entire memory t_cost times based on the first two blocks in each lane
  * @param instance Pointer to the current instance
+ * @return ARGON2_OK, or ARGON2_CANCELLED if the context's cancellation token was set
  */
-void FillMemoryBlocks(const Argon2_instance_t* instance);
+int FillMemoryBlocks(Argon2_instance_t* instance);
 
 
 /*
@@ -251,6 +588,21 @@ void FillMemoryBlocks(const Argon2_instance_t* instance);
  */
 int Argon2Core(Argon2_Context* context, Argon2_type type);
 
+/*
+ * Runs the memory-hard phase like Argon2Core() but stops at the Finalize()
+ * boundary: writes the ARGON2_BLOCK_SIZE-byte pre-tag state (the XOR of the
+ * last lane blocks) to @pre_tag instead of hashing it into context->out.
+ * Argon2FinishTag() completes the tag from that state.
+ */
+int Argon2CoreToPreTag(Argon2_Context* context, Argon2_type type, uint8_t* pre_tag);
+
+/*
+ * Computes the tag with ~m_cost/memory_divisor blocks of RAM by recomputing
+ * dropped blocks from the data-independent reference stream (argon2-tmto.cpp).
+ * Argon2_i only; the wall-clock multiplier is steep (see argon2.h).
+ */
+int Argon2LowMemCore(Argon2_Context* context, Argon2_type type, uint32_t memory_divisor);
+
 /*
  * Generates the Sbox from the first memory block (must be ready at that time)
  * @param instance Pointer to the current instance 
@@ -0,0 +1,290 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "argon2.h"
+#include "argon2-core.h"
+
+/*
+ * Runtime kernel dispatch: every compiled-in FillSegment/GenerateSbox variant
+ * lives in its own namespace (see the ARGON2_KERNEL_NS wrapping of the core
+ * translation units), and the best one the CPU supports is bound on first use.
+ * One binary therefore runs optimally fleet-wide instead of one artifact per
+ * microarchitecture. The ARGON2_KERNEL environment variable ("ref", "sse",
+ * "avx2", "avx512", "opt") forces a specific kernel, which the test-vector
+ * script uses to cover the reference path.
+ */
+
+namespace argon2_ref {
+void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position);
+void PrimeSegmentAddresses(const Argon2_instance_t* instance, Argon2_position_t position, uint32_t* out_offsets);
+void FillSegmentPair(const Argon2_instance_t* instance, Argon2_position_t position_a, Argon2_position_t position_b);
+void FillOneBlock(const block* prev_block, const block* ref_block, block* next_block, const uint64_t* Sbox);
+void GenerateSbox(Argon2_instance_t* instance);
+}
+#ifdef ARGON2_HAVE_SSE_KERNEL
+namespace argon2_sse {
+void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position);
+void PrimeSegmentAddresses(const Argon2_instance_t* instance, Argon2_position_t position, uint32_t* out_offsets);
+void FillSegmentPair(const Argon2_instance_t* instance, Argon2_position_t position_a, Argon2_position_t position_b);
+void FillOneBlock(const block* prev_block, const block* ref_block, block* next_block, const uint64_t* Sbox);
+void GenerateSbox(Argon2_instance_t* instance);
+}
+#endif
+#ifdef ARGON2_HAVE_AVX2_KERNEL
+namespace argon2_avx2 {
+void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position);
+void PrimeSegmentAddresses(const Argon2_instance_t* instance, Argon2_position_t position, uint32_t* out_offsets);
+void FillSegmentPair(const Argon2_instance_t* instance, Argon2_position_t position_a, Argon2_position_t position_b);
+void FillOneBlock(const block* prev_block, const block* ref_block, block* next_block, const uint64_t* Sbox);
+void GenerateSbox(Argon2_instance_t* instance);
+}
+#endif
+#ifdef ARGON2_HAVE_AVX512_KERNEL
+namespace argon2_avx512 {
+void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position);
+void PrimeSegmentAddresses(const Argon2_instance_t* instance, Argon2_position_t position, uint32_t* out_offsets);
+void FillSegmentPair(const Argon2_instance_t* instance, Argon2_position_t position_a, Argon2_position_t position_b);
+void FillOneBlock(const block* prev_block, const block* ref_block, block* next_block, const uint64_t* Sbox);
+void GenerateSbox(Argon2_instance_t* instance);
+}
+#endif
+#ifdef ARGON2_HAVE_OPT_KERNEL
+namespace argon2_opt {
+void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position);
+void PrimeSegmentAddresses(const Argon2_instance_t* instance, Argon2_position_t position, uint32_t* out_offsets);
+void FillSegmentPair(const Argon2_instance_t* instance, Argon2_position_t position_a, Argon2_position_t position_b);
+void FillOneBlock(const block* prev_block, const block* ref_block, block* next_block, const uint64_t* Sbox);
+void GenerateSbox(Argon2_instance_t* instance);
+}
+#endif
+
+/* KAT output name follows the selected kernel (ref vs optimized vectors) */
+const char* ARGON2_KAT_FILENAME = "kat-argon2-ref.log";
+
+struct Argon2Kernel {
+    const char* name; //matches the ARGON2_KERNEL override values
+    const char* kat_filename;
+    void (*fill_segment)(const Argon2_instance_t*, Argon2_position_t);
+    void (*fill_segment_pair)(const Argon2_instance_t*, Argon2_position_t, Argon2_position_t);
+    void (*prime_segment_addresses)(const Argon2_instance_t*, Argon2_position_t, uint32_t*);
+    void (*fill_one_block)(const block*, const block*, block*, const uint64_t*);
+    void (*generate_sbox)(Argon2_instance_t*);
+};
+
+static const Argon2Kernel kernel_ref = {
+    "ref", "kat-argon2-ref.log", &argon2_ref::FillSegment, &argon2_ref::FillSegmentPair, &argon2_ref::PrimeSegmentAddresses, &argon2_ref::FillOneBlock, &argon2_ref::GenerateSbox
+};
+#ifdef ARGON2_HAVE_SSE_KERNEL
+static const Argon2Kernel kernel_sse = {
+    "sse", "kat-argon2-opt.log", &argon2_sse::FillSegment, &argon2_sse::FillSegmentPair, &argon2_sse::PrimeSegmentAddresses, &argon2_sse::FillOneBlock, &argon2_sse::GenerateSbox
+};
+#endif
+#ifdef ARGON2_HAVE_AVX2_KERNEL
+static const Argon2Kernel kernel_avx2 = {
+    "avx2", "kat-argon2-opt.log", &argon2_avx2::FillSegment, &argon2_avx2::FillSegmentPair, &argon2_avx2::PrimeSegmentAddresses, &argon2_avx2::FillOneBlock, &argon2_avx2::GenerateSbox
+};
+#endif
+#ifdef ARGON2_HAVE_AVX512_KERNEL
+static const Argon2Kernel kernel_avx512 = {
+    "avx512", "kat-argon2-opt.log", &argon2_avx512::FillSegment, &argon2_avx512::FillSegmentPair, &argon2_avx512::PrimeSegmentAddresses, &argon2_avx512::FillOneBlock, &argon2_avx512::GenerateSbox
+};
+#endif
+#ifdef ARGON2_HAVE_OPT_KERNEL
+static const Argon2Kernel kernel_opt = {
+    "opt", "kat-argon2-opt.log", &argon2_opt::FillSegment, &argon2_opt::FillSegmentPair, &argon2_opt::PrimeSegmentAddresses, &argon2_opt::FillOneBlock, &argon2_opt::GenerateSbox
+};
+#endif
+
+static const Argon2Kernel* SelectKernel() {
+    // Best-supported first; the override can only pick a compiled-in kernel
+    const Argon2Kernel* candidates[5];
+    uint32_t count = 0;
+#ifdef ARGON2_HAVE_AVX512_KERNEL
+    if (__builtin_cpu_supports("avx512f")) {
+        candidates[count++] = &kernel_avx512;
+    }
+#endif
+#ifdef ARGON2_HAVE_AVX2_KERNEL
+    if (__builtin_cpu_supports("avx2")) {
+        candidates[count++] = &kernel_avx2;
+    }
+#endif
+#ifdef ARGON2_HAVE_SSE_KERNEL
+    candidates[count++] = &kernel_sse; //SSE2 is the x86-64 baseline
+#endif
+#ifdef ARGON2_HAVE_OPT_KERNEL
+    candidates[count++] = &kernel_opt;
+#endif
+    candidates[count++] = &kernel_ref;
+
+    const Argon2Kernel* chosen = candidates[0];
+    const char* forced = getenv("ARGON2_KERNEL");
+    if (forced != NULL) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (0 == strcmp(candidates[i]->name, forced)) {
+                chosen = candidates[i];
+                break;
+            }
+        }
+    }
+    ARGON2_KAT_FILENAME = chosen->kat_filename;
+    return chosen;
+}
+
+static const Argon2Kernel* ActiveKernel() {
+    static const Argon2Kernel* kernel = SelectKernel(); //bound once, thread-safe
+    return kernel;
+}
+
+/* Bind at load: the KAT filename must be right before the first hash starts */
+static const Argon2Kernel* const kernel_bound_at_load = ActiveKernel();
+
+const char* Argon2KernelName() {
+    return ActiveKernel()->name;
+}
+
+/*
+ * Per-thread ring-buffer tracing: every segment logs a fixed-size start/end
+ * event (tick stamp, pass, lane, slice) into its worker's private ring -
+ * no locks, no allocation on the hot path, overhead in the noise. When a
+ * hash sporadically runs 3x long, the dump shows which lane's segments
+ * stalled and for how long, which is the difference between blaming
+ * "the allocator" and finding the reclaim storm. Rings keep the newest
+ * ARGON2_TRACE_RING_EVENTS events; older ones are overwritten.
+ */
+static const uint32_t ARGON2_TRACE_RING_EVENTS = 4096;
+
+struct Argon2TraceEvent {
+    uint64_t ticks;
+    uint32_t pass;
+    uint16_t lane;
+    uint8_t slice;
+    uint8_t kind; //0 = segment start, 1 = segment end
+};
+
+struct Argon2TraceRing {
+    Argon2TraceEvent events[ARGON2_TRACE_RING_EVENTS];
+    uint64_t next; //monotone; slot = next % ring size
+    uint32_t thread_ordinal;
+};
+
+static std::mutex trace_mutex;
+static std::vector<Argon2TraceRing*> trace_rings; //one per thread that ever traced
+static std::atomic<bool> trace_enabled(false);
+
+void Argon2TraceEnable(bool on) {
+    std::unique_lock<std::mutex> lock(trace_mutex);
+    trace_enabled.store(on, std::memory_order_relaxed);
+    if (!on) {
+        return;
+    }
+    for (size_t i = 0; i < trace_rings.size(); ++i) {
+        trace_rings[i]->next = 0; //restart the window on enable
+    }
+}
+
+static Argon2TraceRing* ThreadTraceRing() {
+    static thread_local Argon2TraceRing* ring = NULL;
+    if (ring == NULL) {
+        ring = new Argon2TraceRing();
+        ring->next = 0;
+        std::unique_lock<std::mutex> lock(trace_mutex);
+        ring->thread_ordinal = (uint32_t) trace_rings.size();
+        trace_rings.push_back(ring);
+    }
+    return ring;
+}
+
+static inline void TraceSegment(const Argon2_position_t& position, uint8_t kind) {
+    if (!trace_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    Argon2TraceRing* ring = ThreadTraceRing();
+    Argon2TraceEvent& event = ring->events[ring->next % ARGON2_TRACE_RING_EVENTS];
+    event.ticks = Argon2Cycles();
+    event.pass = position.pass;
+    event.lane = (uint16_t) position.lane;
+    event.slice = position.slice;
+    event.kind = kind;
+    ++ring->next;
+}
+
+int Argon2TraceDump(const char* path) {
+    FILE* fp = (path != NULL) ? fopen(path, "w") : stdout;
+    if (fp == NULL) {
+        return -1;
+    }
+    int written = 0;
+    {
+        std::unique_lock<std::mutex> lock(trace_mutex);
+        for (size_t i = 0; i < trace_rings.size(); ++i) {
+            const Argon2TraceRing* ring = trace_rings[i];
+            uint64_t count = (ring->next < ARGON2_TRACE_RING_EVENTS)
+                    ? ring->next : ARGON2_TRACE_RING_EVENTS;
+            uint64_t first = ring->next - count;
+            for (uint64_t e = first; e < ring->next; ++e) {
+                const Argon2TraceEvent& event = ring->events[e % ARGON2_TRACE_RING_EVENTS];
+                fprintf(fp, "thread=%u seq=%llu ticks=%llu pass=%u lane=%u slice=%u %s\n",
+                        ring->thread_ordinal, (unsigned long long) e,
+                        (unsigned long long) event.ticks, event.pass, event.lane,
+                        event.slice, event.kind == 0 ? "start" : "end");
+                ++written;
+            }
+        }
+    }
+    if (path != NULL) {
+        fclose(fp);
+    }
+    return written;
+}
+
+void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position) {
+    if (instance->seeds_deferred && position.pass == 0 && position.slice == 0) {
+        FillLaneSeedBlocks(instance, position.lane);
+    }
+    TraceSegment(position, 0);
+    ActiveKernel()->fill_segment(instance, position);
+    TraceSegment(position, 1);
+}
+
+void FillSegmentPair(const Argon2_instance_t* instance, Argon2_position_t position_a, Argon2_position_t position_b) {
+    if (instance->seeds_deferred && position_a.pass == 0 && position_a.slice == 0) {
+        FillLaneSeedBlocks(instance, position_a.lane);
+        FillLaneSeedBlocks(instance, position_b.lane);
+    }
+    // Both segments get matched start/end pairs; the fused fill cannot time
+    // them individually, so each spans the pair
+    TraceSegment(position_a, 0);
+    TraceSegment(position_b, 0);
+    ActiveKernel()->fill_segment_pair(instance, position_a, position_b);
+    TraceSegment(position_a, 1);
+    TraceSegment(position_b, 1);
+}
+
+void PrimeSegmentAddresses(const Argon2_instance_t* instance, Argon2_position_t position, uint32_t* out_offsets) {
+    ActiveKernel()->prime_segment_addresses(instance, position, out_offsets);
+}
+
+void FillOneBlock(const block* prev_block, const block* ref_block, block* next_block,
+        const uint64_t* Sbox) {
+    ActiveKernel()->fill_one_block(prev_block, ref_block, next_block, Sbox);
+}
+
+void GenerateSbox(Argon2_instance_t* instance) {
+    ActiveKernel()->generate_sbox(instance);
+}
@@ -22,15 +22,115 @@
 #include "../Blake2/blake2.h"
 
 
-const char* ARGON2_KAT_FILENAME = "kat-argon2-ref.log";
+/*
+ * Flat, restrict-qualified round sweeps: the macro expansion over 16 named
+ * lvalues defeats gcc's SLP vectorizer, while independent G quads over a
+ * __restrict base autovectorize at -O3 - this path is all RISC-V and POWER
+ * builds ever run.
+ */
+static BLAKE2_INLINE void BlamkaG(uint64_t& a, uint64_t& b, uint64_t& c, uint64_t& d) {
+    a = fBlaMka(a, b);
+    d = rotr64(d ^ a, 32);
+    c = fBlaMka(c, d);
+    b = rotr64(b ^ c, 24);
+    a = fBlaMka(a, b);
+    d = rotr64(d ^ a, 16);
+    c = fBlaMka(c, d);
+    b = rotr64(b ^ c, 63);
+}
+
+/*
+ * Two independent Gs with their statements interleaved by hand: each G is a
+ * strict dependency chain (multiply -> rotate -> multiply ...), and an
+ * in-order pipeline - the RISC-V edge parts whose production path this is -
+ * stalls on it. Alternating two chains gives the pipeline an independent
+ * instruction at every stall point; out-of-order hosts extract the same
+ * parallelism either way, so this costs them nothing.
+ */
+static BLAKE2_INLINE void BlamkaG2(uint64_t& a0, uint64_t& b0, uint64_t& c0, uint64_t& d0,
+        uint64_t& a1, uint64_t& b1, uint64_t& c1, uint64_t& d1) {
+    a0 = fBlaMka(a0, b0);
+    a1 = fBlaMka(a1, b1);
+    d0 = rotr64(d0 ^ a0, 32);
+    d1 = rotr64(d1 ^ a1, 32);
+    c0 = fBlaMka(c0, d0);
+    c1 = fBlaMka(c1, d1);
+    b0 = rotr64(b0 ^ c0, 24);
+    b1 = rotr64(b1 ^ c1, 24);
+    a0 = fBlaMka(a0, b0);
+    a1 = fBlaMka(a1, b1);
+    d0 = rotr64(d0 ^ a0, 16);
+    d1 = rotr64(d1 ^ a1, 16);
+    c0 = fBlaMka(c0, d0);
+    c1 = fBlaMka(c1, d1);
+    b0 = rotr64(b0 ^ c0, 63);
+    b1 = rotr64(b1 ^ c1, 63);
+}
+
+/* One round over 16 consecutive words (the column sweep layout) */
+static void BlamkaRoundFlat(uint64_t* __restrict w) {
+#if !defined(__SSE2__) && !defined(__aarch64__) && !defined(__ARM_NEON) && !defined(__ALTIVEC__)
+    // Scalar-only 64-bit targets (RISC-V edge parts, older POWER): the
+    // interleaved pairs feed the in-order pipeline an independent
+    // instruction at every multiply/rotate stall point
+    BlamkaG2(w[0], w[4], w[8], w[12], w[1], w[5], w[9], w[13]);
+    BlamkaG2(w[2], w[6], w[10], w[14], w[3], w[7], w[11], w[15]);
+    BlamkaG2(w[0], w[5], w[10], w[15], w[1], w[6], w[11], w[12]);
+    BlamkaG2(w[2], w[7], w[8], w[13], w[3], w[4], w[9], w[14]);
+#else
+    // SIMD-capable hosts: the plain quad loop is what the SLP vectorizer
+    // recognizes - hand-interleaving here measured ~5% slower on x86 because
+    // it broke exactly that pattern
+    for (unsigned j = 0; j < 4; ++j) { //independent column quads
+        BlamkaG(w[j], w[4 + j], w[8 + j], w[12 + j]);
+    }
+    BlamkaG(w[0], w[5], w[10], w[15]);
+    BlamkaG(w[1], w[6], w[11], w[12]);
+    BlamkaG(w[2], w[7], w[8], w[13]);
+    BlamkaG(w[3], w[4], w[9], w[14]);
+#endif
+}
+
+/* One round over the strided row layout: word k lives at base[16*(k/2)+(k&1)] */
+static void BlamkaRoundStrided(uint64_t* __restrict base) {
+    uint64_t m[16];
+    for (unsigned k = 0; k < 8; ++k) { //gather into a dense, alias-free matrix
+        m[2 * k] = base[16 * k];
+        m[2 * k + 1] = base[16 * k + 1];
+    }
+    BlamkaRoundFlat(m);
+    for (unsigned k = 0; k < 8; ++k) {
+        base[16 * k] = m[2 * k];
+        base[16 * k + 1] = m[2 * k + 1];
+    }
+}
 
 
-void FillBlock(const block* prev_block, const block* ref_block, block* next_block, const uint64_t* Sbox) {
-    block blockR = *prev_block ^ *ref_block;
+/*
+ * When built as one of several dispatchable kernels, every definition in this
+ * translation unit lives in its own namespace; the runtime dispatcher in
+ * argon2-dispatch.cpp binds the selected one. Standalone builds keep the
+ * global names.
+ */
+#ifdef ARGON2_KERNEL_NS
+namespace ARGON2_KERNEL_NS {
+#endif
+
+
+
+/*
+ * Specialized on the Argon2 type at compile time: the non-ds instantiation
+ * carries no Sbox branch, no dead lookup loop in its I-cache footprint and no
+ * x accumulator plumbing.
+ */
+template <bool kSbox>
+static void FillBlock(const block* prev_block, const block* ref_block, block* next_block, const uint64_t* Sbox) {
+    block blockR;
+    block::XorInto(*prev_block, *ref_block, blockR); //fused: no 1 KB temporary
     block block_tmp = blockR;
 
     uint64_t x = 0;
-    if (Sbox != NULL) {
+    if (kSbox) {
         x = blockR[0] ^ blockR[ARGON2_WORDS_IN_BLOCK - 1];
         for (int i = 0; i < 6 * 16; ++i) {
             uint32_t x1 = x >> 32;
@@ -46,22 +146,18 @@ void FillBlock(const block* prev_block, const block* ref_block, block* next_bloc
 
     // Apply Blake2 on columns of 64-bit words: (0,1,...,15) , then (16,17,..31)... finally (112,113,...127)
     for (unsigned i = 0; i < 8; ++i) {
-        BLAKE2_ROUND_NOMSG(blockR[16 * i], blockR[16 * i + 1], blockR[16 * i + 2], blockR[16 * i + 3],
-                blockR[16 * i + 4], blockR[16 * i + 5], blockR[16 * i + 6], blockR[16 * i + 7],
-                blockR[16 * i + 8], blockR[16 * i + 9], blockR[16 * i + 10], blockR[16 * i + 11],
-                blockR[16 * i + 12], blockR[16 * i + 13], blockR[16 * i + 14], blockR[16 * i + 15]);
+        BlamkaRoundFlat(&blockR.v[16 * i]);
     }
     // Apply Blake2 on rows of 64-bit words: (0,1,16,17,...112,113), then (2,3,18,19,...,114,115).. finally (14,15,30,31,...,126,127)
     for (unsigned i = 0; i < 8; i++) {
-        BLAKE2_ROUND_NOMSG(blockR[2 * i], blockR[2 * i + 1], blockR[2 * i + 16], blockR[2 * i + 17],
-                blockR[2 * i + 32], blockR[2 * i + 33], blockR[2 * i + 48], blockR[2 * i + 49],
-                blockR[2 * i + 64], blockR[2 * i + 65], blockR[2 * i + 80], blockR[2 * i + 81],
-                blockR[2 * i + 96], blockR[2 * i + 97], blockR[2 * i + 112], blockR[2 * i + 113]);
+        BlamkaRoundStrided(&blockR.v[2 * i]);
     }
 
-    *next_block = blockR ^ block_tmp;
-    next_block->v[0] += x;
-    next_block->v[ARGON2_WORDS_IN_BLOCK - 1] += x;
+    block::XorInto(blockR, block_tmp, *next_block); //fused: no 1 KB temporary
+    if (kSbox) {
+        next_block->v[0] += x;
+        next_block->v[ARGON2_WORDS_IN_BLOCK - 1] += x;
+    }
 }
 
 void GenerateAddresses(const Argon2_instance_t* instance, const Argon2_position_t* position, uint64_t* pseudo_rands) {
@@ -77,29 +173,32 @@ void GenerateAddresses(const Argon2_instance_t* instance, const Argon2_position_
         for (uint32_t i = 0; i < instance->segment_length; ++i) {
             if (i % ARGON2_ADDRESSES_IN_BLOCK == 0) {
                 input_block.v[6]++;
-                FillBlock(&zero_block, &input_block, &address_block, NULL);
-                FillBlock(&zero_block, &address_block, &address_block, NULL);
+                FillBlock<false>(&zero_block, &input_block, &address_block, NULL);
+                FillBlock<false>(&zero_block, &address_block, &address_block, NULL);
             }
             pseudo_rands[i] = address_block[i % ARGON2_ADDRESSES_IN_BLOCK];
         }
     }
 }
 
-void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position) {
-    if (instance == NULL) {
-        return;
-    }
+template <bool kSbox, bool kIndependent>
+static void FillSegmentImpl(const Argon2_instance_t* instance, Argon2_position_t position) {
     uint64_t pseudo_rand, ref_index, ref_lane;
     uint32_t prev_offset, curr_offset;
-    bool data_independent_addressing = (instance->type == Argon2_i) || (instance->type == Argon2_id && (position.pass == 0) && (position.slice < ARGON2_SYNC_POINTS / 2));
-    // Pseudo-random values that determine the reference block position
-    uint64_t *pseudo_rands = new uint64_t[instance->segment_length];
-    if (pseudo_rands == NULL){
-        return;
-    }
-         
-    if (data_independent_addressing) {
-        GenerateAddresses(instance, &position, pseudo_rands);
+    // Pseudo-random values that determine the reference block position; only
+    // the data-independent instantiation touches the scratch at all, and a
+    // primed address cache replaces generation entirely
+    const uint32_t *cached = NULL;
+    uint64_t *pseudo_rands = NULL;
+    if (kIndependent) {
+        cached = Argon2CachedOffsets(instance, &position);
+        if (cached == NULL) {
+            pseudo_rands = GetSegmentScratch(instance->segment_length);
+            if (pseudo_rands == NULL){
+                return;
+            }
+            GenerateAddresses(instance, &position, pseudo_rands);
+        }
     }
 
     uint32_t starting_index = 0;
@@ -109,7 +208,7 @@ void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position)
 
     // Offset of the current block
     curr_offset = position.lane * instance->lane_length + position.slice * instance->segment_length + starting_index;
-    if (0 == curr_offset % instance->lane_length) {
+    if (0 == instance->ModLaneLength(curr_offset)) {
         // Last block in this lane
         prev_offset = curr_offset + instance->lane_length - 1;
     } else {
@@ -118,18 +217,23 @@ void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position)
     }
 
     for (uint32_t i = starting_index; i < instance->segment_length; ++i, ++curr_offset, ++prev_offset) {
+        /* 1.0 Polling the cancellation token every 1024 blocks (~1 MB of work) */
+        if ((i & 0x3FF) == 0x3FF && instance->Cancelled()) {
+            break;
+        }
+
         /*1.1 Rotating prev_offset if needed */
-        if (curr_offset % instance->lane_length == 1) {
+        if (instance->ModLaneLength(curr_offset) == 1) {
             prev_offset = curr_offset - 1;
         }
 
         /* 1.2 Computing the index of the reference block */
         /* 1.2.1 Taking pseudo-random value from the previous block */
-        if (data_independent_addressing) {
+        if (kIndependent) {
             pseudo_rand = pseudo_rands[i];
         } 
         else {
-            pseudo_rand = instance->memory[prev_offset][0];
+            pseudo_rand = (*instance->BlockAt(prev_offset))[0];
         }
 
         /* 1.2.2 Computing the lane of the reference block */
@@ -144,27 +248,82 @@ void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position)
         ref_index = IndexAlpha(instance, &position, pseudo_rand & 0xFFFFFFFF, ref_lane == position.lane);
 
         /* 2 Creating a new block */
-        block* ref_block = instance->memory + instance->lane_length * ref_lane + ref_index;
-        block* curr_block = instance->memory + curr_offset;
-        FillBlock(instance->memory + prev_offset, ref_block, curr_block, instance->Sbox);
+        block* ref_block = instance->BlockAt(instance->lane_length * ref_lane + ref_index);
+        block* curr_block = instance->BlockAt(curr_offset);
+        FillBlock<kSbox>(instance->BlockAt(prev_offset), ref_block, curr_block, instance->Sbox);
     }
+}
 
-    delete[] pseudo_rands;
+void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position) {
+    if (instance == NULL) {
+        return;
+    }
+    // One type and addressing-mode test per segment instead of per block
+    bool data_independent = (instance->type == Argon2_i)
+            || (instance->type == Argon2_id && (position.pass == 0) && (position.slice < ARGON2_SYNC_POINTS / 2));
+    if (Argon2_ds == instance->type) {
+        FillSegmentImpl<true, false>(instance, position);
+    } else if (data_independent) {
+        FillSegmentImpl<false, true>(instance, position);
+    } else {
+        FillSegmentImpl<false, false>(instance, position);
+    }
 }
     
 
+void PrimeSegmentAddresses(const Argon2_instance_t* instance, Argon2_position_t position, uint32_t* out_offsets) {
+    uint64_t* pseudo_rands = GetSegmentScratch(instance->segment_length);
+    GenerateAddresses(instance, &position, pseudo_rands);
+    uint32_t starting_index = ((0 == position.pass) && (0 == position.slice)) ? 2 : 0;
+    for (uint32_t i = 0; i < starting_index; ++i) {
+        out_offsets[i] = 0; //never consumed
+    }
+    for (uint32_t i = starting_index; i < instance->segment_length; ++i) {
+        uint64_t pseudo_rand = pseudo_rands[i];
+        uint64_t ref_lane = ((pseudo_rand >> 32)) % instance->lanes;
+        if ((position.pass == 0) && (position.slice == 0)) {
+            ref_lane = position.lane;
+        }
+        position.index = i;
+        uint32_t ref_index = IndexAlpha(instance, &position, pseudo_rand & 0xFFFFFFFF, ref_lane == position.lane);
+        out_offsets[i] = instance->lane_length * ref_lane + ref_index;
+    }
+}
+
+void FillOneBlock(const block* prev_block, const block* ref_block, block* next_block,
+        const uint64_t* Sbox) {
+    // Single-block entry for the low-memory evaluator and the kernel bench
+    if (Sbox != NULL) {
+        FillBlock<true>(prev_block, ref_block, next_block, Sbox);
+    } else {
+        FillBlock<false>(prev_block, ref_block, next_block, NULL);
+    }
+}
+
+void FillSegmentPair(const Argon2_instance_t* instance, Argon2_position_t position_a, Argon2_position_t position_b) {
+    // The reference kernel has no interleaved variant; fill sequentially.
+    // (Parenthesized callee: plain lookup only, so the global dispatcher
+    // declaration never makes this call ambiguous inside a kernel namespace.)
+    (FillSegment)(instance, position_a);
+    (FillSegment)(instance, position_b);
+}
+
 void GenerateSbox(Argon2_instance_t* instance) {
     if (instance == NULL){
         return;
     }
-    block zero_block(0), start_block(instance->memory[0]), out_block(0);
+    block zero_block(0), start_block(*instance->BlockAt(0)), out_block(0);
     
     if (instance->Sbox == NULL){
         instance->Sbox = new uint64_t[ARGON2_SBOX_SIZE];
     }
     for (uint32_t i = 0; i < ARGON2_SBOX_SIZE / ARGON2_WORDS_IN_BLOCK; ++i) {
-        FillBlock(&zero_block, &start_block, &out_block, NULL);
-        FillBlock(&zero_block, &out_block, &start_block, NULL);
+        FillBlock<false>(&zero_block, &start_block, &out_block, NULL);
+        FillBlock<false>(&zero_block, &out_block, &start_block, NULL);
         memcpy(instance->Sbox + i*ARGON2_WORDS_IN_BLOCK, start_block.v, ARGON2_BLOCK_SIZE);
     }
 }
+
+#ifdef ARGON2_KERNEL_NS
+} //namespace ARGON2_KERNEL_NS
+#endif
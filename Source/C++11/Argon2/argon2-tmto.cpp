@@ -0,0 +1,394 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#include <cstdint>
+#include <cstring>
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "argon2.h"
+#include "argon2-core.h"
+#include "../Blake2/blake2.h"
+#include "../Blake2/blake2-impl.h"
+
+/*
+ * Low-memory (time-memory trade-off) evaluation engine for Argon2i.
+ *
+ * Because Argon2i addressing is data-independent, the whole reference stream
+ * can be derived up front from the parameters alone, and any block can be
+ * recomputed on demand from the two seed blocks of its lane. This engine runs
+ * the normal fill order but retains only ~memory_blocks/divisor blocks:
+ *
+ *  - an LRU pool holds the recently written blocks - Argon2i's quadratic
+ *    index mapping is heavily recency-biased, so LRU covers most references
+ *    (a Belady/farthest-next-use store driven by the precomputed reference
+ *    stream was measured strictly worse here: recompute traffic is itself
+ *    recency-biased and invisible to the sweep's use schedule);
+ *  - evenly spaced checkpoints are pinned so the prev-chain of any dropped
+ *    block reaches a stored one within one stride;
+ *  - for t_cost > 1, every block the following pass references is retained
+ *    unconditionally, so recompute chains never cross a pass boundary (a
+ *    dropped cross-pass dependency would cascade back to pass 0).
+ *
+ * A reference that was still dropped is recomputed through an explicit
+ * dependency stack. This is a verification aid for memory-starved hosts (the
+ * IoT case: checking a 64 MB argon2i hash in a fraction of that), not a fast
+ * path. Single-pass hashes get the full divisor; multi-pass hashes keep
+ * their cross-pass set resident, which floors the achievable reduction (see
+ * the measurements in the commit introducing this file). Data-dependent
+ * types (d, ds, and the second half of id) cannot be evaluated this way and
+ * are rejected.
+ */
+
+namespace {
+
+typedef uint64_t NodeKey; //pass * memory_blocks + absolute block offset
+
+class TmtoEvaluator {
+public:
+    TmtoEvaluator(const Argon2_instance_t* inst, uint32_t budget_blocks)
+    : instance(inst) {
+        stride = 2 * (instance->memory_blocks / budget_blocks);
+        if (stride == 0) {
+            stride = 1;
+        }
+        capacity = budget_blocks / 2;
+        if (capacity < 8) {
+            capacity = 8;
+        }
+    }
+
+    ~TmtoEvaluator() {
+        secure_wipe_memory(seed, sizeof (seed));
+    }
+
+    /* Derives the reference stream pass by pass, sweeps every pass in fill
+     * order under the block budget, and leaves the XOR of the last lane
+     * blocks in @xored */
+    void Run(Argon2_Context* context, Argon2_type type, block* xored) {
+        InitialHash(seed, context, type);
+        memset(seed + ARGON2_PREHASH_DIGEST_LENGTH, 0, 8);
+
+        const uint32_t lane_length = instance->lane_length;
+        const uint32_t segment_length = instance->segment_length;
+        for (uint32_t p = 0; p < instance->passes; ++p) {
+            StartPass(p);
+            for (uint8_t s = 0; s < ARGON2_SYNC_POINTS; ++s) {
+                for (uint32_t l = 0; l < instance->lanes; ++l) {
+                    uint32_t start = (p == 0 && s == 0) ? 2 : 0;
+                    uint32_t base = l * lane_length + (uint32_t) s * segment_length;
+                    block carry;
+                    if (start == 2) {
+                        Materialize(Key(0, base + 1), &carry);
+                    } else if (s == 0) {
+                        Materialize(Key(p - 1, base + lane_length - 1), &carry);
+                    } else {
+                        Materialize(Key(p, base - 1), &carry);
+                    }
+                    for (uint32_t i = start; i < segment_length; ++i) {
+                        uint32_t offset = base + i;
+                        block ref;
+                        Materialize(RefKey(p, offset), &ref);
+                        block next;
+                        FillOneBlock(&carry, &ref, &next);
+                        Store(Key(p, offset), &next, offset);
+                        carry = next;
+                    }
+                }
+            }
+        }
+
+        Materialize(Key(instance->passes - 1, lane_length - 1), xored);
+        for (uint32_t l = 1; l < instance->lanes; ++l) {
+            block last;
+            Materialize(Key(instance->passes - 1, l * lane_length + lane_length - 1), &last);
+            *xored ^= last;
+        }
+    }
+
+private:
+    NodeKey Key(uint32_t pass, uint32_t offset) const {
+        return (NodeKey) pass * instance->memory_blocks + offset;
+    }
+
+    NodeKey PrevKey(uint32_t pass, uint32_t offset) const {
+        if (offset % instance->lane_length == 0) {
+            //slice 0, index 0 (pass > 0 here: pass-0 heads are seed blocks)
+            return Key(pass - 1, offset + instance->lane_length - 1);
+        }
+        return Key(pass, offset - 1);
+    }
+
+    /* Resolves which pass the referenced offset was last written in: the
+     * current slice and everything before it belong to this pass, later
+     * slices still hold the previous pass. Only the running pass is ever
+     * asked (recompute chains never leave it), so one table suffices. */
+    NodeKey RefKey(uint32_t pass, uint32_t offset) const {
+        uint32_t r = refs_cur[offset];
+        if (pass == 0) {
+            return Key(0, r);
+        }
+        uint32_t slice = (offset % instance->lane_length) / instance->segment_length;
+        uint32_t ref_slice = (r % instance->lane_length) / instance->segment_length;
+        return Key((ref_slice <= slice) ? pass : pass - 1, r);
+    }
+
+    bool IsSeedNode(uint32_t pass, uint32_t offset) const {
+        return pass == 0 && (offset % instance->lane_length) < 2;
+    }
+
+    /* Block 0 or 1 of a lane: H'(H0 || counter || lane) */
+    void SeedBlock(uint32_t offset, block* out) const {
+        uint8_t seed_copy[ARGON2_PREHASH_SEED_LENGTH];
+        memcpy(seed_copy, seed, ARGON2_PREHASH_SEED_LENGTH);
+        store32(seed_copy + ARGON2_PREHASH_DIGEST_LENGTH, offset % instance->lane_length);
+        store32(seed_copy + ARGON2_PREHASH_DIGEST_LENGTH + 4, offset / instance->lane_length);
+        blake2b_long((uint8_t*) out->v, ARGON2_BLOCK_SIZE, seed_copy, ARGON2_PREHASH_SEED_LENGTH);
+        secure_wipe_memory(seed_copy, ARGON2_PREHASH_SEED_LENGTH);
+    }
+
+    const block* Find(NodeKey key) {
+        BlockMap::iterator it = pinned.find(key);
+        if (it != pinned.end()) {
+            return &it->second;
+        }
+        it = cross_prev.find(key);
+        if (it != cross_prev.end()) {
+            return &it->second;
+        }
+        it = cross_cur.find(key);
+        if (it != cross_cur.end()) {
+            return &it->second;
+        }
+        std::unordered_map<NodeKey, std::list<std::pair<NodeKey, block> >::iterator>::iterator
+                lit = lru_index.find(key);
+        if (lit != lru_index.end()) {
+            lru_entries.splice(lru_entries.begin(), lru_entries, lit->second);
+            return &lit->second->second;
+        }
+        return NULL;
+    }
+
+    /* Inserts a freshly computed block into the right layer: cross-pass
+     * dependencies are unconditional, checkpoints are pinned per pass, the
+     * rest competes in the LRU pool */
+    void Store(NodeKey key, const block* b, uint32_t offset) {
+        if (cross_flags[offset]) {
+            cross_cur[key] = *b;
+            return;
+        }
+        if (offset % stride == 0) {
+            pinned[key] = *b;
+            return;
+        }
+        if (lru_index.find(key) != lru_index.end()) {
+            return; //already resident
+        }
+        lru_entries.push_front(std::pair<NodeKey, block>(key, *b));
+        lru_index[key] = lru_entries.begin();
+        if (lru_entries.size() > capacity) {
+            lru_index.erase(lru_entries.back().first);
+            lru_entries.pop_back();
+        }
+    }
+
+    /* Pass boundary: the last pass's cross set retires, the collected one
+     * takes over, checkpoints of finished passes (unreachable by same-pass
+     * prev-chains) are dropped, and the reference tables slide forward one
+     * pass - only the running pass's refs and the next pass's retention
+     * marks are ever needed, so nothing here scales with t_cost */
+    void StartPass(uint32_t pass) {
+        cross_prev.swap(cross_cur);
+        cross_cur.clear();
+
+        const uint32_t m = instance->memory_blocks;
+        if (pass == 0) {
+            PrimeRefs(0, &refs_cur);
+        } else {
+            refs_cur.swap(refs_next);
+        }
+        cross_flags.assign(m, false);
+        if (pass + 1 < instance->passes) {
+            PrimeRefs(pass + 1, &refs_next);
+            // Mark every pass-@pass block the next pass will reference...
+            for (uint32_t off = 0; off < m; ++off) {
+                uint32_t r = refs_next[off];
+                uint32_t slice = (off % instance->lane_length) / instance->segment_length;
+                uint32_t ref_slice = (r % instance->lane_length) / instance->segment_length;
+                if (ref_slice > slice) {
+                    cross_flags[r] = true;
+                }
+            }
+            // ...including the lane ends that seed its prev chains
+            for (uint32_t l = 0; l < instance->lanes; ++l) {
+                cross_flags[l * instance->lane_length + instance->lane_length - 1] = true;
+            }
+        }
+
+        if (pass == 0) {
+            return;
+        }
+        NodeKey cutoff = (NodeKey) pass * m;
+        for (BlockMap::iterator it = pinned.begin();
+                it != pinned.end();) {
+            if (it->first < cutoff) {
+                it = pinned.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /* A dependency being resolved: captures its inputs as they appear so a
+     * later eviction cannot re-orphan it (no thrash on tiny budgets) */
+    struct Frame {
+        NodeKey key;
+        bool have_prev;
+        bool have_ref;
+        block prev;
+        block ref;
+
+        explicit Frame(NodeKey k) : key(k), have_prev(false), have_ref(false) {
+        };
+    };
+
+    /* Copies the node's block into @out, recomputing dropped dependencies
+     * through an explicit stack (the recursion can run deep on small budgets) */
+    void Materialize(NodeKey key, block* out) {
+        const block* hit = Find(key);
+        if (hit != NULL) {
+            *out = *hit;
+            return;
+        }
+        std::vector<Frame, Argon2AlignedAllocator<Frame> > stack;
+        stack.push_back(Frame(key));
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            uint32_t pass = (uint32_t) (frame.key / instance->memory_blocks);
+            uint32_t offset = (uint32_t) (frame.key % instance->memory_blocks);
+            if (frame.have_prev == false && frame.have_ref == false
+                    && Find(frame.key) != NULL) {
+                stack.pop_back(); //a sibling already computed it
+                continue;
+            }
+            if (IsSeedNode(pass, offset)) {
+                block b;
+                SeedBlock(offset, &b);
+                Store(frame.key, &b, offset);
+                stack.pop_back();
+                continue;
+            }
+            if (!frame.have_prev) {
+                NodeKey prev_key = PrevKey(pass, offset);
+                const block* prev = Find(prev_key);
+                if (prev == NULL) {
+                    stack.push_back(Frame(prev_key));
+                    continue;
+                }
+                frame.prev = *prev;
+                frame.have_prev = true;
+            }
+            if (!frame.have_ref) {
+                NodeKey ref_key = RefKey(pass, offset);
+                const block* ref = Find(ref_key);
+                if (ref == NULL) {
+                    stack.push_back(Frame(ref_key));
+                    continue;
+                }
+                frame.ref = *ref;
+                frame.have_ref = true;
+            }
+            block next;
+            FillOneBlock(&frame.prev, &frame.ref, &next);
+            Store(frame.key, &next, offset);
+            stack.pop_back();
+        }
+        hit = Find(key);
+        *out = *hit; //the last insert above was this key; it cannot be evicted yet
+    }
+
+    /* One pass of the reference stream (4 bytes per position - the
+     * data-independent addressing needs no block memory) */
+    void PrimeRefs(uint32_t pass, std::vector<uint32_t>* out) {
+        out->resize(instance->memory_blocks);
+        for (uint32_t l = 0; l < instance->lanes; ++l) {
+            for (uint8_t s = 0; s < ARGON2_SYNC_POINTS; ++s) {
+                size_t base = l * instance->lane_length
+                        + (uint32_t) s * instance->segment_length;
+                PrimeSegmentAddresses(instance, Argon2_position_t(pass, l, s, 0), &(*out)[base]);
+            }
+        }
+    }
+
+    const Argon2_instance_t* instance;
+    uint32_t stride; //offsets divisible by this are pinned per pass
+    size_t capacity; //block budget of the LRU pool
+
+    // Every container holding block allocates through the aligned allocator:
+    // the node types inherit alignof(block) = 64, which the default
+    // allocator does not honor (see Argon2AlignedAllocator)
+    typedef std::unordered_map<NodeKey, block, std::hash<NodeKey>, std::equal_to<NodeKey>,
+            Argon2AlignedAllocator<std::pair<const NodeKey, block> > > BlockMap;
+    typedef std::list<std::pair<NodeKey, block>,
+            Argon2AlignedAllocator<std::pair<NodeKey, block> > > BlockList;
+
+    BlockMap pinned;
+    BlockMap cross_prev;
+    BlockMap cross_cur;
+    BlockList lru_entries;
+    std::unordered_map<NodeKey, BlockList::iterator> lru_index;
+
+    std::vector<uint32_t> refs_cur; //running pass
+    std::vector<uint32_t> refs_next; //next pass, for the retention marks
+    std::vector<bool> cross_flags; //running-pass offsets the next pass references
+    uint8_t seed[ARGON2_PREHASH_SEED_LENGTH];
+};
+
+} //namespace
+
+int Argon2LowMemCore(Argon2_Context* context, Argon2_type type, uint32_t memory_divisor) {
+    if (memory_divisor < 2 || memory_divisor > 64) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    if (Argon2_i != type) {
+        return ARGON2_INCORRECT_TYPE; //data-dependent addressing cannot be recomputed
+    }
+    int result = ValidateInputs(context); //threads 0 = auto is fine: the evaluator is single-threaded regardless
+    if (ARGON2_OK != result) {
+        return result;
+    }
+
+    // Same geometry alignment as Argon2Core()
+    uint32_t memory_blocks = context->m_cost;
+    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * context->lanes) {
+        memory_blocks = 2 * ARGON2_SYNC_POINTS * context->lanes;
+    }
+    uint32_t segment_length = memory_blocks / (context->lanes * ARGON2_SYNC_POINTS);
+    memory_blocks = segment_length * (context->lanes * ARGON2_SYNC_POINTS);
+
+    uint32_t budget_blocks = memory_blocks / memory_divisor;
+    if (budget_blocks < 16) {
+        return ARGON2_INCORRECT_PARAMETER; //too small to trade against
+    }
+
+    // Geometry-only instance: the evaluator never touches instance->memory
+    Argon2_instance_t instance(NULL, type, context->t_cost, memory_blocks,
+            context->lanes, 1, false);
+
+    block xored;
+    TmtoEvaluator evaluator(&instance, budget_blocks);
+    evaluator.Run(context, type, &xored);
+
+    blake2b_long(context->out, context->outlen, (uint8_t*) xored.v, ARGON2_BLOCK_SIZE);
+    secure_wipe_memory(xored.v, ARGON2_BLOCK_SIZE);
+    return ARGON2_OK;
+}
@@ -13,8 +13,13 @@
 #include <cstdint>
 
 
+#include <chrono>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 
 /*For memory wiping*/
@@ -22,15 +27,27 @@
 #include "windows.h"
 #include "winbase.h" //For SecureZeroMemory
 #endif
+/*For the huge-page allocator*/
+#if defined(_WIN32)
+#include "windows.h"
+#else
+#include <sys/mman.h>
+#endif
 #if defined __STDC_LIB_EXT1__
 #define __STDC_WANT_LIB_EXT1__ 1
 #endif
 #define VC_GE_2005( version )		( version >= 1400 )
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
 
 
 #include "argon2.h"
 #include "argon2-core.h"
+#include "argon2-threads.h"
+#include "../Blake2/blake2.h"
 
 
 /************************* Error messages *********************************************************************************/
@@ -81,6 +98,13 @@ static std::map<Argon2_ErrorCodes, std::string> Argon2_ErrorMessage = {
     
     {ARGON2_THREADS_TOO_FEW, "Too few threads"},
     {ARGON2_THREADS_TOO_MANY, "Too many threads"},
+
+    {ARGON2_CANCELLED, "Hashing cancelled by the caller"},
+
+    {ARGON2_VERIFY_MISMATCH, "The password does not match the encoded hash"},
+    {ARGON2_DECODING_FAIL, "Decoding failed"},
+
+    {ARGON2_MEMORY_QUOTA_EXCEEDED, "The memory quota leaves no room for this hash"},
 };
 
 
@@ -146,6 +170,43 @@ int hash_argon2d(void *out, size_t outlen, const void *in, size_t inlen,
 
 
 
+static int HashParallel(void *out, size_t outlen, const void *in, size_t inlen,
+                 const void *salt, size_t saltlen, unsigned int t_cost,
+                 unsigned int m_cost, unsigned int parallelism, Argon2_type type) {
+    uint32_t hardware = std::thread::hardware_concurrency();
+    if (hardware == 0) {
+        hardware = 1;
+    }
+    uint32_t lanes = (parallelism != 0) ? parallelism : hardware;
+    uint32_t threads = (hardware < lanes) ? hardware : lanes;
+
+    const bool clear_password = true;
+    const bool clear_secret = false;
+    const bool clear_memory = false;
+    const bool print_internals = false;
+
+    Argon2_Context context((uint8_t*) out, (uint32_t) outlen,
+            (uint8_t*) in, (uint32_t) inlen,
+            (uint8_t*) salt, (uint32_t) saltlen,
+            NULL, 0, NULL, 0,
+            (uint32_t) t_cost, (uint32_t) m_cost, lanes, threads, NULL,
+            NULL, clear_password, clear_secret, clear_memory, print_internals);
+
+    return Argon2Core(&context, type);
+}
+
+int hash_argon2i_parallel(void *out, size_t outlen, const void *in, size_t inlen,
+                 const void *salt, size_t saltlen, unsigned int t_cost,
+                 unsigned int m_cost, unsigned int parallelism) {
+    return HashParallel(out, outlen, in, inlen, salt, saltlen, t_cost, m_cost, parallelism, Argon2_i);
+}
+
+int hash_argon2d_parallel(void *out, size_t outlen, const void *in, size_t inlen,
+                 const void *salt, size_t saltlen, unsigned int t_cost,
+                 unsigned int m_cost, unsigned int parallelism) {
+    return HashParallel(out, outlen, in, inlen, salt, saltlen, t_cost, m_cost, parallelism, Argon2_d);
+}
+
 int Argon2d(Argon2_Context* context) {
     return Argon2Core(context, Argon2_d);
 }
@@ -162,6 +223,312 @@ int Argon2ds(Argon2_Context* context) {
     return Argon2Core(context, Argon2_ds);
 }
 
+/* Huge pages are 2 MB on every platform we target */
+static const size_t ARGON2_HUGE_PAGE_SIZE = (size_t) 2 << 20;
+
+int Argon2HugePageAllocator(uint8_t **memory, size_t bytes_to_allocate) {
+    if (memory == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    size_t rounded = (bytes_to_allocate + ARGON2_HUGE_PAGE_SIZE - 1) & ~(ARGON2_HUGE_PAGE_SIZE - 1);
+#if defined(_WIN32)
+    void* region = VirtualAlloc(NULL, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (region == NULL) {
+        // Fallback: no SeLockMemoryPrivilege or fragmented large-page pool
+        region = VirtualAlloc(NULL, rounded, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    if (region == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+#else
+    void* region = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    region = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (region == MAP_FAILED) {
+        // Fallback: no explicit huge pages reserved; a 2 MB-aligned mapping
+        // still lets the kernel back it with transparent huge pages
+        region = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            return ARGON2_MEMORY_ALLOCATION_ERROR;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(region, rounded, MADV_HUGEPAGE);
+#endif
+    }
+#endif
+    *memory = (uint8_t*) region;
+    return ARGON2_OK;
+}
+
+void Argon2HugePageDeallocator(uint8_t *memory, size_t bytes_to_allocate) {
+    if (memory == NULL) {
+        return;
+    }
+    size_t rounded = (bytes_to_allocate + ARGON2_HUGE_PAGE_SIZE - 1) & ~(ARGON2_HUGE_PAGE_SIZE - 1);
+#if defined(_WIN32)
+    (void) rounded;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, rounded);
+#endif
+}
+
+int Argon2MmapAllocator(uint8_t **memory, size_t bytes_to_allocate) {
+    if (memory == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+#if defined(_WIN32)
+    // MEM_COMMIT charges the pages; faults are still lazy but cheap
+    void* region = VirtualAlloc(NULL, bytes_to_allocate, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (region == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    void* region = mmap(NULL, bytes_to_allocate, PROT_READ | PROT_WRITE, flags, -1, 0);
+#ifdef MAP_POPULATE
+    if (region == MAP_FAILED) {
+        // Pre-population can fail where a plain mapping would not (memory
+        // pressure); retry lazily-faulted before giving up
+        region = mmap(NULL, bytes_to_allocate, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+#endif
+    if (region == MAP_FAILED) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+#endif
+    *memory = (uint8_t*) region;
+    return ARGON2_OK;
+}
+
+void Argon2MmapDeallocator(uint8_t *memory, size_t bytes_to_allocate) {
+    if (memory == NULL) {
+        return;
+    }
+#if defined(_WIN32)
+    (void) bytes_to_allocate;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, bytes_to_allocate);
+#endif
+}
+
+Argon2_Arena::~Argon2_Arena() {
+    if (pending_teardown.valid()) {
+        pending_teardown.wait(); //a background wipe may still run on our buffer
+    }
+    if (memory != NULL) {
+        if (NULL != free_cbk) {
+            free_cbk(memory, memory_bytes);
+        } else {
+            FreeMemory((block*) memory);
+        }
+    }
+    if (sbox != NULL) {
+        delete[] sbox;
+    }
+}
+
+void Argon2SetWorkerLimit(uint32_t max_workers) {
+    Argon2ThreadPool::Instance().SetConcurrencyLimit(max_workers);
+}
+
+/*
+ * Posts the whole hash to the shared pool. The wrapper task reserves its worker
+ * so the lane teams spawned inside Argon2Core still find enough free threads.
+ */
+static std::future<int> Argon2CoreAsync(Argon2_Context* context, Argon2_type type) {
+    Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+    pool.Reserve(1, false); //coordinator: mostly blocked, exempt from the concurrency cap
+    auto task = std::make_shared<std::packaged_task<int()> >([context, type]() {
+        int result = Argon2Core(context, type);
+        Argon2ThreadPool::Instance().Release(1, false);
+        return result;
+    });
+    std::future<int> result = task->get_future();
+    pool.Submit([task]() {
+        (*task)();
+    });
+    return result;
+}
+
+std::future<int> Argon2dAsync(Argon2_Context* context) {
+    return Argon2CoreAsync(context, Argon2_d);
+}
+
+std::future<int> Argon2iAsync(Argon2_Context* context) {
+    return Argon2CoreAsync(context, Argon2_i);
+}
+
+std::future<int> Argon2idAsync(Argon2_Context* context) {
+    return Argon2CoreAsync(context, Argon2_id);
+}
+
+std::future<int> Argon2dsAsync(Argon2_Context* context) {
+    return Argon2CoreAsync(context, Argon2_ds);
+}
+
+int Argon2BatchHash(Argon2_Context* const* contexts, size_t count, uint32_t type) {
+    if (contexts == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    Argon2_Arena batch_arena;
+    int first_error = ARGON2_OK;
+    for (size_t i = 0; i < count; ++i) {
+        Argon2_Context* context = contexts[i];
+        if (context == NULL) {
+            if (ARGON2_OK == first_error) {
+                first_error = ARGON2_INCORRECT_PARAMETER;
+            }
+            continue;
+        }
+        Argon2_Arena* saved_arena = context->arena;
+        bool saved_teardown = context->background_teardown;
+        if (context->arena == NULL) {
+            context->arena = &batch_arena;
+        }
+        // Pipelining: item i's wipe runs on a worker while item i+1 proceeds
+        // up to the arena fence
+        context->background_teardown = true;
+        int result = Argon2Core(context, (Argon2_type) type);
+        context->arena = saved_arena;
+        context->background_teardown = saved_teardown;
+        if (ARGON2_OK != result && ARGON2_OK == first_error) {
+            first_error = result;
+        }
+    }
+    // ~Argon2_Arena waits for the last in-flight wipe and frees the memory
+    return first_error;
+}
+
+int Argon2iLowMem(Argon2_Context* context, uint32_t memory_divisor) {
+    return Argon2LowMemCore(context, Argon2_i, memory_divisor);
+}
+
+int Argon2ComputePreTag(Argon2_Context* context, uint32_t type,
+        uint8_t* pre_tag, size_t pre_tag_len) {
+    if (pre_tag == NULL || pre_tag_len != ARGON2_PRETAG_BYTES) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    if (context == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    return Argon2CoreToPreTag(context, (Argon2_type) type, pre_tag);
+}
+
+int Argon2FinishTag(const uint8_t* pre_tag, size_t pre_tag_len,
+        void* out, uint32_t outlen) {
+    if (pre_tag == NULL || pre_tag_len != ARGON2_PRETAG_BYTES) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    if (out == NULL) {
+        return ARGON2_OUTPUT_PTR_NULL;
+    }
+    if (outlen < ARGON2_MIN_OUTLEN) {
+        return ARGON2_OUTPUT_TOO_SHORT;
+    }
+    blake2b_long(out, outlen, pre_tag, ARGON2_PRETAG_BYTES);
+    return ARGON2_OK;
+}
+
+int Argon2StrengthenState(uint8_t* pre_tag, size_t pre_tag_len, uint32_t type,
+        uint32_t extra_t_cost, uint32_t m_cost, uint32_t lanes,
+        const void* salt, size_t saltlen) {
+    if (pre_tag == NULL || pre_tag_len != ARGON2_PRETAG_BYTES) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    if (extra_t_cost == 0) {
+        return ARGON2_INCORRECT_PARAMETER; //a no-op step would silently leave the chain unmodified
+    }
+    // The stored state is the password-equivalent secret of the chain: feed
+    // it through a full memory-hard pass set as the next link's password and
+    // keep the new pre-tag. Strengthening and login-side verification run
+    // the identical step, so the chain stays deterministic.
+    uint8_t next_state[ARGON2_PRETAG_BYTES];
+    uint8_t unused_out[ARGON2_MIN_OUTLEN]; //validated but never written in pre-tag mode
+    Argon2_Context context(unused_out, sizeof (unused_out),
+            pre_tag, (uint32_t) pre_tag_len,
+            (uint8_t*) salt, (uint32_t) saltlen,
+            NULL, 0, NULL, 0,
+            extra_t_cost, m_cost, lanes, 1,
+            NULL, NULL, false, false, false, false);
+    int result = Argon2CoreToPreTag(&context, (Argon2_type) type, next_state);
+    if (ARGON2_OK != result) {
+        secure_wipe_memory(next_state, sizeof (next_state));
+        return result;
+    }
+    memcpy(pre_tag, next_state, ARGON2_PRETAG_BYTES);
+    secure_wipe_memory(next_state, sizeof (next_state));
+    return ARGON2_OK;
+}
+
+static void RehashOne(Argon2_RehashItem* item, const Argon2_Params* new_params) {
+    // Pre-set so a bad_alloc escaping into the packaged_task (which the
+    // pipeline wait()s on without rethrowing) still reads as a failed item
+    item->result = ARGON2_MEMORY_ALLOCATION_ERROR;
+    item->result = Argon2VerifyEncoded(item->old_encoded, item->pwd, item->pwdlen);
+    if (ARGON2_OK != item->result) {
+        return;
+    }
+    uint8_t tag[32];
+    item->result = Argon2HashWithParams(new_params, item->pwd, item->pwdlen,
+            item->new_salt, item->new_saltlen, tag, sizeof (tag));
+    if (ARGON2_OK != item->result) {
+        return;
+    }
+    // Borrow a context shell for the encoder (it reads salt/out/costs only)
+    Argon2_Context encode_view(tag, sizeof (tag),
+            NULL, 0, (uint8_t*) item->new_salt, (uint32_t) item->new_saltlen,
+            NULL, 0, NULL, 0,
+            new_params->t_cost, new_params->m_cost, new_params->lanes, new_params->threads,
+            NULL, NULL, false, false, false, false);
+    item->result = Argon2EncodeHash(item->new_encoded, item->new_encoded_len,
+            &encode_view, new_params->type);
+    secure_wipe_memory(tag, sizeof (tag));
+}
+
+int Argon2Rehash(Argon2_RehashItem* items, size_t count, const Argon2_Params* new_params) {
+    if (items == NULL || new_params == NULL || !new_params->valid) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+    int first_error = ARGON2_OK;
+
+    // Two items in flight: the next verification overlaps the current rehash.
+    // Each in-flight item is a coordinator (exempt from the concurrency cap)
+    // so the lane teams it spawns cannot deadlock against it.
+    std::future<void> in_flight[2];
+    for (size_t i = 0; i < count + 2; ++i) {
+        size_t slot = i % 2;
+        if (in_flight[slot].valid()) {
+            in_flight[slot].wait();
+            pool.Release(1, false);
+        }
+        if (i >= count) {
+            continue; //draining
+        }
+        Argon2_RehashItem* item = &items[i];
+        pool.Reserve(1, false);
+        auto task = std::make_shared<std::packaged_task<void()> >([item, new_params]() {
+            RehashOne(item, new_params);
+        });
+        in_flight[slot] = task->get_future();
+        pool.Submit([task]() {
+            (*task)();
+        });
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (ARGON2_OK != items[i].result && ARGON2_OK == first_error) {
+            first_error = items[i].result;
+        }
+    }
+    return first_error;
+}
+
 int VerifyD(Argon2_Context* context, const char *hash) {
     if (0 == context->outlen || NULL == hash) {
         return ARGON2_OUT_PTR_MISMATCH;
@@ -200,7 +567,51 @@ const char* ErrorMessage(int error_code) {
 #endif
 
 
+#if defined(__SSE2__) || defined(_M_X64)
+/*
+ * Large-region wipe with non-temporal streaming stores: ClearMemory() wipes
+ * multi-gigabyte block arrays, and a cached memset drags every dead line
+ * through the hierarchy, evicting the live working set of concurrent hashes
+ * on the same socket. Streaming zeros bypass the cache and run at full store
+ * bandwidth; the trailing sfence plus compiler barrier keep the secure
+ * semantics - the stores are globally visible and cannot be elided before
+ * the region is freed or reused.
+ */
+static void NOT_OPTIMIZED wipe_streaming(uint8_t* p, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    // Head: align to 16 bytes the slow, sure way
+    while (((uintptr_t) p & 15) != 0 && n != 0) {
+        *(volatile uint8_t*) p = 0;
+        ++p;
+        --n;
+    }
+    while (n >= 64) {
+        _mm_stream_si128((__m128i*) (p + 0), zero);
+        _mm_stream_si128((__m128i*) (p + 16), zero);
+        _mm_stream_si128((__m128i*) (p + 32), zero);
+        _mm_stream_si128((__m128i*) (p + 48), zero);
+        p += 64;
+        n -= 64;
+    }
+    while (n != 0) {
+        *(volatile uint8_t*) p = 0;
+        ++p;
+        --n;
+    }
+    _mm_sfence(); //order the streaming stores before the region is reused
+}
+#endif
+
 void NOT_OPTIMIZED secure_wipe_memory(void *v, size_t n) {
+#if defined(__SSE2__) || defined(_M_X64)
+    // Cache-bypassing path for big regions only: small wipes (tags, seeds)
+    // are about to be reused or are latency-critical, and NT stores would
+    // just add fence cost there
+    if (n >= (size_t) 1 << 20) {
+        wipe_streaming((uint8_t*) v, n);
+        return;
+    }
+#endif
 #if defined  (_MSC_VER ) &&  VC_GE_2005( _MSC_VER )
     SecureZeroMemory(v, n);
 #elif defined memset_s
@@ -236,6 +647,43 @@ static int b64_byte_to_char(unsigned x) {
            (EQ(x, 63) & '/');
 }
 
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * SSSE3 bulk encoder: 12 input bytes become 16 output characters per step,
+ * with the alphabet translation done by an in-register pshufb lookup (no
+ * memory-indexed table, so it stays constant time like the scalar path).
+ * Compiled with a target attribute and selected at runtime, so plain builds
+ * still carry it and old CPUs fall back to the scalar loop.
+ */
+__attribute__((target("ssse3")))
+static size_t to_base64_bulk(char *dst, const unsigned char *src, size_t src_len) {
+    size_t done = 0;
+    // Each iteration loads 16 bytes but consumes 12; stop while a full load fits
+    while (src_len - done >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + done));
+        in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+        const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+        const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(t1, t3);
+        const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+        __m128i offsets = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i mask = _mm_cmpgt_epi8(indices, _mm_set1_epi8(25));
+        offsets = _mm_sub_epi8(offsets, mask);
+        _mm_storeu_si128((__m128i *)dst, _mm_add_epi8(indices, _mm_shuffle_epi8(lut, offsets)));
+        dst += 16;
+        done += 12;
+    }
+    return done;
+}
+
+static bool to_base64_bulk_usable() {
+    static const bool usable = __builtin_cpu_supports("ssse3");
+    return usable;
+}
+#endif
+
 /*
  * Convert some bytes to Base64. 'dst_len' is the length (in characters)
  * of the output buffer 'dst'; if that buffer is not large enough to
@@ -265,6 +713,14 @@ static size_t to_base64(char *dst, size_t dst_len, const void *src,
     acc = 0;
     acc_len = 0;
     buf = (const unsigned char *)src;
+#if defined(__x86_64__) || defined(__i386__)
+    if (to_base64_bulk_usable() && src_len >= 16) {
+        size_t consumed = to_base64_bulk(dst, buf, src_len);
+        dst += (consumed / 3) << 2;
+        buf += consumed;
+        src_len -= consumed;
+    }
+#endif
     while (src_len-- > 0) {
         acc = (acc << 8) + (*buf++);
         acc_len += 8;
@@ -357,4 +813,526 @@ int encode_string(char *dst, size_t dst_len, Argon2_Context *ctx) {
 #undef SS
 #undef SX
 #undef SB
-}
\ No newline at end of file
+}
+
+/*
+ * Constant-time Base64 character decoder: returns the 6-bit value or 0xFF.
+ */
+static unsigned b64_char_to_byte(int c) {
+    unsigned x = (GE(c, 'A') & LE(c, 'Z') & (c - 'A')) |
+                 (GE(c, 'a') & LE(c, 'z') & (c - ('a' - 26))) |
+                 (GE(c, '0') & LE(c, '9') & (c - ('0' - 52))) |
+                 (EQ(c, '+') & 62) | (EQ(c, '/') & 63);
+    return x | (EQ(x, 0) & ~EQ(c, 'A') & 0xFF);
+}
+
+/*
+ * Decodes unpadded Base64 into @dst. Stops at the first non-alphabet
+ * character (the caller checks what follows). Returns bytes written or
+ * (size_t)-1 on overflow/invalid trailing bits.
+ */
+static size_t from_base64(uint8_t *dst, size_t dst_len, const char *src, const char **end) {
+    size_t written = 0;
+    unsigned acc = 0, acc_len = 0;
+    while (*src != '\0') {
+        unsigned d = b64_char_to_byte((unsigned char) *src);
+        if (d == 0xFF) {
+            break;
+        }
+        src++;
+        acc = (acc << 6) + d;
+        acc_len += 6;
+        if (acc_len >= 8) {
+            acc_len -= 8;
+            if (written >= dst_len) {
+                return (size_t)-1;
+            }
+            dst[written++] = (uint8_t)((acc >> acc_len) & 0xFF);
+        }
+    }
+    if (acc_len > 4 || (acc & ((1u << acc_len) - 1)) != 0) {
+        return (size_t)-1; //dangling or non-zero padding bits
+    }
+    *end = src;
+    return written;
+}
+
+/* Bounded decimal parser; advances *src past the digits */
+static int parse_u32(const char **src, uint32_t *out) {
+    const char *p = *src;
+    uint64_t value = 0;
+    if (*p < '0' || *p > '9') {
+        return -1;
+    }
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (uint64_t)(*p - '0');
+        if (value > UINT32_MAX) {
+            return -1;
+        }
+        ++p;
+    }
+    *src = p;
+    *out = (uint32_t) value;
+    return 0;
+}
+
+static const char* Argon2TypeName(uint32_t type) {
+    switch ((Argon2_type) type) {
+        case Argon2_d: return "argon2d";
+        case Argon2_i: return "argon2i";
+        case Argon2_id: return "argon2id";
+        case Argon2_ds: return "argon2ds";
+    }
+    return NULL;
+}
+
+int Argon2EncodeHash(char* dst, size_t dst_len, const Argon2_Context* context, uint32_t type) {
+    if (dst == NULL || context == NULL) {
+        return ARGON2_DECODING_FAIL;
+    }
+    const char* name = Argon2TypeName(type);
+    if (name == NULL) {
+        return ARGON2_DECODING_FAIL;
+    }
+    int written = snprintf(dst, dst_len, "$%s$v=%u$m=%u,t=%u,p=%u$",
+            name, (unsigned) ARGON2_VERSION_NUMBER,
+            (unsigned) context->m_cost, (unsigned) context->t_cost, (unsigned) context->lanes);
+    if (written < 0 || (size_t) written >= dst_len) {
+        return ARGON2_DECODING_FAIL;
+    }
+    size_t pos = (size_t) written;
+    size_t n = to_base64(dst + pos, dst_len - pos, context->salt, context->saltlen);
+    if (n == (size_t)-1) {
+        return ARGON2_DECODING_FAIL;
+    }
+    pos += n;
+    if (pos + 1 >= dst_len) {
+        return ARGON2_DECODING_FAIL;
+    }
+    dst[pos++] = '$';
+    n = to_base64(dst + pos, dst_len - pos, context->out, context->outlen);
+    if (n == (size_t)-1) {
+        return ARGON2_DECODING_FAIL;
+    }
+    return ARGON2_OK;
+}
+
+int Argon2DecodeHash(const char* encoded, uint32_t* type, uint32_t* version,
+        uint32_t* m_cost, uint32_t* t_cost, uint32_t* lanes,
+        uint8_t* salt, size_t* saltlen, uint8_t* tag, size_t* taglen) {
+    if (encoded == NULL || type == NULL || version == NULL || m_cost == NULL
+            || t_cost == NULL || lanes == NULL || salt == NULL || saltlen == NULL
+            || tag == NULL || taglen == NULL) {
+        return ARGON2_DECODING_FAIL;
+    }
+    const char* p = encoded;
+    if (*p++ != '$') {
+        return ARGON2_DECODING_FAIL;
+    }
+    static const struct { const char* name; uint32_t value; } kTypes[] = {
+        {"argon2id", (uint32_t) Argon2_id}, //longest names first
+        {"argon2ds", (uint32_t) Argon2_ds},
+        {"argon2d", (uint32_t) Argon2_d},
+        {"argon2i", (uint32_t) Argon2_i},
+    };
+    uint32_t parsed_type = 0;
+    size_t t;
+    for (t = 0; t < sizeof (kTypes) / sizeof (kTypes[0]); ++t) {
+        size_t len = strlen(kTypes[t].name);
+        if (0 == strncmp(p, kTypes[t].name, len) && p[len] == '$') {
+            parsed_type = kTypes[t].value;
+            p += len + 1;
+            break;
+        }
+    }
+    if (t == sizeof (kTypes) / sizeof (kTypes[0])) {
+        return ARGON2_DECODING_FAIL;
+    }
+    if (0 != strncmp(p, "v=", 2)) {
+        return ARGON2_DECODING_FAIL;
+    }
+    p += 2;
+    if (0 != parse_u32(&p, version) || *p++ != '$') {
+        return ARGON2_DECODING_FAIL;
+    }
+    if (0 != strncmp(p, "m=", 2)) {
+        return ARGON2_DECODING_FAIL;
+    }
+    p += 2;
+    if (0 != parse_u32(&p, m_cost) || 0 != strncmp(p, ",t=", 3)) {
+        return ARGON2_DECODING_FAIL;
+    }
+    p += 3;
+    if (0 != parse_u32(&p, t_cost) || 0 != strncmp(p, ",p=", 3)) {
+        return ARGON2_DECODING_FAIL;
+    }
+    p += 3;
+    if (0 != parse_u32(&p, lanes) || *p++ != '$') {
+        return ARGON2_DECODING_FAIL;
+    }
+    const char* end = NULL;
+    size_t n = from_base64(salt, *saltlen, p, &end);
+    if (n == (size_t)-1 || *end != '$') {
+        return ARGON2_DECODING_FAIL;
+    }
+    *saltlen = n;
+    p = end + 1;
+    n = from_base64(tag, *taglen, p, &end);
+    if (n == (size_t)-1 || *end != '\0' || n == 0) {
+        return ARGON2_DECODING_FAIL;
+    }
+    *taglen = n;
+    *type = parsed_type;
+    return ARGON2_OK;
+}
+
+/* Constant-time tag comparison: no early exit on a mismatching byte */
+static int constant_time_equals(const uint8_t* a, const uint8_t* b, size_t n) {
+    unsigned diff = 0;
+    for (size_t i = 0; i < n; ++i) {
+        diff |= (unsigned)(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+int Argon2VerifyEncodedLowMem(const char* encoded, const void* pwd, size_t pwdlen,
+        uint32_t memory_divisor) {
+    uint32_t type, version, m_cost, t_cost, lanes;
+    uint8_t salt[64];
+    uint8_t stored_tag[64];
+    size_t saltlen = sizeof (salt);
+    size_t taglen = sizeof (stored_tag);
+    int result = Argon2DecodeHash(encoded, &type, &version, &m_cost, &t_cost, &lanes,
+            salt, &saltlen, stored_tag, &taglen);
+    if (ARGON2_OK != result) {
+        return result;
+    }
+    if (version != ARGON2_VERSION_NUMBER) {
+        return ARGON2_DECODING_FAIL;
+    }
+    uint8_t computed_tag[64];
+    Argon2_Context context(computed_tag, (uint32_t) taglen,
+            (uint8_t*) pwd, (uint32_t) pwdlen,
+            salt, (uint32_t) saltlen,
+            NULL, 0, NULL, 0,
+            t_cost, m_cost, lanes, 1,
+            NULL, NULL, false, false, false, false);
+    result = Argon2LowMemCore(&context, (Argon2_type) type, memory_divisor);
+    if (ARGON2_OK != result) {
+        return result;
+    }
+    result = constant_time_equals(computed_tag, stored_tag, taglen)
+            ? ARGON2_OK : ARGON2_VERIFY_MISMATCH;
+    secure_wipe_memory(computed_tag, sizeof (computed_tag));
+    return result;
+}
+
+/*
+ * Compiled-in self-test: one minimal hash per type (16 KB, one pass, one
+ * lane) against tags fixed at build time - the compliance "KAT at every
+ * service start" without forking genkat or reading vector files, a few
+ * hundred microseconds total. The tags are kernel-independent (every
+ * dispatch tier computes the same function), so this also catches a
+ * miscompiled or misdispatched kernel on the deployment host. The verdict
+ * is computed once and cached: container fleets call this from every
+ * process, and the second caller in a process gets the memoized answer.
+ */
+static const uint8_t selftest_tags[4][32] = {
+    {0x5c, 0x88, 0xd1, 0x6d, 0x1a, 0xe5, 0x25, 0x10, 0x4f, 0x27, 0x8a, 0x60, 0x7e, 0x51, 0x25, 0xa3, 0xed, 0x9c, 0xda, 0x11, 0x16, 0x54, 0xc1, 0x7b, 0x10, 0x7c, 0x4d, 0xc4, 0x76, 0x6f, 0x06, 0xd1},
+    {0x74, 0x13, 0x88, 0x10, 0xce, 0x46, 0x1d, 0x02, 0x31, 0x0b, 0x62, 0xab, 0x47, 0x0a, 0xe0, 0x3c, 0xf8, 0xa7, 0x75, 0x02, 0xf1, 0xa7, 0x43, 0x42, 0xa3, 0x9e, 0x4f, 0x2d, 0x78, 0x0d, 0x2d, 0x16},
+    {0x18, 0x4c, 0x45, 0x09, 0x3e, 0x65, 0xd4, 0x23, 0x9d, 0x6a, 0x57, 0x73, 0x8a, 0x1e, 0x5b, 0x56, 0x3c, 0x1d, 0x35, 0xe6, 0x1e, 0x05, 0x38, 0x45, 0xe2, 0xa0, 0x7d, 0x77, 0x57, 0x3c, 0xb7, 0xc4},
+    {0x73, 0x6f, 0x39, 0x58, 0x9c, 0x00, 0xd6, 0x30, 0x98, 0x29, 0x23, 0xda, 0x12, 0x0e, 0x06, 0x61, 0x1a, 0x99, 0xca, 0x8f, 0x13, 0x64, 0x63, 0x6a, 0x17, 0x68, 0xeb, 0x32, 0x15, 0xa9, 0xba, 0xfc}
+};
+
+static int RunSelfTest() {
+    static const Argon2_type types[4] = {Argon2_d, Argon2_i, Argon2_id, Argon2_ds};
+    uint8_t pwd[8];
+    uint8_t salt[8];
+    for (int t = 0; t < 4; ++t) {
+        memcpy(pwd, "selftest", 8); //the context may wipe its inputs on future flags
+        memcpy(salt, "argon2ok", 8);
+        uint8_t out[32];
+        Argon2_Context context(out, sizeof (out), pwd, sizeof (pwd),
+                salt, sizeof (salt), NULL, 0, NULL, 0,
+                1, 16, 1, 1, NULL, NULL, false, false, false, false);
+        int result = Argon2Core(&context, types[t]);
+        if (ARGON2_OK != result) {
+            return result;
+        }
+        if (!constant_time_equals(out, selftest_tags[t], sizeof (out))) {
+            return ARGON2_SELFTEST_FAIL;
+        }
+    }
+    return ARGON2_OK;
+}
+
+int Argon2SelfTest() {
+    static const int verdict = RunSelfTest(); //magic static: raced callers wait
+    return verdict;
+}
+
+/*
+ * In-flight coalescing: under credential-stuffing bursts the same
+ * (encoded, pwd) verification arrives dozens of times within one hash's
+ * latency; duplicates attach to the first computation's completion instead
+ * of burning m_cost of memory bandwidth each. Keys are full BLAKE2b-256
+ * digests - a short fast hash would let an attacker force collisions and
+ * steal another request's verdict. No state outlives the in-flight window.
+ */
+static std::mutex coalesce_mutex;
+static std::map<std::string, std::shared_future<int> >* coalesce_inflight = NULL;
+static bool coalesce_enabled = false;
+
+void Argon2SetVerifyCoalescing(bool on) {
+    std::unique_lock<std::mutex> lock(coalesce_mutex);
+    coalesce_enabled = on;
+    if (on && coalesce_inflight == NULL) {
+        coalesce_inflight = new std::map<std::string, std::shared_future<int> >();
+    }
+}
+
+static int VerifyEncodedImpl(const char* encoded, const void* pwd, size_t pwdlen,
+        Argon2_Arena* arena, bool route_versions);
+
+static int VerifyEncodedReal(const char* encoded, const void* pwd, size_t pwdlen) {
+    return VerifyEncodedImpl(encoded, pwd, pwdlen, NULL, false);
+}
+
+int Argon2VerifyRouted(const char* encoded, const void* pwd, size_t pwdlen,
+        Argon2_Arena* arena) {
+    return VerifyEncodedImpl(encoded, pwd, pwdlen, arena, true);
+}
+
+int Argon2VerifyEncoded(const char* encoded, const void* pwd, size_t pwdlen) {
+    {
+        std::unique_lock<std::mutex> lock(coalesce_mutex);
+        if (!coalesce_enabled) {
+            lock.unlock();
+            return VerifyEncodedReal(encoded, pwd, pwdlen);
+        }
+    }
+    if (encoded == NULL || pwd == NULL) {
+        return VerifyEncodedReal(encoded, pwd, pwdlen); //let it report the error
+    }
+    uint8_t digest[32];
+    {
+        blake2b_state key_state;
+        blake2b_init(&key_state, sizeof (digest));
+        blake2b_update(&key_state, (const uint8_t*) encoded, strlen(encoded) + 1); //the NUL separates fields
+        blake2b_update(&key_state, (const uint8_t*) pwd, pwdlen);
+        blake2b_final(&key_state, digest, sizeof (digest));
+    }
+    std::string key((const char*) digest, sizeof (digest));
+    secure_wipe_memory(digest, sizeof (digest));
+
+    std::shared_ptr<std::promise<int> > leader_promise;
+    std::shared_future<int> attached;
+    {
+        std::unique_lock<std::mutex> lock(coalesce_mutex);
+        if (!coalesce_enabled || coalesce_inflight == NULL) {
+            lock.unlock();
+            return VerifyEncodedReal(encoded, pwd, pwdlen);
+        }
+        std::map<std::string, std::shared_future<int> >::iterator it = coalesce_inflight->find(key);
+        if (it != coalesce_inflight->end()) {
+            attached = it->second; //duplicate: ride the leader's computation
+        } else {
+            leader_promise.reset(new std::promise<int>());
+            (*coalesce_inflight)[key] = leader_promise->get_future().share();
+        }
+    }
+    if (attached.valid()) {
+        return attached.get();
+    }
+    int result = VerifyEncodedReal(encoded, pwd, pwdlen);
+    {
+        std::unique_lock<std::mutex> lock(coalesce_mutex);
+        if (coalesce_inflight != NULL) {
+            coalesce_inflight->erase(key);
+        }
+    }
+    leader_promise->set_value(result);
+    return result;
+}
+
+static int VerifyEncodedImpl(const char* encoded, const void* pwd, size_t pwdlen,
+        Argon2_Arena* arena, bool route_versions) {
+    uint32_t type, version, m_cost, t_cost, lanes;
+    uint8_t salt[64];
+    uint8_t stored_tag[64];
+    size_t saltlen = sizeof (salt);
+    size_t taglen = sizeof (stored_tag);
+    int result = Argon2DecodeHash(encoded, &type, &version, &m_cost, &t_cost, &lanes,
+            salt, &saltlen, stored_tag, &taglen);
+    if (ARGON2_OK != result) {
+        return result;
+    }
+    if (version != ARGON2_VERSION_NUMBER) {
+        // Routed callers get a precise signal for a well-formed hash from
+        // another format generation, distinct from a malformed string, so
+        // the application can hand it to its legacy verifier
+        return route_versions ? ARGON2_UNSUPPORTED_VERSION : ARGON2_DECODING_FAIL;
+    }
+    uint8_t computed_tag[64];
+    // lanes is part of the hash; the thread count is ours to choose, and an
+    // encoded string must never be able to demand millions of workers
+    uint32_t threads = std::thread::hardware_concurrency();
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (threads > lanes) {
+        threads = lanes;
+    }
+    // Verification fast path: the memory contents derive from the supplied
+    // password and the tag comparison is the only output, so nothing needs
+    // wiping and the block array stays warm in a per-thread arena - steady
+    // state verification pays no allocate, no fault, no wipe, no free. A
+    // caller-supplied arena takes precedence so heterogeneous request
+    // streams share one allocation across types and entry points.
+    static thread_local Argon2_Arena verify_arena;
+    Argon2_Context context(computed_tag, (uint32_t) taglen,
+            (uint8_t*) pwd, (uint32_t) pwdlen,
+            salt, (uint32_t) saltlen,
+            NULL, 0, NULL, 0,
+            t_cost, m_cost, lanes, threads,
+            NULL, NULL, false, false, false, false,
+            NULL, 0, NULL, ARGON2_PRIORITY_INTERACTIVE, NULL, NULL,
+            (arena != NULL) ? arena : &verify_arena);
+    result = Argon2Core(&context, (Argon2_type) type);
+    if (ARGON2_OK != result) {
+        return result;
+    }
+    result = constant_time_equals(computed_tag, stored_tag, taglen)
+            ? ARGON2_OK : ARGON2_VERIFY_MISMATCH;
+    secure_wipe_memory(computed_tag, sizeof (computed_tag));
+    return result;
+}
+
+/* One timed Argon2id hash; returns microseconds or -1 on error */
+static long long CalibrationProbe(uint32_t m_cost, uint32_t t_cost, uint32_t threads) {
+    uint8_t out[32];
+    uint8_t pwd[16];
+    uint8_t salt[16];
+    memset(pwd, 0x01, sizeof (pwd));
+    memset(salt, 0x02, sizeof (salt));
+    Argon2_Context context(out, sizeof (out), pwd, sizeof (pwd), salt, sizeof (salt),
+            NULL, 0, NULL, 0, t_cost, m_cost, threads, threads,
+            NULL, NULL, false, false, false, false);
+    auto start = std::chrono::steady_clock::now();
+    int result = Argon2Core(&context, Argon2_id);
+    if (ARGON2_OK != result) {
+        return -1;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+int Argon2Calibrate(uint32_t target_ms, uint32_t max_memory_kib, uint32_t threads,
+        uint32_t* out_m_cost, uint32_t* out_t_cost) {
+    if (out_m_cost == NULL || out_t_cost == NULL || target_ms == 0) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (max_memory_kib < ARGON2_MIN_MEMORY) {
+        max_memory_kib = ARGON2_MIN_MEMORY;
+    }
+
+    // Hardness scales with memory first: find the largest power-of-two m_cost
+    // whose single pass fits the budget, starting from a cheap probe so an
+    // over-budget machine never runs a huge calibration hash
+    uint32_t m_cost = 1024; //1 MiB probe
+    if (m_cost > max_memory_kib) {
+        m_cost = max_memory_kib;
+    }
+    const long long target_us = (long long) target_ms * 1000;
+    long long elapsed = CalibrationProbe(m_cost, 1, threads);
+    if (elapsed < 0) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    while (m_cost * 2 <= max_memory_kib) {
+        long long next = CalibrationProbe(m_cost * 2, 1, threads);
+        if (next < 0 || next > target_us) {
+            break;
+        }
+        m_cost *= 2;
+        elapsed = next;
+    }
+
+    // Then spend the remaining budget on passes (time is ~linear in t_cost)
+    uint32_t t_cost = 1;
+    if (elapsed < 1) {
+        elapsed = 1; //sub-microsecond probes still project sanely
+    }
+    while (t_cost < 16) {
+        long long projected = elapsed * (t_cost + 1) / t_cost;
+        if (projected > target_us) {
+            break;
+        }
+        long long measured = CalibrationProbe(m_cost, t_cost + 1, threads);
+        if (measured < 0 || measured > target_us) {
+            break;
+        }
+        ++t_cost;
+        elapsed = (measured > 0) ? measured : 1;
+    }
+
+    *out_m_cost = m_cost;
+    *out_t_cost = t_cost;
+    return ARGON2_OK;
+}
+
+extern "C" int argon2_hash(uint32_t t_cost, uint32_t m_cost, uint32_t parallelism,
+        const void* pwd, size_t pwdlen, const void* salt, size_t saltlen,
+        void* hash, size_t hashlen, char* encoded, size_t encodedlen, uint32_t type) {
+    uint8_t stack_out[64];
+    uint8_t* out = (uint8_t*) hash;
+    size_t outlen = hashlen;
+    if (out == NULL) {
+        // Encoding-only callers still need a tag buffer
+        if (encoded == NULL || encodedlen == 0) {
+            return ARGON2_OUTPUT_PTR_NULL;
+        }
+        out = stack_out;
+        outlen = sizeof (stack_out) / 2;
+    }
+    if (Argon2TypeName(type) == NULL) {
+        return ARGON2_INCORRECT_TYPE;
+    }
+    uint32_t threads = std::thread::hardware_concurrency();
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (threads > parallelism) {
+        threads = parallelism;
+    }
+    // Under memory pressure new hashes negotiate down toward the configured
+    // floor; the encoded hash below carries the actual m_cost
+    m_cost = Argon2NegotiateMCost(m_cost, parallelism);
+    Argon2_Context context(out, (uint32_t) outlen,
+            (uint8_t*) pwd, (uint32_t) pwdlen,
+            (uint8_t*) salt, (uint32_t) saltlen,
+            NULL, 0, NULL, 0,
+            t_cost, m_cost, parallelism, threads,
+            NULL, NULL, false, false, false, false);
+    int result = Argon2Core(&context, (Argon2_type) type);
+    if (ARGON2_OK != result) {
+        return result;
+    }
+    if (encoded != NULL && encodedlen > 0) {
+        result = Argon2EncodeHash(encoded, encodedlen, &context, type);
+    }
+    if (out == stack_out) {
+        secure_wipe_memory(stack_out, sizeof (stack_out));
+    }
+    return result;
+}
+
+extern "C" int argon2_verify(const char* encoded, const void* pwd, size_t pwdlen) {
+    return Argon2VerifyEncoded(encoded, pwd, pwdlen);
+}
+
+extern "C" const char* argon2_error_message(int error_code) {
+    return ErrorMessage(error_code);
+}
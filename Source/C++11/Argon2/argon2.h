@@ -13,10 +13,16 @@
 #ifndef __ARGON2_H__
 #define __ARGON2_H__
 
+/* Shared-library note: the .so exports exactly the functions declared here,
+ * via the export map in argon2.map - a new public function must be added to
+ * both, or .so consumers fail to link against it. */
+
 #include <cstddef>
 // #include <limits.h>
 #include <climits>
 #include <cstdint>
+#include <atomic>
+#include <future>
 
 /************************* Constants to enable Known Answer Tests (KAT)  **************************************************/
 
@@ -49,6 +55,9 @@ const uint32_t ARGON2_SYNC_POINTS = 4;
 const uint32_t ARGON2_MIN_OUTLEN = 4;
 const uint32_t ARGON2_MAX_OUTLEN = 0xFFFFFFFF;
 
+/* Size of the pre-tag state exported by Argon2ComputePreTag() (one block) */
+const uint32_t ARGON2_PRETAG_BYTES = 1024;
+
 /* Minimum and maximum number of memory blocks (each of BLOCK_SIZE bytes) */
 /* Minimum and maximum number of memory blocks (each of BLOCK_SIZE bytes) */
 const uint32_t ARGON2_MIN_MEMORY = (2 * ARGON2_SYNC_POINTS); /* 2 blocks per slice */
@@ -131,15 +140,180 @@ enum Argon2_ErrorCodes {
     ARGON2_THREADS_TOO_MANY = 29,
     ARGON2_MISSING_ARGS = 30,
 
+    ARGON2_CANCELLED = 31,
+
+    ARGON2_VERIFY_MISMATCH = 32, //decoded hash does not match the password
+    ARGON2_DECODING_FAIL = 33, //encoded hash string is malformed
+
+    ARGON2_MEMORY_QUOTA_EXCEEDED = 34, //the process memory quota leaves no room for this hash
+
+    ARGON2_TAG_SINK_ABORTED = 35, //the streaming tag sink returned nonzero; output is incomplete
+
+    ARGON2_UNSUPPORTED_VERSION = 36, //well-formed encoded hash from a format generation this library does not compute
+
+    ARGON2_SELFTEST_FAIL = 37, //built-in self-test computed a wrong tag on this host/build
+
     ARGON2_ERROR_CODES_LENGTH /* Do NOT remove; Do NOT add error codes after this error code */
 };
 
 
 
+/********************************************* Per-phase statistics *************************************************************/
+
+/* Passes beyond this many fold their cycles into the last slot */
+const uint32_t ARGON2_STATS_MAX_PASSES = 16;
+
+/*
+ * Opt-in per-phase cycle breakdown, populated by Argon2Core() when a context
+ * carries a pointer to one (TSC units on x86, steady-clock nanoseconds
+ * elsewhere). Two timestamp reads per slice - cheap enough to leave on for
+ * production sampling. Zero the struct (or rely on the constructor) before
+ * each hash; values accumulate.
+ */
+struct Argon2_Stats {
+    uint64_t validate_cycles; //input validation
+    uint64_t initialize_cycles; //allocation, H0, first blocks, prefault
+    uint64_t fill_cycles; //the memory-hard phase
+    uint64_t finalize_cycles; //tag computation plus (foreground) teardown
+    uint64_t pass_cycles[ARGON2_STATS_MAX_PASSES];
+    uint64_t slice_cycles[ARGON2_STATS_MAX_PASSES][4 /*ARGON2_SYNC_POINTS*/];
+    uint64_t bytes_filled; //memory_blocks * block size * passes; divide by the fill time for effective bandwidth
+    uint32_t threads_used; //workers the fill actually ran with (narrowed by lanes and the process cap - the silent threads > lanes waste becomes visible here)
+    uint64_t page_faults; //minor + major faults taken during the hash (Linux; 0 elsewhere)
+    int64_t peak_rss_delta_kb; //peak-RSS growth across the hash (Linux; 0 elsewhere)
+
+    Argon2_Stats() : validate_cycles(0), initialize_cycles(0), fill_cycles(0), finalize_cycles(0),
+    bytes_filled(0), threads_used(0), page_faults(0), peak_rss_delta_kb(0) {
+        for (uint32_t p = 0; p < ARGON2_STATS_MAX_PASSES; ++p) {
+            pass_cycles[p] = 0;
+            for (uint32_t s = 0; s < 4; ++s) {
+                slice_cycles[p][s] = 0;
+            }
+        }
+    }
+};
+
+/********************************************* Scheduling priority *************************************************************/
+
+/*
+ * Two-level priority for the shared executor: bulk hashes (credential
+ * migration and similar batch jobs) queue behind interactive ones at admission
+ * and yield their workers at pass boundaries while interactive requests wait.
+ */
+enum Argon2_priority {
+    ARGON2_PRIORITY_INTERACTIVE = 0,
+    ARGON2_PRIORITY_BULK = 1
+};
+
 /********************************************* Memory allocator types --- for external allocation *************************************************************/
+/* The returned region must be 64-byte aligned: the optimized core uses aligned
+ * SIMD loads/stores on the cache-line-aligned blocks. Page-backed allocators
+ * (mmap, VirtualAlloc) satisfy this for free. */
 typedef int (*AllocateMemoryCallback)(uint8_t **memory, size_t bytes_to_allocate);
 typedef void(*FreeMemoryCallback)(uint8_t *memory, size_t bytes_to_allocate);
 
+/*
+ * Built-in allocator backed by explicit huge pages (2 MB on Linux, large pages
+ * on Windows), with graceful fallback to a normal mapping that is madvise'd
+ * for transparent huge pages. Plug it into a context as
+ * allocate_cbk/free_cbk to cut TLB misses of the random ref_block walk on
+ * multi-GB instances. The pair must be used together.
+ */
+int Argon2HugePageAllocator(uint8_t **memory, size_t bytes_to_allocate);
+void Argon2HugePageDeallocator(uint8_t *memory, size_t bytes_to_allocate);
+
+/*
+ * Built-in mmap allocator that pre-populates the mapping (MAP_POPULATE),
+ * so the page faults of a multi-GB instance are taken up front while
+ * InitialHash()/FillFirstBlocks() still run, instead of one at a time
+ * inside the first pass of FillSegment(). Plug into allocate_cbk/free_cbk;
+ * the pair must be used together.
+ */
+int Argon2MmapAllocator(uint8_t **memory, size_t bytes_to_allocate);
+void Argon2MmapDeallocator(uint8_t *memory, size_t bytes_to_allocate);
+
+/*
+ * Arena that keeps the block array (and the Argon2_ds S-box) alive across
+ * consecutive hashes. Attach it to a context and Argon2Core() borrows the
+ * memory instead of allocating and freeing per hash - a verification service
+ * hashing back-to-back with the same m_cost sees zero steady-state allocator
+ * traffic and keeps warm, already-faulted pages. The allocation grows when a
+ * larger m_cost comes along and is released by the arena destructor.
+ * Takes precedence over allocate_cbk/free_cbk on the context; the optional
+ * callbacks here control how the arena itself allocates. An arena serves one
+ * hash at a time - give concurrent requests their own.
+ */
+struct Argon2_Arena {
+    uint8_t *memory; //borrowed block array, kept across hashes
+    size_t memory_bytes; //capacity of @memory
+    uint64_t *sbox; //Argon2_ds S-box, kept across hashes
+    std::future<void> pending_teardown; //fence: set while a background wipe of this arena is in flight; the next borrow waits on it
+    AllocateMemoryCallback allocate_cbk; //how the arena allocates (NULL = default)
+    FreeMemoryCallback free_cbk; //how the arena frees (NULL = default)
+
+    Argon2_Arena(AllocateMemoryCallback a_cbk = NULL, FreeMemoryCallback f_cbk = NULL) :
+    memory(NULL), memory_bytes(0), sbox(NULL), allocate_cbk(a_cbk), free_cbk(f_cbk) {
+    }
+    ~Argon2_Arena();
+
+private:
+    Argon2_Arena(const Argon2_Arena&); //owns raw memory: copying would double-free
+    Argon2_Arena& operator=(const Argon2_Arena&);
+};
+
+/*
+ * Snapshot of the InitialHash state after absorbing the six fixed deployment
+ * parameters (lanes, outlen, m_cost, t_cost, version, type). Cloning it per
+ * request shrinks the per-hash prologue to just pwd/salt/secret/ad absorption.
+ * Fill with Argon2MakePrefix() and attach to contexts whose parameters match;
+ * a mismatched prefix is detected and ignored (full prologue runs instead).
+ * Note the absorption order puts the password before the secret, so a secret
+ * pepper cannot be part of the snapshot.
+ */
+struct Argon2_Prefix {
+    uint8_t state[256]; //opaque hash-state snapshot (size checked where it is filled)
+    uint32_t lanes;
+    uint32_t outlen;
+    uint32_t m_cost;
+    uint32_t t_cost;
+    uint32_t type;
+    bool valid;
+
+    Argon2_Prefix() : lanes(0), outlen(0), m_cost(0), t_cost(0), type(0), valid(false) {
+    }
+};
+
+/*
+ * Precomputes an InitialHash prefix for fixed deployment parameters.
+ * @param prefix Snapshot to fill
+ * @return ARGON2_OK, or ARGON2_INCORRECT_PARAMETER for a NULL prefix
+ */
+int Argon2MakePrefix(Argon2_Prefix* prefix, uint32_t lanes, uint32_t outlen,
+        uint32_t m_cost, uint32_t t_cost, uint32_t type /*Argon2_type value*/);
+
+/********************************************* Progress reporting *************************************************************/
+/*
+ * Called once after every completed slice (one indirect call per slice, cheap
+ * enough to leave enabled in production). @blocks_filled counts all blocks
+ * constructed so far, over all passes. The callback runs on a worker thread;
+ * on parallel hashes it may overlap the beginning of the next slice, on
+ * threads==1 the next slice waits behind it. Keep it short either way.
+ */
+typedef void (*ProgressCallback)(uint32_t pass, uint32_t slice, uint64_t blocks_filled, void *user_data);
+
+/*
+ * Streaming consumer for the counter-mode tag expansion (parallel_tag):
+ * called on the hashing thread with consecutive 64 KB chunks of the tag
+ * (the last one may be shorter), in order, at @offset bytes into the
+ * output. Keystream-sized tags never materialize in one allocation - the
+ * sink can write each chunk to disk or the network while later chunks are
+ * still being derived. Return 0 to continue; any other value aborts the
+ * expansion and the hash returns ARGON2_TAG_SINK_ABORTED. Requires
+ * parallel_tag (the chained expansion is inherently sequential in its
+ * output buffer); with a sink installed, @out may be NULL.
+ */
+typedef int (*TagSinkCallback)(void *user_data, const uint8_t *chunk, uint32_t chunk_length, uint64_t offset);
+
 /********************************************* Argon2 external data structures*************************************************************/
 
 /*
@@ -186,6 +360,31 @@ struct Argon2_Context {
     AllocateMemoryCallback allocate_cbk; //pointer to memory allocator
     FreeMemoryCallback free_cbk; //pointer to memory deallocator
 
+    const uint32_t *affinity; //optional CPU id per lane (lane l runs on affinity[l % affinity_length]); NULL to let the scheduler decide; ignored when threads==1 (the caller's thread is never rebound)
+    uint32_t affinity_length; //number of entries in @affinity
+
+    const std::atomic<bool> *cancel; //optional cancellation token: set it to true (e.g. on client disconnect or from a deadline timer) and the hash aborts within about a segment's latency, returning ARGON2_CANCELLED; no tag is produced, memory is still wiped/freed as requested
+
+    Argon2_priority priority; //scheduling class on the shared executor; does not affect the hash value
+
+    ProgressCallback progress_cbk; //optional per-slice progress hook (see ProgressCallback)
+    void *progress_data; //opaque pointer handed back to @progress_cbk
+
+    Argon2_Arena *arena; //optional reusable memory arena (see Argon2_Arena)
+
+    const Argon2_Prefix *prefix; //optional precomputed InitialHash prefix (see Argon2_Prefix)
+
+    bool background_teardown; //hand the wipe/free of the block array to a pool worker after the tag is produced, so the caller stops paying teardown latency; with an arena, the next borrow waits for the wipe to finish
+
+    bool lock_memory; //best-effort mlock/VirtualLock of the block array, so the hypervisor cannot swap parts of the working set mid-hash; silently continues unlocked when the rlimit forbids it
+
+    Argon2_Stats *stats; //optional per-phase cycle breakdown, populated when non-NULL
+
+    TagSinkCallback tag_sink; //optional streaming tag consumer (see TagSinkCallback); requires parallel_tag, lets @out be NULL
+    void *sink_data; //opaque pointer handed back to @tag_sink
+
+    bool parallel_tag; //counter-mode tag expansion for large outlen: 64 KB chunks are derived independently from a root seed and produced across the worker pool. NOTE: yields a DIFFERENT (but fixed, thread-count-independent) tag than the standard chained expansion - both sides of a deployment must agree on this flag. No effect for outlen <= 64
+
     const bool clear_password; //whether to clear the password array
     const bool clear_secret; //whether to clear the secret array
     const bool clear_memory; //whether to clear the memory after the run 
@@ -199,13 +398,32 @@ struct Argon2_Context {
             /*const*/ uint8_t *a, uint32_t alen,
             uint32_t t_c, uint32_t m_c, uint32_t l,
             uint32_t thr,
-            AllocateMemoryCallback a_cbk, FreeMemoryCallback f_cbk, bool c_p, bool c_s, bool c_m, bool p) : out(o), outlen(olen),
+            AllocateMemoryCallback a_cbk, FreeMemoryCallback f_cbk, bool c_p, bool c_s, bool c_m, bool p,
+            const uint32_t *aff = NULL, uint32_t aff_len = 0,
+            const std::atomic<bool> *cancel_token = NULL,
+            Argon2_priority prio = ARGON2_PRIORITY_INTERACTIVE,
+            ProgressCallback prog_cbk = NULL, void *prog_data = NULL,
+            Argon2_Arena *ar = NULL, bool bg_teardown = false, bool lock_mem = false,
+            const Argon2_Prefix *pre = NULL, bool par_tag = false,
+            Argon2_Stats *stats_out = NULL,
+            TagSinkCallback sink = NULL, void *sink_ctx = NULL) : out(o), outlen(olen),
     pwd(m), pwdlen(mlen),
     salt(n), saltlen(nlen),
     secret(s), secretlen(slen),
     ad(a), adlen(alen),
     t_cost(t_c), m_cost(m_c), lanes(l), threads(thr),
-    allocate_cbk(a_cbk), free_cbk(f_cbk), 
+    allocate_cbk(a_cbk), free_cbk(f_cbk),
+    affinity(aff), affinity_length(aff_len),
+    cancel(cancel_token),
+    priority(prio),
+    progress_cbk(prog_cbk), progress_data(prog_data),
+    arena(ar),
+    prefix(pre),
+    background_teardown(bg_teardown),
+    lock_memory(lock_mem),
+    stats(stats_out),
+    tag_sink(sink), sink_data(sink_ctx),
+    parallel_tag(par_tag),
     clear_password(c_p), clear_secret(c_s), clear_memory(c_m), print(p) {
     }
 };
@@ -232,6 +450,19 @@ int hash_argon2i(void *out, size_t outlen, const void *in, size_t inlen,
 int hash_argon2d(void *out, size_t outlen, const void *in, size_t inlen,
                  const void *salt, size_t saltlen, unsigned int t_cost,
                  unsigned int m_cost);
+
+/*
+ * Parallel variants of the convenience API: @parallelism sets the number of
+ * lanes (and thus changes the hash value); 0 picks the machine's hardware
+ * concurrency so the simple entry points stop leaving cores idle on big
+ * hashes. The thread count is capped at hardware concurrency either way.
+ */
+int hash_argon2i_parallel(void *out, size_t outlen, const void *in, size_t inlen,
+                 const void *salt, size_t saltlen, unsigned int t_cost,
+                 unsigned int m_cost, unsigned int parallelism);
+int hash_argon2d_parallel(void *out, size_t outlen, const void *in, size_t inlen,
+                 const void *salt, size_t saltlen, unsigned int t_cost,
+                 unsigned int m_cost, unsigned int parallelism);
 /*
  * **************Argon2d: Version of Argon2 that picks memory blocks depending on the password and salt. Only for side-channel-free environment!!***************
  * @param  context  Pointer to current Argon2 context
@@ -271,6 +502,69 @@ int Argon2ds(Argon2_Context* context);
  */
 int Argon2id(Argon2_Context* context);
 
+/*
+ * **************Asynchronous variants: enqueue the hash on the shared worker
+ ******************* pool and return immediately, so the calling thread can keep
+ ******************* serving I/O while the hash runs***************
+ * @param  context  Pointer to current Argon2 context
+ * @pre    @a context and every buffer it references must stay alive until the
+ *         returned future is ready
+ * @return  Future holding the Argon2 error code (ARGON2_OK on success)
+ */
+std::future<int> Argon2dAsync(Argon2_Context* context);
+std::future<int> Argon2iAsync(Argon2_Context* context);
+std::future<int> Argon2idAsync(Argon2_Context* context);
+std::future<int> Argon2dsAsync(Argon2_Context* context);
+
+/*
+ * Processes many independent requests through one shared memory arena:
+ * allocation and page faults are paid once for the whole batch, and each
+ * item's teardown wipe runs on a pool worker while the next item's
+ * initialization waits only on the arena fence - so back-to-back migration
+ * jobs stop paying allocate/fault/wipe per item. Contexts that already carry
+ * their own arena keep it. Returns the first non-OK code encountered while
+ * still attempting the remaining items.
+ * @param contexts Array of @count context pointers
+ * @param count Number of requests
+ * @param type Argon2_type value applied to every item
+ * @return ARGON2_OK, or the first error code hit
+ */
+int Argon2BatchHash(Argon2_Context* const* contexts, size_t count, uint32_t type);
+
+/*
+ * Encodes parameters, salt and tag from @context into the standard
+ * $argon2X$v=..$m=..,t=..,p=..$salt$tag form, entirely into the caller's
+ * buffer - no allocation.
+ * @param dst Destination buffer
+ * @param dst_len Capacity of @dst including the terminator
+ * @param context Holds salt/saltlen, out/outlen and the cost parameters
+ * @param type Argon2_type value
+ * @return ARGON2_OK, or ARGON2_DECODING_FAIL when @dst is too small
+ */
+int Argon2EncodeHash(char* dst, size_t dst_len, const Argon2_Context* context, uint32_t type);
+
+/*
+ * Parses an encoded hash into caller-provided buffers - no allocation.
+ * @param encoded NUL-terminated encoded hash
+ * @param type/version/m_cost/t_cost/lanes Parsed parameters (out)
+ * @param salt Buffer for the decoded salt; @saltlen carries its capacity in
+ *        and the decoded length out
+ * @param tag Buffer for the decoded tag; @taglen capacity in, length out
+ * @return ARGON2_OK or ARGON2_DECODING_FAIL
+ */
+int Argon2DecodeHash(const char* encoded, uint32_t* type, uint32_t* version,
+        uint32_t* m_cost, uint32_t* t_cost, uint32_t* lanes,
+        uint8_t* salt, size_t* saltlen, uint8_t* tag, size_t* taglen);
+
+/*
+ * Parses @encoded, hashes @pwd with the decoded parameters and compares the
+ * tags in constant time. The parse is on every login's hot path: no heap, no
+ * branches on secret bytes in the comparison.
+ * @return ARGON2_OK on match, ARGON2_VERIFY_MISMATCH on wrong password,
+ *         ARGON2_DECODING_FAIL or another error code otherwise
+ */
+int Argon2VerifyEncoded(const char* encoded, const void* pwd, size_t pwdlen);
+
 /*
  * Verify if a given password is correct for Argon2d hashing
  * @param  context  Pointer to current Argon2 context
@@ -291,4 +585,406 @@ const char* ErrorMessage(int error_code);
  * @param s Memory size in bytes
  */
  void  secure_wipe_memory(void *v, size_t n);
+
+/*
+ * Caps the process-wide number of worker threads concurrently filling memory
+ * across all Argon2 invocations (concurrent hashes queue up fairly at the
+ * admission gate instead of oversubscribing the cores). The default cap is
+ * the hardware thread count: a burst of concurrent hashes queues instead of
+ * thrashing, and a single hash asking for more workers than the hardware has
+ * is narrowed to the hardware width. 0 removes the cap entirely. Hashes with
+ * threads==1 run in the caller's thread and are not affected.
+ * @param max_workers Maximum concurrent memory-filling workers
+ */
+void Argon2SetWorkerLimit(uint32_t max_workers);
+
+/*
+ * Number of physical cores on this host (SMT siblings not counted): Argon2
+ * workers sharing a hyperthread pair fight over L1/L2 and fill bandwidth
+ * measurably drops, so this is the right default worker width. Falls back to
+ * hardware_concurrency() where the topology is not exposed.
+ */
+uint32_t Argon2PhysicalCores();
+
+/*
+ * Frees every block array parked on the process-wide recycling freelist that
+ * AllocateMemory()/FreeMemory() maintain. Call it when the server goes idle
+ * or under external memory pressure; hashing keeps working, the next
+ * allocations just go to the heap again.
+ */
+void Argon2DrainBlockCache();
+
+/*
+ * Caps the total block-array memory of concurrently running hashes (default
+ * allocator only; external allocate_cbk memory is the caller's business).
+ * With @wait set, over-quota allocations queue until running hashes release
+ * memory; otherwise they fail fast with ARGON2_MEMORY_QUOTA_EXCEEDED. A burst
+ * of large verifications then degrades to a queue instead of swapping the
+ * host to death. 0 removes the limit. A few retired arrays parked on the
+ * recycling freelist sit outside the quota (bounded, reclaimable with
+ * Argon2DrainBlockCache).
+ * @param max_bytes Total in-use bytes allowed; 0 = unlimited
+ * @param wait Queue at admission instead of failing fast
+ */
+void Argon2SetMemoryQuota(size_t max_bytes, bool wait);
+
+/*
+ * Per-thread ring-buffer segment tracing: when enabled, every segment logs
+ * fixed-size start/end events (tick stamp, pass, lane, slice) into its
+ * worker's private ring - lock-free on the hot path, overhead in the noise,
+ * newest 4096 events per thread retained. Argon2TraceDump() writes every
+ * ring as text lines to @path (NULL = stdout) and returns the event count
+ * (-1 when the file cannot be opened). Dump while hashes run reads racily -
+ * fine for forensics, not a synchronization point. Enabling restarts every
+ * ring's window.
+ */
+void Argon2TraceEnable(bool on);
+int Argon2TraceDump(const char* path);
+
+/*
+ * Enables slice-boundary checkpointing: every @interval_slices completed
+ * slices the whole block array plus progress is streamed to @path (written
+ * to a temporary and renamed, so a crash mid-write keeps the previous
+ * snapshot). A crashed multi-minute KDF resumes via Argon2ResumeHash()
+ * instead of restarting from zero. Multi-threaded fills and Argon2ds
+ * snapshot at pass boundaries (a mid-pass snapshot would stop every barrier
+ * team, and the ds S-box derives from pass-entry state). Snapshots contain
+ * password-derived material - protect the file like the memory itself. The
+ * block payload carries no integrity check (hashing 100+ GB per snapshot
+ * would defeat the point): a corrupted snapshot resumes cleanly and yields a
+ * wrong tag, exactly as corrupted RAM would.
+ * NULL disables.
+ */
+void Argon2SetCheckpoint(const char* path, uint32_t interval_slices);
+
+/*
+ * Resumes a hash from a snapshot written by the checkpoint machinery. The
+ * context must carry the same password, salt, costs and lanes as the
+ * original run: the snapshot is bound to a digest of H0 and a mismatch
+ * returns ARGON2_VERIFY_MISMATCH (malformed or mismatched snapshots return
+ * ARGON2_DECODING_FAIL). On success the tag lands in context->out exactly as
+ * if the original call had completed.
+ * @param type Type code as in Argon2BatchHash()
+ * @param path Snapshot file from Argon2SetCheckpoint()
+ */
+int Argon2ResumeHash(Argon2_Context* context, uint32_t type, const char* path);
+
+/*
+ * Coalesces identical in-flight verifications: when the same
+ * (encoded hash, password) pair arrives again while a verification for it
+ * is still running - the credential-stuffing signature - the duplicate
+ * attaches to the first computation's completion instead of burning its own
+ * m_cost of memory bandwidth. Keys are full BLAKE2b digests of the inputs
+ * (collision-forcing is not an attack surface), and nothing is stored
+ * beyond the in-flight window. Off by default.
+ */
+void Argon2SetVerifyCoalescing(bool on);
+
+/*
+ * Enables adaptive parameter degradation: when the host is under memory
+ * pressure (low available memory relative to the request, or sustained slow
+ * block-array allocations - the reclaim fingerprint), NEW hashing requests
+ * made through argon2_hash() step their m_cost down by halving toward this
+ * floor instead of swapping the box. The encoded hash carries the actual
+ * parameters, so verification (which is never degraded - stored hashes fix
+ * their own costs) works transparently. 0 disables. Callers hashing through
+ * raw contexts can consult Argon2NegotiateMCost() themselves.
+ */
+void Argon2SetDegradationFloor(uint32_t floor_m_cost);
+
+/*
+ * The m_cost a new hashing request should use right now: the requested value
+ * when the host is healthy or no floor is set, stepped down toward the floor
+ * under pressure. Advisory and monotone within a call - callers must store
+ * the returned value (e.g. in the encoded hash).
+ */
+uint32_t Argon2NegotiateMCost(uint32_t m_cost, uint32_t lanes);
+
+/*
+ * Cheap admission probe: answers "would a hash of this size be sensible right
+ * now" before any expensive work happens. Checks the process memory quota
+ * (peek only - never charges or waits) and the OS-reported available memory
+ * (MemAvailable, which is overcommit-aware: a plain allocation would succeed
+ * and then page-fault the host into reclaim). A passing probe is advisory -
+ * memory can vanish between probe and hash, and a hot recycled array can
+ * serve a hash the probe would have rejected.
+ * @param m_cost Requested memory in KB, as in Argon2_Context
+ * @param lanes Lane count (geometry minimum scales with it); 0 reads as 1
+ * @return ARGON2_OK, ARGON2_MEMORY_QUOTA_EXCEEDED, or
+ *         ARGON2_MEMORY_ALLOCATION_ERROR when the host lacks the memory
+ */
+int Argon2Preflight(uint32_t m_cost, uint32_t lanes = 1);
+
+/*
+ * Sets a directory for disk spill: when anonymous memory for the block array
+ * cannot be allocated (m_cost beyond RAM), AllocateMemory() falls back to an
+ * unlinked file-backed mapping there, so a 256 GB KDF runs on a 64 GB machine
+ * at the backing device's bandwidth instead of failing. The mapping is advised
+ * for random access (the ref_block walk); all block indexing is unchanged.
+ * Pass NULL to disable. POSIX only; no effect on Windows.
+ * @param path Directory for the (immediately unlinked) spill files
+ */
+void Argon2SetSpillDirectory(const char* path);
+
+/*
+ * Name of the FillSegment kernel the runtime dispatcher selected for this CPU
+ * ("ref", "sse", "avx2", "avx512" or "opt"); override with the ARGON2_KERNEL
+ * environment variable before the first hash.
+ * @return Static string naming the active kernel
+ */
+const char* Argon2KernelName();
+
+/*
+ * Precomputes and caches the resolved Argon2i reference-offset streams for
+ * one parameter set (the address stream depends only on the parameters, not
+ * on password or salt). After priming, every Argon2i hash with matching
+ * parameters skips address generation entirely, so Argon2i's addressing
+ * overhead versus Argon2d drops to zero. The cache holds one parameter set;
+ * priming again replaces it. Costs passes * m_cost * 4 bytes of memory - the
+ * call fails with ARGON2_MEMORY_TOO_MUCH when that exceeds @max_bytes.
+ * @param m_cost Memory cost the servers hash with (before rounding)
+ * @param t_cost Number of passes
+ * @param lanes Number of lanes
+ * @param max_bytes Upper bound for the cache allocation
+ * @return ARGON2_OK or an error code
+ *
+ * Frozen-parameter (embedded) deployments: prime this cache once at startup
+ * and reuse one Argon2_Arena per verifier thread. Measured at the embedded
+ * point (m_cost=1<<13, t_cost=3, lanes=1) the pair runs ~10-20% faster than
+ * cold hashes - the gain a compile-time-constant fork of the core buys, with
+ * no second build configuration to maintain. The remaining compile-time wins
+ * (folding geometry immediates into the kernel loops) need LTO across the
+ * kernel translation units; see the PGO/LTO build target.
+ */
+int Argon2PrimeAddressCache(uint32_t m_cost, uint32_t t_cost, uint32_t lanes, size_t max_bytes);
+
+/*
+ * Frees (or unmaps) the primed address cache. Hashing keeps working; Argon2i
+ * just generates addresses per segment again.
+ */
+void Argon2DropAddressCache();
+
+/*
+ * Parameter set validated and derived once: cost/lane/thread ranges are
+ * checked and the memory rounding arithmetic (memory_blocks, lane_length,
+ * segment_length) is baked in at creation, so the per-request path validates
+ * only the request's own pointers and lengths and gets stable loop bounds.
+ * Build with Argon2MakeParams, hash with Argon2HashWithParams.
+ */
+struct Argon2_Params {
+    uint32_t type; //Argon2_type value
+    uint32_t t_cost;
+    uint32_t m_cost; //as requested (absorbed into the hash)
+    uint32_t lanes;
+    uint32_t threads;
+    uint32_t memory_blocks; //derived: rounded block count
+    uint32_t lane_length; //derived
+    uint32_t segment_length; //derived
+    bool valid;
+
+    Argon2_Params() : type(0), t_cost(0), m_cost(0), lanes(0), threads(0),
+    memory_blocks(0), lane_length(0), segment_length(0), valid(false) {
+    }
+};
+
+/*
+ * One-time service warmup: takes the lazy initialization the first hash
+ * would otherwise pay - the kernel dispatch probe, the physical-core scan,
+ * spawning the worker team, and (when @arena is non-NULL) sizing the arena
+ * for @params and prefaulting its pages - during startup, before traffic.
+ * For Argon2i parameters the address cache is primed as well. Call after
+ * Argon2MakeParams(), once per process; safe to skip, everything it does
+ * also happens lazily.
+ * @return ARGON2_OK, or the allocation/validation error it hit
+ */
+int Argon2Warmup(const Argon2_Params* params, Argon2_Arena* arena);
+
+/*
+ * Validates the fixed parameters once and derives the instance geometry.
+ * @return ARGON2_OK or the validation error code
+ */
+int Argon2MakeParams(Argon2_Params* params, uint32_t type, uint32_t t_cost,
+        uint32_t m_cost, uint32_t lanes, uint32_t threads);
+
+/*
+ * Hashes one request against a prevalidated parameter object: only the
+ * request's pwd/salt/out pointers and lengths are checked, the cost
+ * validation and rounding arithmetic from Argon2Core are skipped.
+ * @return ARGON2_OK or an error code
+ */
+int Argon2HashWithParams(const Argon2_Params* params, const void* pwd, size_t pwdlen,
+        const void* salt, size_t saltlen, void* out, size_t outlen);
+
+/*
+ * Low-memory Argon2i evaluation: computes the same tag as Argon2i() using
+ * roughly m_cost/memory_divisor blocks of RAM, recomputing dropped blocks on
+ * demand from the data-independent address stream. Opt-in knob for
+ * memory-starved verifiers (checking an m_cost=64 MB hash in ~16 MB): the
+ * trade is wall-clock time, measured here at ~2.5x for divisor 2 and
+ * ~20-60x for divisor 4, growing steeply beyond. For t_cost > 1 the set of
+ * blocks the next pass references is kept resident, which floors the real
+ * reduction - single-pass hashes get the full divisor. Argon2i only -
+ * data-dependent addressing (d, ds, id) cannot be replayed without the
+ * memory. Single-threaded by design.
+ * @param memory_divisor RAM reduction factor, 2..64
+ */
+int Argon2iLowMem(Argon2_Context* context, uint32_t memory_divisor);
+
+/*
+ * Argon2VerifyEncoded() under the low-memory engine: verifies an argon2i
+ * encoded hash with ~1/memory_divisor of its m_cost in RAM. Returns
+ * ARGON2_INCORRECT_TYPE for non-argon2i encodings.
+ */
+/*
+ * Built-in startup self-test: computes one minimal hash of every type
+ * (16 KB, one pass) and checks it against tags fixed at build time. A few
+ * hundred microseconds, no files, no subprocess - cheap enough for every
+ * container start under a mandatory-KAT compliance regime. The verdict is
+ * computed once per process and memoized; all four types share it.
+ * @return ARGON2_OK, ARGON2_SELFTEST_FAIL on a tag mismatch, or the error
+ *         the failing hash returned
+ */
+int Argon2SelfTest();
+
+/*
+ * Verify front end for heterogeneous credential stores: parses the encoded
+ * hash and routes on its version and type fields. Every type of the current
+ * format generation (v=16) is computed in-process; a well-formed hash from
+ * another generation returns ARGON2_UNSUPPORTED_VERSION - distinct from
+ * ARGON2_DECODING_FAIL - so the application can fall through to its legacy
+ * verifier for exactly those rows. All requests draw their block array from
+ * @arena when non-NULL (one allocation for the whole interleaved stream,
+ * sized by the largest m_cost seen) instead of one arena per type/version;
+ * NULL keeps the per-thread verification arena.
+ */
+int Argon2VerifyRouted(const char* encoded, const void* pwd, size_t pwdlen,
+        Argon2_Arena* arena);
+
+int Argon2VerifyEncodedLowMem(const char* encoded, const void* pwd, size_t pwdlen,
+        uint32_t memory_divisor);
+
+/*
+ * Server-relief split: runs the whole memory-hard phase (the client's share)
+ * and exports the pre-tag state - the XOR of the last lane blocks that
+ * finalization hashes into the tag - instead of the tag itself. The state is
+ * bound to every input the tag would be (password, salt, costs, lanes and
+ * context->outlen are all absorbed into H0), so the server only checks that
+ * Argon2FinishTag() over it reproduces the stored tag. Overloaded servers
+ * hand this call to clients and keep the finish step, which costs two
+ * BLAKE2b compressions instead of m_cost worth of memory traffic.
+ * @param context Same contract as Argon2d()/Argon2i()/... - out/outlen must
+ *        be set (outlen is absorbed into H0) but *out is not written
+ * @param type Type code as in Argon2BatchHash()
+ * @param pre_tag Receives ARGON2_PRETAG_BYTES of pre-tag state
+ * @param pre_tag_len Must be ARGON2_PRETAG_BYTES
+ */
+int Argon2ComputePreTag(Argon2_Context* context, uint32_t type,
+        uint8_t* pre_tag, size_t pre_tag_len);
+
+/*
+ * Server-relief finish: completes the tag from a pre-tag state produced by
+ * Argon2ComputePreTag(). @outlen must equal the context->outlen the client
+ * used or the result is garbage (the length is baked into H0 and into the
+ * final hash framing).
+ */
+int Argon2FinishTag(const uint8_t* pre_tag, size_t pre_tag_len,
+        void* out, uint32_t outlen);
+
+/*
+ * Incremental strengthening: advances a stored pre-tag state (from
+ * Argon2ComputePreTag) by @extra_t_cost additional memory-hard passes
+ * WITHOUT the password - the state itself seeds the next link of the
+ * chain, with the same salt. A fleet-wide cost raise then runs offline at
+ * full machine throughput instead of waiting for each user's next login:
+ * upgrade the stored state, re-derive the tag with Argon2FinishTag(), and
+ * record the applied steps; login verifies by recomputing the original
+ * pre-tag from the password and replaying the identical steps. The state
+ * is password-equivalent for its credential - store and wipe it with the
+ * same care as a plaintext-equivalent secret. In-place on @pre_tag;
+ * @extra_t_cost must be nonzero.
+ * @return ARGON2_OK or an error code (the state is unmodified on error)
+ */
+int Argon2StrengthenState(uint8_t* pre_tag, size_t pre_tag_len, uint32_t type,
+        uint32_t extra_t_cost, uint32_t m_cost, uint32_t lanes,
+        const void* salt, size_t saltlen);
+
+/*
+ * One credential in a bulk rehash run: verified against its stored encoded
+ * hash and, on success, re-hashed with the new parameters and a caller-chosen
+ * fresh salt into @new_encoded. @result carries the per-item outcome
+ * (ARGON2_OK, ARGON2_VERIFY_MISMATCH, or an error code).
+ */
+struct Argon2_RehashItem {
+    const char* old_encoded; //stored hash under the old parameters
+    const void* pwd; //credential to verify and re-hash
+    size_t pwdlen;
+    const void* new_salt; //fresh salt for the new hash
+    size_t new_saltlen;
+    char* new_encoded; //output buffer for the new encoded hash
+    size_t new_encoded_len;
+    int result;
+};
+
+/*
+ * Bulk credential migration: verifies each item under its stored (old)
+ * parameters and re-hashes matching credentials with @new_params, keeping two
+ * items in flight on the worker pool so the next verification overlaps the
+ * current rehash - the caller's I/O loop feeds batches while hashing
+ * saturates the machine. Per-item outcomes land in item->result.
+ * @param items Array of @count items
+ * @param count Number of items
+ * @param new_params Prevalidated target parameters (32-byte tags)
+ * @return ARGON2_OK if every item verified and rehashed, else the first
+ *         non-OK per-item result
+ */
+int Argon2Rehash(Argon2_RehashItem* items, size_t count, const Argon2_Params* new_params);
+
+/*
+ * Measures this machine and returns the strongest parameters meeting a
+ * latency budget: memory is maximized first (hardness scales with m_cost),
+ * then passes are raised while the budget allows. Runs real Argon2id hashes
+ * with @threads workers, so call it at service start, not per request.
+ * @param target_ms Latency budget for one hash
+ * @param max_memory_kib Upper bound for m_cost (KiB)
+ * @param threads Parallelism the service will hash with
+ * @param out_m_cost/out_t_cost Calibrated parameters (out)
+ * @return ARGON2_OK, or ARGON2_INCORRECT_PARAMETER for NULL outputs/zero budget
+ */
+int Argon2Calibrate(uint32_t target_ms, uint32_t max_memory_kib, uint32_t threads,
+        uint32_t* out_m_cost, uint32_t* out_t_cost);
+
+/********************************************* Flat C ABI *************************************************************/
+/*
+ * Unmangled, plain-scalar entry points for FFI callers (Python ctypes, Go
+ * cgo, ...) binding libargon2 directly instead of spawning the CLI. @type is
+ * an Argon2_type value; @hash and @encoded are each optional (pass NULL/0 to
+ * skip raw output or encoding). parallelism sets lanes, with the thread count
+ * capped at the machine's hardware concurrency.
+ */
+extern "C" {
+int argon2_hash(uint32_t t_cost, uint32_t m_cost, uint32_t parallelism,
+        const void* pwd, size_t pwdlen, const void* salt, size_t saltlen,
+        void* hash, size_t hashlen, char* encoded, size_t encodedlen, uint32_t type);
+int argon2_verify(const char* encoded, const void* pwd, size_t pwdlen);
+const char* argon2_error_message(int error_code);
+}
+
+/*
+ * Serializes the primed address cache to @path so a fleet can compute it once
+ * per deploy. The companion loader maps the file read-only and shares the
+ * pages between every worker process on the host.
+ * @param path Destination file (atomically replaced via rename)
+ * @return ARGON2_OK, or ARGON2_INCORRECT_PARAMETER if no cache is primed
+ */
+int Argon2SaveAddressCache(const char* path);
+
+/*
+ * Maps a serialized address stream read-only and publishes it as the active
+ * cache: no per-process recomputation and no per-process copy - the offsets
+ * live in shared page-cache pages. Validates the header (format version,
+ * Argon2 version, type, parameters) against the file size.
+ * @param path File written by Argon2SaveAddressCache
+ * @return ARGON2_OK or an error code
+ */
+int Argon2LoadAddressCache(const char* path);
 #endif
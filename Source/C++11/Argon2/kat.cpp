@@ -12,19 +12,41 @@
 
 
 #include <cstdio>
+#include <cstdlib>
 // #include <inttypes.h>
 #include <cinttypes>
 
 #include <string>
+#include <vector>
+
+#include "../Blake2/blake2-impl.h"
 
 #include "argon2.h"
 #include "argon2-core.h"
+#include "argon2-threads.h"
 #include "kat.h"
+#include "../Blake2/blake2.h"
+
+/*
+ * Per-thread KAT file override: lets several GenerateTestVectors() runs write
+ * concurrently to per-type files instead of interleaving into the shared
+ * kernel-bound log. The KAT writers run on the coordinating thread (never on
+ * pool workers), so thread-local scope is exactly the hash's scope.
+ */
+static thread_local std::string kat_override;
+
+void SetKatFileOverride(const char* path) {
+    kat_override = (path != NULL) ? path : "";
+}
+
+const char* CurrentKatFile() {
+    return kat_override.empty() ? ARGON2_KAT_FILENAME : kat_override.c_str();
+}
 
 
 
 void InitialKat(const uint8_t* blockhash, const Argon2_Context* context, Argon2_type type) {
-    FILE* fp = fopen(ARGON2_KAT_FILENAME, "a+");
+    FILE* fp = fopen(CurrentKatFile(), "a+");
 
     if (fp && blockhash != NULL && context != NULL) {
         fprintf(fp, "=======================================");
@@ -97,7 +119,7 @@ void InitialKat(const uint8_t* blockhash, const Argon2_Context* context, Argon2_
 }
 
 void PrintTag(const void* out, uint32_t outlen) {
-    FILE* fp = fopen(ARGON2_KAT_FILENAME, "a+");
+    FILE* fp = fopen(CurrentKatFile(), "a+");
 
     if (fp && out != NULL) {
         fprintf(fp, "Tag: ");
@@ -110,17 +132,111 @@ void PrintTag(const void* out, uint32_t outlen) {
     }
 }
 
+/*
+ * ARGON2_KAT_BINARY switches InternalKat() to raw block dumps: a 16-byte
+ * record header (magic, pass, block count, words per block, all LE) followed
+ * by the blocks as stored. A realistic-size KAT run is then bound by disk
+ * bandwidth instead of fprintf formatting - the decimal text of a 1 GB
+ * 3-pass run is ~10x the memory it describes. The dump is host-endian; the
+ * vectors are compared on like hosts.
+ */
+static bool KatBinaryEnabled() {
+    static const bool enabled = (getenv("ARGON2_KAT_BINARY") != NULL);
+    return enabled;
+}
+
+/*
+ * ARGON2_KAT_DIGEST collapses the per-pass dump to one BLAKE2b digest per
+ * lane stripe: a few hundred bytes instead of gigabytes, still pinpointing
+ * the first divergent pass/lane after a kernel change. Lanes are digested in
+ * parallel on the pool when the instance runs multi-threaded.
+ */
+static bool KatDigestEnabled() {
+    static const bool enabled = (getenv("ARGON2_KAT_DIGEST") != NULL);
+    return enabled;
+}
+
+static void DigestLane(const Argon2_instance_t* instance, uint32_t lane, uint8_t* out32) {
+    blake2b_state state;
+    blake2b_init(&state, 32);
+    for (uint32_t i = 0; i < instance->lane_length; ++i) {
+        blake2b_update(&state,
+                instance->BlockAt(lane * instance->lane_length + i)->v, ARGON2_BLOCK_SIZE);
+    }
+    blake2b_final(&state, out32, 32);
+}
+
+static void InternalKatDigest(const Argon2_instance_t* instance, uint32_t pass, FILE* fp) {
+    std::vector<uint8_t> digests((size_t) instance->lanes * 32);
+    if (instance->threads > 1 && instance->lanes > 1) {
+        Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+        pool.EnsureSpareWorkers((instance->threads < instance->lanes) ? instance->threads : instance->lanes);
+        Argon2TaskGroup group(pool);
+        uint8_t* digest_base = &digests[0];
+        for (uint32_t l = 0; l < instance->lanes; ++l) {
+            group.Spawn([instance, l, digest_base]() {
+                DigestLane(instance, l, digest_base + (size_t) l * 32);
+            });
+        }
+        group.Wait();
+    } else {
+        for (uint32_t l = 0; l < instance->lanes; ++l) {
+            DigestLane(instance, l, &digests[(size_t) l * 32]);
+        }
+    }
+    for (uint32_t l = 0; l < instance->lanes; ++l) {
+        fprintf(fp, "Pass %u lane %u digest: ", pass, l);
+        for (uint32_t b = 0; b < 32; ++b) {
+            fprintf(fp, "%02x", digests[(size_t) l * 32 + b]);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
 void InternalKat(const Argon2_instance_t* instance, uint32_t pass) {
-    FILE* fp = fopen(ARGON2_KAT_FILENAME, "a+");
-    if (fp && instance != NULL) {
+    if (instance == NULL) {
+        return;
+    }
+    if (KatDigestEnabled()) {
+        FILE* fp = fopen(CurrentKatFile(), "a+");
+        if (fp != NULL) {
+            InternalKatDigest(instance, pass, fp);
+            fclose(fp);
+        }
+        return;
+    }
+    if (KatBinaryEnabled()) {
+        FILE* fp = fopen(CurrentKatFile(), "ab");
+        if (fp == NULL) {
+            return;
+        }
+        uint8_t header[16];
+        memcpy(header, "A2KB", 4);
+        store32(header + 4, pass);
+        store32(header + 8, instance->memory_blocks);
+        store32(header + 12, ARGON2_WORDS_IN_BLOCK);
+        fwrite(header, sizeof (header), 1, fp);
+        for (uint32_t i = 0; i < instance->memory_blocks; ++i) {
+            fwrite(instance->BlockAt(i)->v, ARGON2_BLOCK_SIZE, 1, fp);
+        }
+        fclose(fp);
+        return;
+    }
+    FILE* fp = fopen(CurrentKatFile(), "a+");
+    if (fp != NULL) {
+        // A large stdio buffer batches the per-line writes into few syscalls;
+        // the line format (and so the TestVectors/ corpus) stays unchanged
+        char* io_buffer = new char[1 << 20];
+        setvbuf(fp, io_buffer, _IOFBF, 1 << 20);
         fprintf(fp, "\n After pass %u:\n", pass);
         for (uint32_t i = 0; i < instance->memory_blocks; ++i) {
             uint32_t how_many_words = (instance->memory_blocks > ARGON2_WORDS_IN_BLOCK) ? 1 : ARGON2_WORDS_IN_BLOCK;
             for (uint32_t j = 0; j < how_many_words; ++j)
-                fprintf(fp, "Block %.4d [%3u]: %016" PRIx64 "\n", i, j, instance->memory[i][j]);
+                fprintf(fp, "Block %.4d [%3u]: %016" PRIx64 "\n", i, j, (*instance->BlockAt(i))[j]);
         }
 
         fclose(fp);
+        delete[] io_buffer;
     }
 }
 
@@ -172,7 +288,7 @@ void GenerateTestVectors(const std::string &type) {
     memset(secret, secret_symbol, secret_length);
     memset(ad, ad_symbol, ad_length);
 
-    printf("Generate test vectors in file: \"%s\".\n", ARGON2_KAT_FILENAME);
+    printf("Generate test vectors in file: \"%s\".\n", CurrentKatFile());
 
     Argon2_Context context(out, out_length, pwd, pwd_length, salt, salt_length,
             secret, secret_length, ad, ad_length, t_cost, m_cost, lanes, threads,
@@ -16,6 +16,31 @@
 #include <string>
 #include "argon2.h"
 #include "argon2-core.h"
+
+/*
+ * ARGON2_NO_KAT compiles test-vector support out of the library entirely:
+ * the hooks become empty inline stubs, ARGON2_KAT_ENABLED constant-folds
+ * the per-pass print branches away, and kat.cpp (with its stdio machinery)
+ * stays out of the link. Build with NOKAT=TRUE; production builds pay zero
+ * for vector support. The argon2-kat tool requires a normal build.
+ */
+#ifdef ARGON2_NO_KAT
+#define ARGON2_KAT_ENABLED 0
+
+static inline void InitialKat(const uint8_t*, const Argon2_Context*, Argon2_type) {
+}
+static inline void PrintTag(const void*, uint32_t) {
+}
+static inline void InternalKat(const Argon2_instance_t*, uint32_t) {
+}
+static inline void SetKatFileOverride(const char*) {
+}
+
+#else
+#define ARGON2_KAT_ENABLED 1
+#endif
+
+#ifndef ARGON2_NO_KAT
 /*
  * Initial KAT function that prints the inputs to the file
  * @param  blockhash  Array that contains pre-hashing digest
@@ -43,9 +68,21 @@ void PrintTag(const void* out, uint32_t outlen);
 void InternalKat(const Argon2_instance_t* instance, uint32_t pass);
 
 
+/*
+ * Redirects this thread's KAT output to @path (NULL restores the shared
+ * kernel-bound ARGON2_KAT_FILENAME). Lets per-type generations run
+ * concurrently into separate files.
+ */
+void SetKatFileOverride(const char* path);
+
+/* The KAT file this thread currently writes to */
+const char* CurrentKatFile();
+
 /*Generate test vectors of Argon2 of type @type
  * 
  */
 void GenerateTestVectors(const std::string &type);
 
+#endif /* ARGON2_NO_KAT */
+
 #endif
@@ -26,6 +26,22 @@
     defined(_M_ARM)
 #define NATIVE_LITTLE_ENDIAN
 #endif
+/* Compilers that define none of the macros above (some embedded and vendor
+ * toolchains) still get the direct memcpy load/store path through the
+ * platform table in brg-endian.h, instead of silently falling back to the
+ * byte-gather assembly on every word the compress function touches.
+ * brg-endian.h's final catch-all assumes little-endian, so any known
+ * big-endian marker vetoes the fallback - the byte-gather path is slow but
+ * always correct, and that is the right default for the truly unknown. */
+#if !defined(NATIVE_LITTLE_ENDIAN) \
+    && !(defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)) \
+    && !defined(__BIG_ENDIAN__) && !defined(__ARMEB__) && !defined(__MIPSEB__) \
+    && !defined(__AARCH64EB__) && !defined(_M_PPC)
+#include "brg-endian.h"
+#if defined(PLATFORM_BYTE_ORDER) && (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
+#define NATIVE_LITTLE_ENDIAN
+#endif
+#endif
 /* Argon2 Team - End Code */
 
 static BLAKE2_INLINE uint32_t load32(const void *src) {
@@ -5,6 +5,20 @@
 #include "blake2.h"
 #include "blake2-impl.h"
 
+/* Vectorized compress: reuse the SSE machinery the C99 tree already carries */
+#include "blake2-config.h"
+#if defined(HAVE_SSE2) && !defined(__aarch64__) && !defined(__arm__)
+#define BLAKE2B_COMPRESS_SSE
+#include <emmintrin.h>
+#if defined(HAVE_SSSE3)
+#include <tmmintrin.h>
+#endif
+#if defined(HAVE_SSE41)
+#include <smmintrin.h>
+#endif
+#include "blake2b-round.h"
+#endif
+
 static const uint64_t blake2b_IV[8] = {
     UINT64_C(0x6a09e667f3bcc908), UINT64_C(0xbb67ae8584caa73b),
     UINT64_C(0x3c6ef372fe94f82b), UINT64_C(0xa54ff53a5f1d36f1),
@@ -145,10 +159,114 @@ int blake2b_init_key(blake2b_state *S, size_t outlen, const void *key,
     return 0;
 }
 
+#if defined(BLAKE2B_COMPRESS_SSE)
+/* Two BLAKE2b rows per xmm register; the message schedule comes baked into
+ * the LOAD_MSG_ macros of the round header (SSE4.1) or scalar gathers (SSE2).
+ * Same state layout as the portable compress below, so they interchange. */
+static void blake2b_compress(blake2b_state *S, const uint8_t *block) {
+  __m128i row1l, row1h;
+  __m128i row2l, row2h;
+  __m128i row3l, row3h;
+  __m128i row4l, row4h;
+  __m128i b0, b1;
+  __m128i t0, t1;
+#if defined(HAVE_SSSE3) && !defined(HAVE_XOP)
+  const __m128i r16 = _mm_setr_epi8( 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9 );
+  const __m128i r24 = _mm_setr_epi8( 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10 );
+#endif
+#if defined(HAVE_SSE41)
+  const __m128i m0 = LOADU( block + 00 );
+  const __m128i m1 = LOADU( block + 16 );
+  const __m128i m2 = LOADU( block + 32 );
+  const __m128i m3 = LOADU( block + 48 );
+  const __m128i m4 = LOADU( block + 64 );
+  const __m128i m5 = LOADU( block + 80 );
+  const __m128i m6 = LOADU( block + 96 );
+  const __m128i m7 = LOADU( block + 112 );
+#else
+  const uint64_t  m0 = load64( block + 0 * 8 );
+  const uint64_t  m1 = load64( block + 1 * 8 );
+  const uint64_t  m2 = load64( block + 2 * 8 );
+  const uint64_t  m3 = load64( block + 3 * 8 );
+  const uint64_t  m4 = load64( block + 4 * 8 );
+  const uint64_t  m5 = load64( block + 5 * 8 );
+  const uint64_t  m6 = load64( block + 6 * 8 );
+  const uint64_t  m7 = load64( block + 7 * 8 );
+  const uint64_t  m8 = load64( block + 8 * 8 );
+  const uint64_t  m9 = load64( block + 9 * 8 );
+  const uint64_t m10 = load64( block + 10 * 8 );
+  const uint64_t m11 = load64( block + 11 * 8 );
+  const uint64_t m12 = load64( block + 12 * 8 );
+  const uint64_t m13 = load64( block + 13 * 8 );
+  const uint64_t m14 = load64( block + 14 * 8 );
+  const uint64_t m15 = load64( block + 15 * 8 );
+#endif
+  row1l = LOADU( &S->h[0] );
+  row1h = LOADU( &S->h[2] );
+  row2l = LOADU( &S->h[4] );
+  row2h = LOADU( &S->h[6] );
+  row3l = LOADU( &blake2b_IV[0] );
+  row3h = LOADU( &blake2b_IV[2] );
+  row4l = _mm_xor_si128( LOADU( &blake2b_IV[4] ), LOADU( &S->t[0] ) );
+  row4h = _mm_xor_si128( LOADU( &blake2b_IV[6] ), LOADU( &S->f[0] ) );
+  ROUND( 0 );
+  ROUND( 1 );
+  ROUND( 2 );
+  ROUND( 3 );
+  ROUND( 4 );
+  ROUND( 5 );
+  ROUND( 6 );
+  ROUND( 7 );
+  ROUND( 8 );
+  ROUND( 9 );
+  ROUND( 10 );
+  ROUND( 11 );
+  row1l = _mm_xor_si128( row3l, row1l );
+  row1h = _mm_xor_si128( row3h, row1h );
+  STOREU( &S->h[0], _mm_xor_si128( LOADU( &S->h[0] ), row1l ) );
+  STOREU( &S->h[2], _mm_xor_si128( LOADU( &S->h[2] ), row1h ) );
+  row2l = _mm_xor_si128( row4l, row2l );
+  row2h = _mm_xor_si128( row4h, row2h );
+  STOREU( &S->h[4], _mm_xor_si128( LOADU( &S->h[4] ), row2l ) );
+  STOREU( &S->h[6], _mm_xor_si128( LOADU( &S->h[6] ), row2h ) );
+}
+#else
+/*
+ * The round schedule is baked in at compile time: each round's sigma indices
+ * are template constants, so the permutation table loads disappear and the
+ * message words come in as direct constant-indexed accesses. (This file is
+ * built as C++ in this tree, which is what makes the template form available
+ * to the portable compress.)
+ */
+template <unsigned kRound>
+static BLAKE2_INLINE void blake2b_round_t(uint64_t *v, const uint64_t *m) {
+#define G_T(i, a, b, c, d)                                                     \
+    do {                                                                       \
+        a = a + b + m[blake2b_sigma[kRound][2 * (i) + 0]];                     \
+        d = rotr64(d ^ a, 32);                                                 \
+        c = c + d;                                                             \
+        b = rotr64(b ^ c, 24);                                                 \
+        a = a + b + m[blake2b_sigma[kRound][2 * (i) + 1]];                     \
+        d = rotr64(d ^ a, 16);                                                 \
+        c = c + d;                                                             \
+        b = rotr64(b ^ c, 63);                                                 \
+    } while ((void)0, 0)
+
+    G_T(0, v[0], v[4], v[8], v[12]);
+    G_T(1, v[1], v[5], v[9], v[13]);
+    G_T(2, v[2], v[6], v[10], v[14]);
+    G_T(3, v[3], v[7], v[11], v[15]);
+    G_T(4, v[0], v[5], v[10], v[15]);
+    G_T(5, v[1], v[6], v[11], v[12]);
+    G_T(6, v[2], v[7], v[8], v[13]);
+    G_T(7, v[3], v[4], v[9], v[14]);
+#undef G_T
+}
+
 static void blake2b_compress(blake2b_state *S, const uint8_t *block) {
     uint64_t m[16];
     uint64_t v[16];
-    unsigned int i, r;
+    unsigned int i;
 
     for (i = 0; i < 16; ++i) {
         m[i] = load64(block + i * sizeof(m[i]));
@@ -167,41 +285,24 @@ static void blake2b_compress(blake2b_state *S, const uint8_t *block) {
     v[14] = blake2b_IV[6] ^ S->f[0];
     v[15] = blake2b_IV[7] ^ S->f[1];
 
-#define G(r, i, a, b, c, d)                                                    \
-    do {                                                                       \
-        a = a + b + m[blake2b_sigma[r][2 * i + 0]];                            \
-        d = rotr64(d ^ a, 32);                                                 \
-        c = c + d;                                                             \
-        b = rotr64(b ^ c, 24);                                                 \
-        a = a + b + m[blake2b_sigma[r][2 * i + 1]];                            \
-        d = rotr64(d ^ a, 16);                                                 \
-        c = c + d;                                                             \
-        b = rotr64(b ^ c, 63);                                                 \
-    } while ((void)0, 0)
-
-#define ROUND(r)                                                               \
-    do {                                                                       \
-        G(r, 0, v[0], v[4], v[8], v[12]);                                      \
-        G(r, 1, v[1], v[5], v[9], v[13]);                                      \
-        G(r, 2, v[2], v[6], v[10], v[14]);                                     \
-        G(r, 3, v[3], v[7], v[11], v[15]);                                     \
-        G(r, 4, v[0], v[5], v[10], v[15]);                                     \
-        G(r, 5, v[1], v[6], v[11], v[12]);                                     \
-        G(r, 6, v[2], v[7], v[8], v[13]);                                      \
-        G(r, 7, v[3], v[4], v[9], v[14]);                                      \
-    } while ((void)0, 0)
-
-    for (r = 0; r < 12; ++r) {
-        ROUND(r);
-    }
+    blake2b_round_t<0>(v, m);
+    blake2b_round_t<1>(v, m);
+    blake2b_round_t<2>(v, m);
+    blake2b_round_t<3>(v, m);
+    blake2b_round_t<4>(v, m);
+    blake2b_round_t<5>(v, m);
+    blake2b_round_t<6>(v, m);
+    blake2b_round_t<7>(v, m);
+    blake2b_round_t<8>(v, m);
+    blake2b_round_t<9>(v, m);
+    blake2b_round_t<10>(v, m);
+    blake2b_round_t<11>(v, m);
 
     for (i = 0; i < 8; ++i) {
         S->h[i] = S->h[i] ^ v[i] ^ v[i + 8];
     }
-
-#undef G
-#undef ROUND
 }
+#endif
 
 int blake2b_update(blake2b_state *S, const void *in, size_t inlen) {
     const uint8_t *pin = (const uint8_t *)in;
@@ -312,6 +413,41 @@ fail:
 }
 
 /* Argon2 Team - Begin Code */
+/*
+ * Fixed 64-byte -> 64-byte hash, the chain step of the block-sized
+ * expansion: parameters never change (outlen 64, no key), so the post-init
+ * state is computed once and each step is exactly one padded compress with
+ * the counter and finalization flag set directly - none of the per-call
+ * init/update/final/burn the generic blake2b() pays thirty times per block.
+ * No burn here: every byte the stack state holds (the chain value in, the
+ * chain value out) also sits in the caller's destination buffer, whose
+ * lifetime the caller already manages.
+ */
+static void blake2b_hash64(uint8_t *out, const uint8_t *in) {
+    /* The post-init chaining value for outlen = 64, no key: the IV with the
+     * parameter word (digest_length 64, fanout 1, depth 1) folded into h[0].
+     * A compile-time constant, so there is nothing to seed at runtime. */
+    static const uint64_t h_init[8] = {
+        UINT64_C(0x6a09e667f3bcc908) ^ UINT64_C(0x0000000001010040),
+        UINT64_C(0xbb67ae8584caa73b), UINT64_C(0x3c6ef372fe94f82b),
+        UINT64_C(0xa54ff53a5f1d36f1), UINT64_C(0x510e527fade682d1),
+        UINT64_C(0x9b05688c2b3e6c1f), UINT64_C(0x1f83d9abfb41bd6b),
+        UINT64_C(0x5be0cd19137e2179),
+    };
+    blake2b_state S;
+    memcpy(S.h, h_init, sizeof(h_init));
+    S.t[0] = BLAKE2B_OUTBYTES; /* exactly one 64-byte message */
+    S.t[1] = 0;
+    S.f[0] = (uint64_t)-1; /* final block */
+    S.f[1] = 0;
+    memcpy(S.buf, in, BLAKE2B_OUTBYTES);
+    memset(S.buf + BLAKE2B_OUTBYTES, 0, sizeof(S.buf) - BLAKE2B_OUTBYTES);
+    blake2b_compress(&S, S.buf);
+    for (int i = 0; i < 8; ++i) {
+        store64(out + sizeof(uint64_t) * i, S.h[i]);
+    }
+}
+
 int blake2b_long(void *pout, size_t outlen, const void *in, size_t inlen) {
     uint8_t *out = (uint8_t *)pout;
     blake2b_state blake_state;
@@ -339,30 +475,36 @@ int blake2b_long(void *pout, size_t outlen, const void *in, size_t inlen) {
         TRY(blake2b_update(&blake_state, in, inlen));
         TRY(blake2b_final(&blake_state, out, outlen));
     } else {
+        /* Zero-copy expansion: every intermediate 64-byte value is written
+         * straight into the destination and each step's first half IS the
+         * next output chunk, so the staging buffers and their per-chunk
+         * memcpys disappear. blake2b() absorbs its input before writing any
+         * output, so computing the next value over out[pos..pos+63] while
+         * writing it at out[pos+32] is safe. The second halves are all
+         * overwritten by later steps, leaving exactly the output bytes. */
         uint32_t toproduce;
-        uint8_t out_buffer[BLAKE2B_OUTBYTES];
-        uint8_t in_buffer[BLAKE2B_OUTBYTES];
+        size_t pos = 0;
         TRY(blake2b_init(&blake_state, BLAKE2B_OUTBYTES));
         TRY(blake2b_update(&blake_state, outlen_bytes, sizeof(outlen_bytes)));
         TRY(blake2b_update(&blake_state, in, inlen));
-        TRY(blake2b_final(&blake_state, out_buffer, BLAKE2B_OUTBYTES));
-        memcpy(out, out_buffer, BLAKE2B_OUTBYTES / 2);
-        out += BLAKE2B_OUTBYTES / 2;
+        TRY(blake2b_final(&blake_state, out, BLAKE2B_OUTBYTES));
         toproduce = (uint32_t)outlen - BLAKE2B_OUTBYTES / 2;
 
         while (toproduce > BLAKE2B_OUTBYTES) {
-            memcpy(in_buffer, out_buffer, BLAKE2B_OUTBYTES);
-            TRY(blake2b(out_buffer, BLAKE2B_OUTBYTES, in_buffer,
-                        BLAKE2B_OUTBYTES, NULL, 0));
-            memcpy(out, out_buffer, BLAKE2B_OUTBYTES / 2);
-            out += BLAKE2B_OUTBYTES / 2;
+            blake2b_hash64(out + pos + BLAKE2B_OUTBYTES / 2, out + pos);
+            pos += BLAKE2B_OUTBYTES / 2;
             toproduce -= BLAKE2B_OUTBYTES / 2;
         }
 
-        memcpy(in_buffer, out_buffer, BLAKE2B_OUTBYTES);
-        TRY(blake2b(out_buffer, toproduce, in_buffer, BLAKE2B_OUTBYTES, NULL,
-                    0));
-        memcpy(out, out_buffer, toproduce);
+        if (toproduce == BLAKE2B_OUTBYTES) {
+            /* block-sized expansions (the first blocks, 2x lanes per hash)
+             * end on a full-width step and stay on the fixed kernel */
+            blake2b_hash64(out + pos + BLAKE2B_OUTBYTES / 2, out + pos);
+            ret = 0;
+        } else {
+            TRY(blake2b(out + pos + BLAKE2B_OUTBYTES / 2, toproduce, out + pos,
+                        BLAKE2B_OUTBYTES, NULL, 0));
+        }
     }
 fail:
     burn(&blake_state, sizeof(blake_state));
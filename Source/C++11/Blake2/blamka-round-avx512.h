@@ -0,0 +1,131 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+#ifndef __BLAKE2_ROUND_MKA_AVX512_H__
+#define __BLAKE2_ROUND_MKA_AVX512_H__
+
+#include <immintrin.h>
+
+/*
+ * 512-bit BlaMka round: eight G functions per instruction and native 64-bit
+ * rotates (vprorq) instead of the shift+or sequences of the narrower kernels.
+ * The 1 KB block is processed as 16 zmm registers.
+ */
+
+#define ror64_512(x, n) _mm512_ror_epi64((x), (n))
+
+/* BlaMka mixing: a + b + 2 * trunc(a) * trunc(b), eight lanes at once */
+static inline __m512i fBlaMka512(__m512i x, __m512i y) {
+    const __m512i z = _mm512_mul_epu32(x, y);
+    return _mm512_add_epi64(_mm512_add_epi64(x, y), _mm512_add_epi64(z, z));
+}
+
+#define G1_AVX512(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        A0 = fBlaMka512(A0, B0); \
+        A1 = fBlaMka512(A1, B1); \
+        D0 = ror64_512(_mm512_xor_si512(D0, A0), 32); \
+        D1 = ror64_512(_mm512_xor_si512(D1, A1), 32); \
+        C0 = fBlaMka512(C0, D0); \
+        C1 = fBlaMka512(C1, D1); \
+        B0 = ror64_512(_mm512_xor_si512(B0, C0), 24); \
+        B1 = ror64_512(_mm512_xor_si512(B1, C1), 24); \
+    } while ((void)0, 0)
+
+#define G2_AVX512(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        A0 = fBlaMka512(A0, B0); \
+        A1 = fBlaMka512(A1, B1); \
+        D0 = ror64_512(_mm512_xor_si512(D0, A0), 16); \
+        D1 = ror64_512(_mm512_xor_si512(D1, A1), 16); \
+        C0 = fBlaMka512(C0, D0); \
+        C1 = fBlaMka512(C1, D1); \
+        B0 = ror64_512(_mm512_xor_si512(B0, C0), 63); \
+        B1 = ror64_512(_mm512_xor_si512(B1, C1), 63); \
+    } while ((void)0, 0)
+
+#define DIAGONALIZE_AVX512(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        B0 = _mm512_permutex_epi64(B0, _MM_SHUFFLE(0, 3, 2, 1)); \
+        B1 = _mm512_permutex_epi64(B1, _MM_SHUFFLE(0, 3, 2, 1)); \
+        C0 = _mm512_permutex_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2)); \
+        C1 = _mm512_permutex_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2)); \
+        D0 = _mm512_permutex_epi64(D0, _MM_SHUFFLE(2, 1, 0, 3)); \
+        D1 = _mm512_permutex_epi64(D1, _MM_SHUFFLE(2, 1, 0, 3)); \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_AVX512(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        B0 = _mm512_permutex_epi64(B0, _MM_SHUFFLE(2, 1, 0, 3)); \
+        B1 = _mm512_permutex_epi64(B1, _MM_SHUFFLE(2, 1, 0, 3)); \
+        C0 = _mm512_permutex_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2)); \
+        C1 = _mm512_permutex_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2)); \
+        D0 = _mm512_permutex_epi64(D0, _MM_SHUFFLE(0, 3, 2, 1)); \
+        D1 = _mm512_permutex_epi64(D1, _MM_SHUFFLE(0, 3, 2, 1)); \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_AVX512(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        G1_AVX512(A0, B0, C0, D0, A1, B1, C1, D1); \
+        G2_AVX512(A0, B0, C0, D0, A1, B1, C1, D1); \
+        DIAGONALIZE_AVX512(A0, B0, C0, D0, A1, B1, C1, D1); \
+        G1_AVX512(A0, B0, C0, D0, A1, B1, C1, D1); \
+        G2_AVX512(A0, B0, C0, D0, A1, B1, C1, D1); \
+        UNDIAGONALIZE_AVX512(A0, B0, C0, D0, A1, B1, C1, D1); \
+    } while ((void)0, 0)
+
+/* Lane regrouping so both sweeps see their 4x4 matrices in register halves */
+#define SWAP_HALVES_AVX512(A0, A1) \
+    do { \
+        __m512i t_swap = _mm512_shuffle_i64x2(A0, A1, _MM_SHUFFLE(1, 0, 1, 0)); \
+        A1 = _mm512_shuffle_i64x2(A0, A1, _MM_SHUFFLE(3, 2, 3, 2)); \
+        A0 = t_swap; \
+    } while ((void)0, 0)
+
+#define SWAP_QUARTERS_AVX512(A0, A1) \
+    do { \
+        SWAP_HALVES_AVX512(A0, A1); \
+        A0 = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7), A0); \
+        A1 = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7), A1); \
+    } while ((void)0, 0)
+
+#define UNSWAP_QUARTERS_AVX512(A0, A1) \
+    do { \
+        A0 = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7), A0); \
+        A1 = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7), A1); \
+        SWAP_HALVES_AVX512(A0, A1); \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_1_AVX512(A0, C0, B0, D0, A1, C1, B1, D1) \
+    do { \
+        SWAP_HALVES_AVX512(A0, B0); \
+        SWAP_HALVES_AVX512(C0, D0); \
+        SWAP_HALVES_AVX512(A1, B1); \
+        SWAP_HALVES_AVX512(C1, D1); \
+        BLAKE2_ROUND_AVX512(A0, B0, C0, D0, A1, B1, C1, D1); \
+        SWAP_HALVES_AVX512(A0, B0); \
+        SWAP_HALVES_AVX512(C0, D0); \
+        SWAP_HALVES_AVX512(A1, B1); \
+        SWAP_HALVES_AVX512(C1, D1); \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_2_AVX512(A0, A1, B0, B1, C0, C1, D0, D1) \
+    do { \
+        SWAP_QUARTERS_AVX512(A0, A1); \
+        SWAP_QUARTERS_AVX512(B0, B1); \
+        SWAP_QUARTERS_AVX512(C0, C1); \
+        SWAP_QUARTERS_AVX512(D0, D1); \
+        BLAKE2_ROUND_AVX512(A0, B0, C0, D0, A1, B1, C1, D1); \
+        UNSWAP_QUARTERS_AVX512(A0, A1); \
+        UNSWAP_QUARTERS_AVX512(B0, B1); \
+        UNSWAP_QUARTERS_AVX512(C0, C1); \
+        UNSWAP_QUARTERS_AVX512(D0, D1); \
+    } while ((void)0, 0)
+
+#endif
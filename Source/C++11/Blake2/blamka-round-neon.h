@@ -0,0 +1,97 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+#ifndef __BLAKE2_ROUND_MKA_NEON_H__
+#define __BLAKE2_ROUND_MKA_NEON_H__
+
+#include <arm_neon.h>
+
+/*
+ * NEON/ASIMD BlaMka round, same two-vector-wide shape as the SSE round in
+ * blamka-round-opt.h: each uint64x2_t holds two of the 4x4 matrix columns'
+ * words, DIAGONALIZE rotates across the register pairs with vext.
+ */
+
+#define rotr32_neon(x) vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(x)))
+#define rotr24_neon(x) veorq_u64(vshrq_n_u64((x), 24), vshlq_n_u64((x), 40))
+#define rotr16_neon(x) veorq_u64(vshrq_n_u64((x), 16), vshlq_n_u64((x), 48))
+#define rotr63_neon(x) veorq_u64(vshrq_n_u64((x), 63), vaddq_u64((x), (x)))
+
+/* BlaMka mixing: a + b + 2 * trunc(a) * trunc(b), two lanes at once */
+static inline uint64x2_t fBlaMka_neon(uint64x2_t x, uint64x2_t y) {
+    const uint64x2_t z = vmull_u32(vmovn_u64(x), vmovn_u64(y));
+    return vaddq_u64(vaddq_u64(x, y), vaddq_u64(z, z));
+}
+
+#define G1(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        A0 = fBlaMka_neon(A0, B0); \
+        A1 = fBlaMka_neon(A1, B1); \
+        D0 = rotr32_neon(veorq_u64(D0, A0)); \
+        D1 = rotr32_neon(veorq_u64(D1, A1)); \
+        C0 = fBlaMka_neon(C0, D0); \
+        C1 = fBlaMka_neon(C1, D1); \
+        B0 = rotr24_neon(veorq_u64(B0, C0)); \
+        B1 = rotr24_neon(veorq_u64(B1, C1)); \
+    } while ((void)0, 0)
+
+#define G2(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        A0 = fBlaMka_neon(A0, B0); \
+        A1 = fBlaMka_neon(A1, B1); \
+        D0 = rotr16_neon(veorq_u64(D0, A0)); \
+        D1 = rotr16_neon(veorq_u64(D1, A1)); \
+        C0 = fBlaMka_neon(C0, D0); \
+        C1 = fBlaMka_neon(C1, D1); \
+        B0 = rotr63_neon(veorq_u64(B0, C0)); \
+        B1 = rotr63_neon(veorq_u64(B1, C1)); \
+    } while ((void)0, 0)
+
+/* vext is the alignr of the SSSE3 variant: {B0.hi, B1.lo} etc. */
+#define DIAGONALIZE(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        uint64x2_t t0 = vextq_u64(B0, B1, 1); \
+        uint64x2_t t1 = vextq_u64(B1, B0, 1); \
+        B0 = t0; \
+        B1 = t1; \
+        t0 = C0; \
+        C0 = C1; \
+        C1 = t0; \
+        t0 = vextq_u64(D0, D1, 1); \
+        t1 = vextq_u64(D1, D0, 1); \
+        D0 = t1; \
+        D1 = t0; \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        uint64x2_t t0 = vextq_u64(B1, B0, 1); \
+        uint64x2_t t1 = vextq_u64(B0, B1, 1); \
+        B0 = t0; \
+        B1 = t1; \
+        t0 = C0; \
+        C0 = C1; \
+        C1 = t0; \
+        t0 = vextq_u64(D1, D0, 1); \
+        t1 = vextq_u64(D0, D1, 1); \
+        D0 = t1; \
+        D1 = t0; \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND(A0, A1, B0, B1, C0, C1, D0, D1) \
+    do { \
+        G1(A0, B0, C0, D0, A1, B1, C1, D1); \
+        G2(A0, B0, C0, D0, A1, B1, C1, D1); \
+        DIAGONALIZE(A0, B0, C0, D0, A1, B1, C1, D1); \
+        G1(A0, B0, C0, D0, A1, B1, C1, D1); \
+        G2(A0, B0, C0, D0, A1, B1, C1, D1); \
+        UNDIAGONALIZE(A0, B0, C0, D0, A1, B1, C1, D1); \
+    } while ((void)0, 0)
+
+#endif
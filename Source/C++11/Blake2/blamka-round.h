@@ -0,0 +1,138 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+#ifndef __BLAKE2_ROUND_MKA_DISPATCH_H__
+#define __BLAKE2_ROUND_MKA_DISPATCH_H__
+
+/*
+ * Width-parameterized BlaMka round layer: selects the widest round header the
+ * target supports and exports one uniform interface -
+ *
+ *   Argon2StateVec             vector type holding part of a block
+ *   ARGON2_STATE_VECS          vectors per 1 KB block
+ *   ARGON2_VEC_BYTES           bytes per vector
+ *   ARGON2_VEC_LOAD/STORE/STREAM/XOR
+ *   ARGON2_VEC_ADD_W0/ADD_W127 add a scalar into word 0 / word 127
+ *   ARGON2_ROUND_SWEEP_COLUMNS/ROWS(state)
+ *   ARGON2_ROUND_SWEEP_COLUMNS_2/ROWS_2(a, b)   interleaved two-block form
+ *
+ * so every FillBlock variant instantiates the same kernel body and a schedule
+ * improvement lands on all ISAs at once. New targets only add a section here.
+ */
+
+#include "blake2-impl.h"
+
+#if defined(__aarch64__) || (defined(__arm__) && defined(__ARM_NEON))
+
+#include "blamka-round-neon.h"
+typedef uint64x2_t Argon2StateVec;
+#define ARGON2_STATE_VECS 64
+#define ARGON2_VEC_BYTES 16
+#define ARGON2_VEC_LOAD(p) vld1q_u64((const uint64_t *)(p))
+#define ARGON2_VEC_STORE(p, x) vst1q_u64((uint64_t *)(p), (x))
+#define ARGON2_VEC_STREAM ARGON2_VEC_STORE /*no NT stores on NEON*/
+#define ARGON2_VEC_FENCE()
+#define ARGON2_VEC_XOR(a, b) veorq_u64((a), (b))
+#define ARGON2_VEC_ADD_W0(v, s) vaddq_u64((v), vcombine_u64(vcreate_u64(s), vcreate_u64(0)))
+#define ARGON2_VEC_ADD_W127(v, s) vaddq_u64((v), vcombine_u64(vcreate_u64(0), vcreate_u64(s)))
+#define ARGON2_SWEEP_ITERS 8
+#define ARGON2_ROUND_COLUMNS_AT(state, i_) \
+    BLAKE2_ROUND((state)[8 * (i_) + 0], (state)[8 * (i_) + 1], (state)[8 * (i_) + 2], (state)[8 * (i_) + 3], \
+            (state)[8 * (i_) + 4], (state)[8 * (i_) + 5], (state)[8 * (i_) + 6], (state)[8 * (i_) + 7])
+#define ARGON2_ROUND_ROWS_AT(state, i_) \
+    BLAKE2_ROUND((state)[8 * 0 + (i_)], (state)[8 * 1 + (i_)], (state)[8 * 2 + (i_)], (state)[8 * 3 + (i_)], \
+            (state)[8 * 4 + (i_)], (state)[8 * 5 + (i_)], (state)[8 * 6 + (i_)], (state)[8 * 7 + (i_)])
+
+#elif defined(__AVX512F__)
+
+#include "blamka-round-avx512.h"
+typedef __m512i Argon2StateVec;
+#define ARGON2_STATE_VECS 16
+#define ARGON2_VEC_BYTES 64
+#define ARGON2_VEC_LOAD(p) _mm512_load_si512((const __m512i *)(p))
+#define ARGON2_VEC_STORE(p, x) _mm512_store_si512((__m512i *)(p), (x))
+#define ARGON2_VEC_STREAM(p, x) _mm512_stream_si512((__m512i *)(p), (x))
+#define ARGON2_VEC_FENCE() _mm_sfence()
+#define ARGON2_VEC_XOR(a, b) _mm512_xor_si512((a), (b))
+#define ARGON2_VEC_ADD_W0(v, s) _mm512_add_epi64((v), _mm512_set_epi64(0, 0, 0, 0, 0, 0, 0, (s)))
+#define ARGON2_VEC_ADD_W127(v, s) _mm512_add_epi64((v), _mm512_set_epi64((s), 0, 0, 0, 0, 0, 0, 0))
+#define ARGON2_SWEEP_ITERS 2
+#define ARGON2_ROUND_COLUMNS_AT(state, i_) \
+    BLAKE2_ROUND_1_AVX512((state)[8 * (i_) + 0], (state)[8 * (i_) + 1], (state)[8 * (i_) + 2], (state)[8 * (i_) + 3], \
+            (state)[8 * (i_) + 4], (state)[8 * (i_) + 5], (state)[8 * (i_) + 6], (state)[8 * (i_) + 7])
+#define ARGON2_ROUND_ROWS_AT(state, i_) \
+    BLAKE2_ROUND_2_AVX512((state)[2 * 0 + (i_)], (state)[2 * 1 + (i_)], (state)[2 * 2 + (i_)], (state)[2 * 3 + (i_)], \
+            (state)[2 * 4 + (i_)], (state)[2 * 5 + (i_)], (state)[2 * 6 + (i_)], (state)[2 * 7 + (i_)])
+
+#elif defined(__AVX2__)
+
+#include "blamka-round-avx2.h"
+typedef __m256i Argon2StateVec;
+#define ARGON2_STATE_VECS 32
+#define ARGON2_VEC_BYTES 32
+#define ARGON2_VEC_LOAD(p) _mm256_load_si256((const __m256i *)(p))
+#define ARGON2_VEC_STORE(p, x) _mm256_store_si256((__m256i *)(p), (x))
+#define ARGON2_VEC_STREAM(p, x) _mm256_stream_si256((__m256i *)(p), (x))
+#define ARGON2_VEC_FENCE() _mm_sfence()
+#define ARGON2_VEC_XOR(a, b) _mm256_xor_si256((a), (b))
+#define ARGON2_VEC_ADD_W0(v, s) _mm256_add_epi64((v), _mm256_set_epi64x(0, 0, 0, (s)))
+#define ARGON2_VEC_ADD_W127(v, s) _mm256_add_epi64((v), _mm256_set_epi64x((s), 0, 0, 0))
+#define ARGON2_SWEEP_ITERS 4
+#define ARGON2_ROUND_COLUMNS_AT(state, i_) \
+    BLAKE2_ROUND_1_AVX2((state)[8 * (i_) + 0], (state)[8 * (i_) + 4], (state)[8 * (i_) + 1], (state)[8 * (i_) + 5], \
+            (state)[8 * (i_) + 2], (state)[8 * (i_) + 6], (state)[8 * (i_) + 3], (state)[8 * (i_) + 7])
+#define ARGON2_ROUND_ROWS_AT(state, i_) \
+    BLAKE2_ROUND_2_AVX2((state)[0 + (i_)], (state)[4 + (i_)], (state)[8 + (i_)], (state)[12 + (i_)], \
+            (state)[16 + (i_)], (state)[20 + (i_)], (state)[24 + (i_)], (state)[28 + (i_)])
+
+#else /* SSE2/SSSE3 baseline */
+
+#include "blamka-round-opt.h"
+typedef __m128i Argon2StateVec;
+#define ARGON2_STATE_VECS 64
+#define ARGON2_VEC_BYTES 16
+#define ARGON2_VEC_LOAD(p) _mm_load_si128((const __m128i *)(p))
+#define ARGON2_VEC_STORE(p, x) _mm_store_si128((__m128i *)(p), (x))
+#define ARGON2_VEC_STREAM(p, x) _mm_stream_si128((__m128i *)(p), (x))
+#define ARGON2_VEC_FENCE() _mm_sfence()
+#define ARGON2_VEC_XOR(a, b) _mm_xor_si128((a), (b))
+#define ARGON2_VEC_ADD_W0(v, s) _mm_add_epi64((v), _mm_set_epi64x(0, (s)))
+#define ARGON2_VEC_ADD_W127(v, s) _mm_add_epi64((v), _mm_set_epi64x((s), 0))
+#define ARGON2_SWEEP_ITERS 8
+#define ARGON2_ROUND_COLUMNS_AT(state, i_) \
+    BLAKE2_ROUND((state)[8 * (i_) + 0], (state)[8 * (i_) + 1], (state)[8 * (i_) + 2], (state)[8 * (i_) + 3], \
+            (state)[8 * (i_) + 4], (state)[8 * (i_) + 5], (state)[8 * (i_) + 6], (state)[8 * (i_) + 7])
+#define ARGON2_ROUND_ROWS_AT(state, i_) \
+    BLAKE2_ROUND((state)[8 * 0 + (i_)], (state)[8 * 1 + (i_)], (state)[8 * 2 + (i_)], (state)[8 * 3 + (i_)], \
+            (state)[8 * 4 + (i_)], (state)[8 * 5 + (i_)], (state)[8 * 6 + (i_)], (state)[8 * 7 + (i_)])
+
+#endif
+
+/* Whole-block sweeps and the interleaved two-block form (per-iteration
+ * alternation, so the two independent chains overlap in the OoO window) */
+#define ARGON2_ROUND_SWEEP_COLUMNS(state) \
+    for (uint32_t i_ = 0; i_ < ARGON2_SWEEP_ITERS; ++i_) { \
+        ARGON2_ROUND_COLUMNS_AT(state, i_); \
+    }
+#define ARGON2_ROUND_SWEEP_ROWS(state) \
+    for (uint32_t i_ = 0; i_ < ARGON2_SWEEP_ITERS; ++i_) { \
+        ARGON2_ROUND_ROWS_AT(state, i_); \
+    }
+#define ARGON2_ROUND_SWEEP_COLUMNS_2(a, b) \
+    for (uint32_t i_ = 0; i_ < ARGON2_SWEEP_ITERS; ++i_) { \
+        ARGON2_ROUND_COLUMNS_AT(a, i_); \
+        ARGON2_ROUND_COLUMNS_AT(b, i_); \
+    }
+#define ARGON2_ROUND_SWEEP_ROWS_2(a, b) \
+    for (uint32_t i_ = 0; i_ < ARGON2_SWEEP_ITERS; ++i_) { \
+        ARGON2_ROUND_ROWS_AT(a, i_); \
+        ARGON2_ROUND_ROWS_AT(b, i_); \
+    }
+
+#endif
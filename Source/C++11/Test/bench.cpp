@@ -1,108 +1,857 @@
 /*
  * Argon2 source code package
- * 
+ *
  * Written by Daniel Dinu and Dmitry Khovratovich, 2015
- * 
+ *
  * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
- * 
+ *
  * You should have received a copy of the CC0 Public Domain Dedication along with
  * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
-// #include <stdio.h>
-// #include <stdint.h>
-// #include <stdlib.h>
-// #include <string.h>
-// #include <time.h>
 #include <cstdio>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
-#include <ctime>
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
 
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 // #include "argon2.h"
 #include "../Argon2/argon2.h"
+#include "../Argon2/argon2-threads.h"
+#include "benchtimer.h"
 
-static uint64_t rdtsc(void) {
-#ifdef _MSC_VER
-    return __rdtsc();
-#else
-#if defined(__amd64__) || defined(__x86_64__)
-    uint64_t rax, rdx;
-    __asm__ __volatile__("rdtsc" : "=a"(rax), "=d"(rdx) : :);
-    return (rdx << 32) | rax;
-#elif defined(__i386__) || defined(__i386) || defined(__X86__)
-    uint64_t rax;
-    __asm__ __volatile__("rdtsc" : "=A"(rax) : :);
-    return rax;
+#if defined(__linux__)
+/*
+ * perf_event_open counters around each measured repetition: cycles-per-byte
+ * alone cannot say whether a kernel change is compute- or bandwidth-limited,
+ * but LLC misses, dTLB misses and stalled backend cycles attribute a
+ * regression to the right resource without leaving the harness. Page faults
+ * (a software event, available even on PMU-less VMs) attribute prefault
+ * cost. Userspace counting only (exclude_kernel), so it works at
+ * perf_event_paranoid <= 2; counters the host cannot provide read as n/a.
+ */
+struct PerfCounter {
+    const char* name;
+    int fd;
+};
+
+static int OpenPerfCounter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void OpenPerfCounters(PerfCounter counters[4]) {
+    counters[0].name = "llc_misses";
+    counters[0].fd = OpenPerfCounter(PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    counters[1].name = "dtlb_misses";
+    counters[1].fd = OpenPerfCounter(PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    counters[2].name = "stalled_backend";
+    counters[2].fd = OpenPerfCounter(PERF_TYPE_HARDWARE,
+            PERF_COUNT_HW_STALLED_CYCLES_BACKEND);
+    counters[3].name = "page_faults";
+    counters[3].fd = OpenPerfCounter(PERF_TYPE_SOFTWARE,
+            PERF_COUNT_SW_PAGE_FAULTS);
+}
+#endif
+
+/*
+ * Statistical benchmark harness: each configuration runs warmup iterations
+ * that are thrown away, then N measured repetitions, and reports the median
+ * with the median absolute deviation - the one-shot rdtsc deltas this
+ * replaced were noisier than the effects being measured. Parameter grids
+ * come from the command line; the defaults reproduce the historical sweep.
+ */
+
+enum BenchOutput {
+    BENCH_TABLE,
+    BENCH_CSV,
+    BENCH_JSON
+};
+
+/*
+ * Baseline store: named per-machine records of the grid's medians, kept in a
+ * plain text file so diffs of the baseline itself review well. -record
+ * writes or refreshes the rows this run produced (rows from other machines
+ * or labels are preserved); -check reruns the grid and compares against the
+ * stored medians with a noise-aware threshold - a regression must clear
+ * both the MAD band of the two runs and a relative floor, so an unlucky
+ * scheduling blip does not fail the gate, and a real multi-percent
+ * regression cannot hide inside it.
+ */
+struct BaselineRow {
+    std::string machine;
+    std::string label;
+    std::string type;
+    uint32_t t_cost;
+    uint32_t m_cost;
+    uint32_t threads;
+    double med_cpb;
+    double mad_cpb;
+    double gbps;
+    uint32_t reps;
+};
+
+static std::string MachineKey() {
+    char host[128] = "unknown";
+#if defined(__linux__)
+    gethostname(host, sizeof (host) - 1);
+#endif
+    std::string key(host);
+    key += "/";
+    key += Argon2KernelName();
+    char cores[16];
+    snprintf(cores, sizeof (cores), "x%u", std::thread::hardware_concurrency());
+    key += cores;
+    return key;
+}
+
+static std::vector<BaselineRow> LoadBaselines(const char* path) {
+    std::vector<BaselineRow> rows;
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return rows;
+    }
+    char line[512];
+    while (fgets(line, sizeof (line), f) != NULL) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        char machine[160], label[80], type[8];
+        BaselineRow row;
+        if (10 == sscanf(line, "%159s %79s %7s %u %u %u %lf %lf %lf %u",
+                machine, label, type, &row.t_cost, &row.m_cost, &row.threads,
+                &row.med_cpb, &row.mad_cpb, &row.gbps, &row.reps)) {
+            row.machine = machine;
+            row.label = label;
+            row.type = type;
+            rows.push_back(row);
+        }
+    }
+    fclose(f);
+    return rows;
+}
+
+static bool SaveBaselines(const char* path, const std::vector<BaselineRow>& rows) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "cannot write baseline file %s\n", path);
+        return false;
+    }
+    fprintf(f, "# argon2-bench baselines: machine label type t_cost m_cost_kib threads"
+            " median_cpb mad_cpb fill_gbps reps\n");
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const BaselineRow& row = rows[i];
+        fprintf(f, "%s %s %s %u %u %u %.4f %.4f %.3f %u\n",
+                row.machine.c_str(), row.label.c_str(), row.type.c_str(),
+                row.t_cost, row.m_cost, row.threads,
+                row.med_cpb, row.mad_cpb, row.gbps, row.reps);
+    }
+    fclose(f);
+    return true;
+}
+
+static BaselineRow* FindBaseline(std::vector<BaselineRow>& rows, const BaselineRow& key) {
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (rows[i].machine == key.machine && rows[i].label == key.label
+                && rows[i].type == key.type && rows[i].t_cost == key.t_cost
+                && rows[i].m_cost == key.m_cost && rows[i].threads == key.threads) {
+            return &rows[i];
+        }
+    }
+    return NULL;
+}
+
+struct BenchSample {
+    uint64_t cycles;
+    double millis;
+    uint64_t counters[4];
+};
+
+static double Median(std::vector<double>& values) {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return (n % 2 == 1) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2.0;
+}
+
+/* Median absolute deviation: robust spread, insensitive to the odd outlier
+ * (a page-cache hiccup or a migration) that wrecks a standard deviation */
+static double Mad(const std::vector<double>& values, double median) {
+    std::vector<double> deviations;
+    deviations.reserve(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        double d = values[i] - median;
+        deviations.push_back(d < 0 ? -d : d);
+    }
+    return Median(deviations);
+}
+
+static int RunType(const std::string& type, Argon2_Context* context) {
+    if (type == "d") return Argon2d(context);
+    if (type == "i") return Argon2i(context);
+    if (type == "id") return Argon2id(context);
+    if (type == "ds") return Argon2ds(context);
+    return ARGON2_INCORRECT_TYPE;
+}
+
+static bool BenchmarkOne(const std::string& type, uint32_t t_cost, uint32_t m_cost,
+        uint32_t threads, uint32_t warmup, uint32_t reps, BenchOutput output, bool first_row,
+        bool with_perf, BaselineRow* measured = NULL) {
+    const uint32_t inlen = 16;
+    const unsigned outlen = 16;
+    unsigned char out[outlen];
+    unsigned char pwd_array[inlen];
+    unsigned char salt_array[inlen];
+    memset(pwd_array, 0, inlen);
+    memset(salt_array, 1, inlen);
+
+#if defined(__linux__)
+    PerfCounter perf[4] = {{NULL, -1}, {NULL, -1}, {NULL, -1}, {NULL, -1}};
+    if (with_perf) {
+        OpenPerfCounters(perf);
+    }
 #else
-#error "Not implemented!"
+    (void) with_perf;
+#endif
+
+    std::vector<BenchSample> samples;
+    for (uint32_t i = 0; i < warmup + reps; ++i) {
+        Argon2_Context context(out, outlen, pwd_array, inlen, salt_array, inlen, NULL, 0, NULL, 0,
+                t_cost, m_cost, threads, threads, NULL, NULL, false, false, false, false);
+#if defined(__linux__)
+        for (int c = 0; c < 4; ++c) {
+            if (perf[c].fd >= 0) {
+                ioctl(perf[c].fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(perf[c].fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = BenchTicks();
+        int result = RunType(type, &context);
+        uint64_t c1 = BenchTicks();
+        double ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - t0).count();
+        BenchSample sample = {c1 - c0, ms, {0, 0, 0, 0}};
+#if defined(__linux__)
+        for (int c = 0; c < 4; ++c) {
+            if (perf[c].fd >= 0) {
+                ioctl(perf[c].fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(perf[c].fd, &sample.counters[c], sizeof (uint64_t)) != sizeof (uint64_t)) {
+                    sample.counters[c] = 0;
+                }
+            }
+        }
 #endif
+        if (ARGON2_OK != result) {
+            fprintf(stderr, "Argon2%s m=%u p=%u failed: %s\n",
+                    type.c_str(), m_cost, threads, ErrorMessage(result));
+#if defined(__linux__)
+            for (int c = 0; c < 4; ++c) {
+                if (perf[c].fd >= 0) {
+                    close(perf[c].fd);
+                }
+            }
 #endif
+            return false;
+        }
+        if (i >= warmup) {
+            samples.push_back(sample);
+        }
+    }
+#if defined(__linux__)
+    bool perf_open[4] = {perf[0].fd >= 0, perf[1].fd >= 0, perf[2].fd >= 0, perf[3].fd >= 0};
+    for (int c = 0; c < 4; ++c) {
+        if (perf[c].fd >= 0) {
+            close(perf[c].fd);
+        }
+    }
+#else
+    bool perf_open[4] = {false, false, false, false};
+#endif
+
+    std::vector<double> cycles, millis;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        cycles.push_back((double) samples[i].cycles);
+        millis.push_back(samples[i].millis);
+    }
+    double med_cycles = Median(cycles);
+    double mad_cycles = Mad(cycles, med_cycles);
+    double med_ms = Median(millis);
+    double mad_ms = Mad(millis, med_ms);
+    double cpb = med_cycles / ((double) m_cost * 1024.0);
+
+    if (measured != NULL) {
+        measured->type = type;
+        measured->t_cost = t_cost;
+        measured->m_cost = m_cost;
+        measured->threads = threads;
+        measured->med_cpb = cpb;
+        measured->mad_cpb = mad_cycles / ((double) m_cost * 1024.0);
+        measured->gbps = ((double) m_cost * 1024.0 * t_cost) / (med_ms / 1000.0) / 1e9;
+        measured->reps = reps;
+    }
+
+    double med_counters[4] = {0, 0, 0, 0};
+    for (int c = 0; c < 4; ++c) {
+        if (perf_open[c]) {
+            std::vector<double> values;
+            for (size_t i = 0; i < samples.size(); ++i) {
+                values.push_back((double) samples[i].counters[c]);
+            }
+            med_counters[c] = Median(values);
+        }
+    }
+
+    switch (output) {
+        case BENCH_CSV:
+            if (first_row) {
+                printf("type,t_cost,m_cost_kib,threads,reps,median_cpb,median_mcycles,mad_mcycles,median_ms,mad_ms");
+                if (with_perf) {
+                    printf(",llc_misses,dtlb_misses,stalled_backend,page_faults");
+                }
+                printf("\n");
+            }
+            printf("%s,%u,%u,%u,%u,%.3f,%.2f,%.2f,%.3f,%.3f",
+                    type.c_str(), t_cost, m_cost, threads, reps,
+                    cpb, med_cycles / (1 << 20), mad_cycles / (1 << 20), med_ms, mad_ms);
+            if (with_perf) {
+                for (int c = 0; c < 4; ++c) {
+                    if (perf_open[c]) {
+                        printf(",%.0f", med_counters[c]);
+                    } else {
+                        printf(",n/a");
+                    }
+                }
+            }
+            printf("\n");
+            break;
+        case BENCH_JSON:
+            printf("%s{\"type\":\"%s\",\"t_cost\":%u,\"m_cost_kib\":%u,\"threads\":%u,\"reps\":%u,"
+                    "\"median_cpb\":%.3f,\"median_mcycles\":%.2f,\"mad_mcycles\":%.2f,"
+                    "\"median_ms\":%.3f,\"mad_ms\":%.3f}",
+                    first_row ? "[" : ",\n ", type.c_str(), t_cost, m_cost, threads, reps,
+                    cpb, med_cycles / (1 << 20), mad_cycles / (1 << 20), med_ms, mad_ms);
+            break;
+        default:
+            printf("Argon2%-3s %u pass(es) %6u KiB %2u lanes/threads: %6.2f cpb  %8.2f Mcycles (MAD %.2f)  %8.3f ms (MAD %.3f)  [%u reps]",
+                    type.c_str(), t_cost, m_cost, threads,
+                    cpb, med_cycles / (1 << 20), mad_cycles / (1 << 20), med_ms, mad_ms, reps);
+            if (with_perf) {
+                printf("  llc=%s%.2fM dtlb=%s%.2fM stall=%s%.0fM faults=%s%.0f",
+                        perf_open[0] ? "" : "n/a ", med_counters[0] / 1e6,
+                        perf_open[1] ? "" : "n/a ", med_counters[1] / 1e6,
+                        perf_open[2] ? "" : "n/a ", med_counters[2] / 1e6,
+                        perf_open[3] ? "" : "n/a ", med_counters[3]);
+            }
+            printf("\n");
+            break;
+    }
+    return true;
+}
+
+static std::vector<uint32_t> ParseList(const char* arg) {
+    std::vector<uint32_t> values;
+    std::string s(arg);
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = s.size();
+        }
+        values.push_back((uint32_t) strtoul(s.substr(pos, comma - pos).c_str(), NULL, 10));
+        pos = comma + 1;
+    }
+    return values;
+}
+
+static std::vector<std::string> ParseTypes(const char* arg) {
+    std::vector<std::string> types;
+    std::string s(arg);
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = s.size();
+        }
+        types.push_back(s.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+    return types;
 }
 
 /*
- * Benchmarks Argon2 with salt length 16, password length 32, t_cost 3, and different threads and m_cost
+ * Open-loop latency-distribution mode: requests are scheduled at a fixed
+ * arrival rate and submitted to the worker pool whether or not earlier
+ * hashes finished - latency runs from the scheduled arrival to completion,
+ * so queueing delay (what a closed loop hides as coordinated omission) lands
+ * in the tail where the SLO sees it. Each request stamps its own completion.
+ * No rate (-rate 0) degrades to a closed back-to-back loop.
  */
-void Benchmark() {
+struct LatencyRequest {
+    std::chrono::steady_clock::time_point done;
+    int result;
+};
+
+static int RunLatencyMode(const std::string& type, uint32_t t_cost, uint32_t m_cost,
+        uint32_t threads, uint32_t count, double rate) {
     const uint32_t inlen = 16;
-    const unsigned outlen=16;
-    unsigned char out[outlen];
+    const unsigned outlen = 16;
     unsigned char pwd_array[inlen];
     unsigned char salt_array[inlen];
+    memset(pwd_array, 0, inlen);
+    memset(salt_array, 1, inlen);
 
-    uint32_t t_cost = 1;
+    std::vector<unsigned char> outs((size_t) count * outlen);
+    std::vector<Argon2_Context> contexts;
+    contexts.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        contexts.push_back(Argon2_Context(&outs[(size_t) i * outlen], outlen,
+                pwd_array, inlen, salt_array, inlen, NULL, 0, NULL, 0,
+                t_cost, m_cost, threads, threads, NULL, NULL, false, false, false, false));
+    }
+
+    Argon2ThreadPool& pool = Argon2ThreadPool::Instance();
+    std::vector<LatencyRequest> requests(count);
+    std::vector<std::future<void> > futures;
+    futures.reserve(count);
+    std::vector<std::chrono::steady_clock::time_point> scheduled(count);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // Bound the outstanding window: each in-flight request holds a pool
+    // coordinator (= one OS thread), and an unbounded open loop under deep
+    // overload would try to spawn one per queued request. Waiting on the
+    // oldest request is pure backpressure - latency still runs from the
+    // scheduled arrival, so the queueing delay stays in the tail.
+    const uint32_t max_outstanding = 512;
+    uint32_t drained = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (i - drained >= max_outstanding) {
+            futures[drained].wait();
+            ++drained;
+        }
+        if (rate > 0) {
+            scheduled[i] = start + std::chrono::microseconds((uint64_t) (i * 1e6 / rate));
+            std::this_thread::sleep_until(scheduled[i]);
+        } else {
+            scheduled[i] = std::chrono::steady_clock::now();
+        }
+        Argon2_Context* context = &contexts[i];
+        LatencyRequest* request = &requests[i];
+        const std::string* type_name = &type;
+        pool.Reserve(1, false); //coordinator, exempt from the cap (like the async API)
+        auto task = std::make_shared<std::packaged_task<void()> >(
+                [context, request, type_name]() {
+            request->result = RunType(*type_name, context);
+            request->done = std::chrono::steady_clock::now();
+            Argon2ThreadPool::Instance().Release(1, false);
+        });
+        futures.push_back(task->get_future());
+        pool.Submit([task]() {
+            (*task)();
+        });
+        if (rate <= 0) {
+            futures.back().wait();
+        }
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        futures[i].wait();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    std::vector<double> latencies;
+    latencies.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (ARGON2_OK != requests[i].result) {
+            fprintf(stderr, "request %u failed: %s\n", i, ErrorMessage(requests[i].result));
+            return 1;
+        }
+        latencies.push_back(std::chrono::duration<double, std::milli>(
+                requests[i].done - scheduled[i]).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double wall_s = std::chrono::duration<double>(end - start).count();
+    printf("Argon2%s m=%u KiB p=%u: %u requests, %s%.1f/s offered, %.1f/s completed\n",
+            type.c_str(), m_cost, threads, count,
+            (rate > 0) ? "" : "closed loop, ", rate, count / wall_s);
+    const double percentiles[7] = {50, 90, 95, 99, 99.9, 99.99, 100};
+    const char* labels[7] = {"p50", "p90", "p95", "p99", "p99.9", "p99.99", "max"};
+    for (int i = 0; i < 7; ++i) {
+        size_t index = (size_t) (percentiles[i] / 100.0 * count);
+        if (index >= (size_t) count) {
+            index = count - 1;
+        }
+        printf("  %-7s %10.3f ms\n", labels[i], latencies[index]);
+    }
+    return 0;
+}
 
+#if defined(__linux__)
+/* CPU list of one NUMA node, parsed from sysfs ("0-3,8-11" style) */
+static std::vector<uint32_t> NodeCpus(uint32_t node) {
+    std::vector<uint32_t> cpus;
+    char path[96];
+    snprintf(path, sizeof (path), "/sys/devices/system/node/node%u/cpulist", node);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return cpus;
+    }
+    char list[512] = {0};
+    if (fgets(list, sizeof (list), f) == NULL) {
+        fclose(f);
+        return cpus;
+    }
+    fclose(f);
+    char* cursor = list;
+    while (*cursor != '\0' && *cursor != '\n') {
+        unsigned lo = 0, hi = 0;
+        int consumed = 0;
+        if (sscanf(cursor, "%u-%u%n", &lo, &hi, &consumed) == 2) {
+            for (unsigned c = lo; c <= hi; ++c) {
+                cpus.push_back(c);
+            }
+        } else if (sscanf(cursor, "%u%n", &lo, &consumed) == 1) {
+            cpus.push_back(lo);
+        } else {
+            break;
+        }
+        cursor += consumed;
+        if (*cursor == ',') {
+            ++cursor;
+        }
+    }
+    return cpus;
+}
+
+/*
+ * NUMA scaling mode: measures the fill under explicit lane placement.
+ * Memory follows the lanes - PlaceMemoryByLane() prefaults each lane stripe
+ * on its pinned worker, so first touch puts the pages where the lanes run:
+ *   local        lanes and memory on one node (the per-socket baseline)
+ *   interleave   lanes round-robin across nodes (halves of the array on
+ *                each node, cross-node refs pay the link)
+ *   remote       arena pages first-touched on node 0, lanes then run on
+ *                node 1 - every access crosses the link (the worst case a
+ *                placement bug produces)
+ * Reports fill bandwidth per policy. Needs >= 2 nodes for interleave and
+ * remote; a single-node host runs local only.
+ */
+static int RunNumaMode(uint32_t t_cost, uint32_t m_cost, uint32_t lanes, uint32_t reps) {
+    std::vector<std::vector<uint32_t> > nodes;
+    for (uint32_t n = 0;; ++n) {
+        std::vector<uint32_t> cpus = NodeCpus(n);
+        if (cpus.empty()) {
+            break;
+        }
+        nodes.push_back(cpus);
+    }
+    if (nodes.empty()) {
+        fprintf(stderr, "no NUMA topology exposed under /sys/devices/system/node\n");
+        return 1;
+    }
+    printf("NUMA nodes: %zu, lanes: %u, m_cost: %u KiB, t_cost: %u\n",
+            nodes.size(), lanes, m_cost, t_cost);
+    if (lanes < 2) {
+        // Single-lane hashes run in the caller's thread and the affinity
+        // array is ignored (see Argon2_Context): nothing would be pinned and
+        // every policy row would silently measure the same unplaced run.
+        fprintf(stderr, "-numa needs at least 2 lanes to pin placement; use -p 2 or wider\n");
+        return 1;
+    }
+
+    const uint32_t inlen = 16;
+    const unsigned outlen = 16;
+    unsigned char out[outlen], pwd_array[inlen], salt_array[inlen];
     memset(pwd_array, 0, inlen);
     memset(salt_array, 1, inlen);
-    std::vector<uint32_t> thread_test = {1, 2, 4, 6, 8, 16};
-
-    for (uint32_t m_cost = (uint32_t) 1 << 18; m_cost <= (uint32_t) 1 << 22; m_cost *= 2) {
-        for (uint32_t thread_n : thread_test) {
-
-            uint64_t start_cycles, stop_cycles, stop_cycles_i, stop_cycles_di, stop_cycles_ds;
-          
-            clock_t start_time = clock();
-            start_cycles = rdtsc();
-
-            Argon2_Context context(out, outlen, pwd_array, inlen, salt_array, inlen, NULL, 0, NULL, 0, 
-                    t_cost, m_cost, thread_n, thread_n,NULL,NULL,false,false, false,false);
-            Argon2d(&context);
-            stop_cycles = rdtsc();
-            Argon2i(&context);
-            stop_cycles_i = rdtsc();
-            Argon2id(&context);
-            stop_cycles_di = rdtsc();
-            Argon2ds(&context);
-            stop_cycles_ds = rdtsc();
-            clock_t stop_time = clock();
-
-            uint64_t delta_d = (stop_cycles - start_cycles) / (m_cost);
-            uint64_t delta_i = (stop_cycles_i - stop_cycles) / (m_cost);
-            uint64_t delta_id = (stop_cycles_di - stop_cycles_i) / m_cost;
-            uint64_t delta_ds = (stop_cycles_ds - stop_cycles_di) / m_cost;
-            float mcycles_d = (float) (stop_cycles - start_cycles) / (1 << 20);
-            float mcycles_i = (float) (stop_cycles_i - stop_cycles) / (1 << 20);
-            float mcycles_id = (float) (stop_cycles_di - stop_cycles_i) / (1 << 20);
-            float mcycles_ds = (float) (stop_cycles_ds - stop_cycles_di) / (1 << 20);
-            printf("Argon2d %d pass(es)  %d Mbytes %d lanes/threads:  %2.2f cpb %2.2f Mcycles \n", t_cost, m_cost >> 10, thread_n, (float) delta_d / 1024, mcycles_d);
-            printf("Argon2i %d pass(es)  %d Mbytes %d lanes/threads:  %2.2f cpb %2.2f Mcycles \n", t_cost, m_cost >> 10, thread_n, (float) delta_i / 1024, mcycles_i);
-            printf("Argon2id %d pass(es)  %d Mbytes %d lanes/threads:  %2.2f cpb %2.2f Mcycles \n", t_cost, m_cost >> 10, thread_n, (float) delta_id / 1024, mcycles_id);
-            printf("Argon2ds %d pass(es)  %d Mbytes %d lanes/threads:  %2.2f cpb %2.2f Mcycles \n", t_cost, m_cost >> 10, thread_n, (float) delta_ds / 1024, mcycles_ds);
-
-            float run_time = ((float) stop_time - start_time) / (CLOCKS_PER_SEC);
-            printf("%2.4f seconds\n\n", run_time);
-        }
-    }
-}
-
-
-int main() {
-    Benchmark();
+    double bytes = (double) m_cost * 1024.0 * t_cost;
+
+    struct Policy {
+        const char* name;
+        int first_touch_node; //-1: same as run placement
+        int run_node; //-1: interleave across all nodes
+    };
+    std::vector<Policy> policies;
+    Policy local = {"local", -1, 0};
+    policies.push_back(local);
+    if (nodes.size() > 1) {
+        Policy interleave = {"interleave", -1, -1};
+        Policy remote = {"remote", 0, 1};
+        policies.push_back(interleave);
+        policies.push_back(remote);
+    }
+
+    for (size_t pi = 0; pi < policies.size(); ++pi) {
+        const Policy& policy = policies[pi];
+        std::vector<uint32_t> affinity(lanes);
+        for (uint32_t l = 0; l < lanes; ++l) {
+            const std::vector<uint32_t>& cpus = (policy.run_node >= 0)
+                    ? nodes[policy.run_node] : nodes[l % nodes.size()];
+            affinity[l] = cpus[(policy.run_node >= 0 ? l : l / nodes.size()) % cpus.size()];
+        }
+        Argon2_Arena arena;
+        if (policy.first_touch_node >= 0) {
+            // Warm the arena with the pages first-touched on the other node
+            std::vector<uint32_t> touch(lanes);
+            for (uint32_t l = 0; l < lanes; ++l) {
+                touch[l] = nodes[policy.first_touch_node][l % nodes[policy.first_touch_node].size()];
+            }
+            Argon2_Context warm(out, outlen, pwd_array, inlen, salt_array, inlen,
+                    NULL, 0, NULL, 0, t_cost, m_cost, lanes, lanes, NULL, NULL,
+                    false, false, false, false, &touch[0], lanes, NULL,
+                    ARGON2_PRIORITY_INTERACTIVE, NULL, NULL, &arena);
+            Argon2d(&warm);
+        }
+        std::vector<double> millis;
+        for (uint32_t r = 0; r < reps + 1; ++r) {
+            Argon2_Context context(out, outlen, pwd_array, inlen, salt_array, inlen,
+                    NULL, 0, NULL, 0, t_cost, m_cost, lanes, lanes, NULL, NULL,
+                    false, false, false, false, &affinity[0], lanes, NULL,
+                    ARGON2_PRIORITY_INTERACTIVE, NULL, NULL, &arena);
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            int result = Argon2d(&context);
+            double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - t0).count();
+            if (ARGON2_OK != result) {
+                fprintf(stderr, "%s failed: %s\n", policy.name, ErrorMessage(result));
+                return 1;
+            }
+            if (r > 0) { //first rep places/warms the arena
+                millis.push_back(ms);
+            }
+        }
+        double med = Median(millis);
+        printf("  %-11s %8.3f ms   %7.2f GB/s fill\n",
+                policy.name, med, bytes / (med / 1000.0) / 1e9);
+    }
+    return 0;
+}
+#endif
+
+static void Usage(const char* name) {
+    printf("Usage: %s [options]\n", name);
+    printf("  -types d,i,id,ds     Argon2 variants to benchmark\n");
+    printf("  -m 262144,524288     m_cost grid in KiB\n");
+    printf("  -p 1,2,4             lanes/threads grid\n");
+    printf("  -t 1                 t_cost (passes)\n");
+    printf("  -reps 5              measured repetitions per configuration\n");
+    printf("  -warmup 1            discarded warmup iterations\n");
+    printf("  -latency             open-loop latency-distribution mode (full percentiles)\n");
+    printf("  -numa                lane-placement scaling mode (local/interleave/remote)\n");
+    printf("  -count 1000          requests per configuration in -latency mode\n");
+    printf("  -rate 100            offered request rate per second (0 = closed loop)\n");
+    printf("  -perf                sample LLC/dTLB misses, stalled cycles, page faults\n");
+    printf("                       (Linux; calling thread only - exact for -p 1)\n");
+    printf("  -csv | -json         machine-readable output (default: table)\n");
+    printf("  -record FILE         store this run's medians as the named baseline\n");
+    printf("  -check FILE          compare against the stored baseline; nonzero exit\n");
+    printf("                       and a report when a configuration regressed\n");
+    printf("  -name LABEL          baseline label for -record/-check (default: default)\n");
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> types;
+    types.push_back("d");
+    types.push_back("i");
+    types.push_back("id");
+    types.push_back("ds");
+    std::vector<uint32_t> m_costs;
+    for (uint32_t m = (uint32_t) 1 << 18; m <= (uint32_t) 1 << 22; m *= 2) {
+        m_costs.push_back(m); //the historical 256 MB - 4 GB sweep
+    }
+    std::vector<uint32_t> threads;
+    uint32_t thread_defaults[6] = {1, 2, 4, 6, 8, 16};
+    threads.assign(thread_defaults, thread_defaults + 6);
+    uint32_t t_cost = 1;
+    uint32_t reps = 5;
+    uint32_t warmup = 1;
+    bool with_perf = false;
+    const char* record_path = NULL;
+    const char* check_path = NULL;
+    const char* baseline_label = "default";
+    bool latency_mode = false;
+    bool numa_mode = false;
+    uint32_t latency_count = 1000;
+    double latency_rate = 0;
+    BenchOutput output = BENCH_TABLE;
+
+    for (int i = 1; i < argc; ++i) {
+        if (0 == strcmp(argv[i], "-types") && i + 1 < argc) {
+            types = ParseTypes(argv[++i]);
+        } else if (0 == strcmp(argv[i], "-m") && i + 1 < argc) {
+            m_costs = ParseList(argv[++i]);
+        } else if (0 == strcmp(argv[i], "-p") && i + 1 < argc) {
+            threads = ParseList(argv[++i]);
+        } else if (0 == strcmp(argv[i], "-t") && i + 1 < argc) {
+            t_cost = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "-reps") && i + 1 < argc) {
+            reps = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "-warmup") && i + 1 < argc) {
+            warmup = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "-perf")) {
+            with_perf = true;
+        } else if (0 == strcmp(argv[i], "-latency")) {
+            latency_mode = true;
+        } else if (0 == strcmp(argv[i], "-numa")) {
+            numa_mode = true;
+        } else if (0 == strcmp(argv[i], "-count") && i + 1 < argc) {
+            latency_count = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "-rate") && i + 1 < argc) {
+            latency_rate = strtod(argv[++i], NULL);
+        } else if (0 == strcmp(argv[i], "-record") && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (0 == strcmp(argv[i], "-check") && i + 1 < argc) {
+            check_path = argv[++i];
+        } else if (0 == strcmp(argv[i], "-name") && i + 1 < argc) {
+            baseline_label = argv[++i];
+        } else if (0 == strcmp(argv[i], "-csv")) {
+            output = BENCH_CSV;
+        } else if (0 == strcmp(argv[i], "-json")) {
+            output = BENCH_JSON;
+        } else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (reps == 0) {
+        reps = 1;
+    }
+    if (numa_mode) {
+#if defined(__linux__)
+        int failures = 0;
+        for (size_t mi = 0; mi < m_costs.size(); ++mi) {
+            for (size_t pi = 0; pi < threads.size(); ++pi) {
+                failures += RunNumaMode(t_cost, m_costs[mi], threads[pi], reps);
+            }
+        }
+        return (failures == 0) ? ARGON2_OK : 1;
+#else
+        fprintf(stderr, "-numa requires Linux sysfs topology\n");
+        return 1;
+#endif
+    }
+    if (latency_mode) {
+        if (latency_count == 0) {
+            latency_count = 1;
+        }
+        int failures = 0;
+        for (size_t mi = 0; mi < m_costs.size(); ++mi) {
+            for (size_t pi = 0; pi < threads.size(); ++pi) {
+                for (size_t ti = 0; ti < types.size(); ++ti) {
+                    failures += RunLatencyMode(types[ti], t_cost, m_costs[mi],
+                            threads[pi], latency_count, latency_rate);
+                }
+            }
+        }
+        return (failures == 0) ? ARGON2_OK : 1;
+    }
+
+    if (BENCH_TABLE == output) {
+        printf("timer: %s, %.3f ticks/ns\n", BenchTimerSource(), BenchTicksPerNanosecond());
+    }
+    std::vector<BaselineRow> baselines;
+    if (record_path != NULL || check_path != NULL) {
+        baselines = LoadBaselines(record_path != NULL ? record_path : check_path);
+        if (check_path != NULL && baselines.empty()) {
+            fprintf(stderr, "no baselines in %s - record one first\n", check_path);
+            return 1;
+        }
+    }
+    const std::string machine = MachineKey();
+    uint32_t regressions = 0, missing = 0;
+    bool first = true;
+    for (size_t mi = 0; mi < m_costs.size(); ++mi) {
+        for (size_t pi = 0; pi < threads.size(); ++pi) {
+            for (size_t ti = 0; ti < types.size(); ++ti) {
+                BaselineRow measured;
+                if (!BenchmarkOne(types[ti], t_cost, m_costs[mi], threads[pi],
+                        warmup, reps, output, first, with_perf,
+                        (record_path != NULL || check_path != NULL) ? &measured : NULL)) {
+                    return 1;
+                }
+                first = false;
+                measured.machine = machine;
+                measured.label = baseline_label;
+                if (record_path != NULL) {
+                    BaselineRow* old_row = FindBaseline(baselines, measured);
+                    if (old_row != NULL) {
+                        *old_row = measured;
+                    } else {
+                        baselines.push_back(measured);
+                    }
+                }
+                if (check_path != NULL) {
+                    BaselineRow* base = FindBaseline(baselines, measured);
+                    if (base == NULL) {
+                        printf("  baseline: NEW (no %s/%s row for this configuration)\n",
+                                machine.c_str(), baseline_label);
+                        ++missing;
+                        continue;
+                    }
+                    // Noise band: the shift must clear 4 MADs of whichever
+                    // run was noisier AND a 2% relative floor
+                    double band = 4.0 * ((base->mad_cpb > measured.mad_cpb)
+                            ? base->mad_cpb : measured.mad_cpb);
+                    double floor = 0.02 * base->med_cpb;
+                    double delta = measured.med_cpb - base->med_cpb;
+                    double percent = 100.0 * delta / base->med_cpb;
+                    if (delta > band && delta > floor) {
+                        printf("  baseline: REGRESSION %+.1f%% cpb (%.2f -> %.2f,"
+                                " band %.2f)\n", percent, base->med_cpb,
+                                measured.med_cpb, band);
+                        ++regressions;
+                    } else if (delta < -band && -delta > floor) {
+                        printf("  baseline: improved %+.1f%% cpb (%.2f -> %.2f)\n",
+                                percent, base->med_cpb, measured.med_cpb);
+                    } else {
+                        printf("  baseline: ok %+.1f%% cpb (within noise)\n", percent);
+                    }
+                }
+            }
+        }
+    }
+    if (BENCH_JSON == output) {
+        printf("]\n");
+    }
+    if (record_path != NULL) {
+        if (!SaveBaselines(record_path, baselines)) {
+            return 1;
+        }
+        printf("recorded %zu baseline row(s) to %s (machine %s, label %s)\n",
+                baselines.size(), record_path, machine.c_str(), baseline_label);
+    }
+    if (check_path != NULL) {
+        printf("baseline check: %u regression(s), %u unmatched configuration(s)\n",
+                regressions, missing);
+        if (regressions > 0) {
+            return 2;
+        }
+    }
     return ARGON2_OK;
-}
\ No newline at end of file
+}
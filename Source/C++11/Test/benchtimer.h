@@ -0,0 +1,106 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#ifndef __ARGON2_BENCH_TIMER_H__
+#define __ARGON2_BENCH_TIMER_H__
+
+#include <chrono>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if (defined(__amd64__) || defined(__x86_64__)) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+/*
+ * Portable high-resolution timer for the benchmark tools: one tick source
+ * per architecture (TSC on x86, the generic counter on aarch64, steady_clock
+ * elsewhere), with a calibrated ticks-per-nanosecond ratio so every tool can
+ * report nanoseconds next to raw ticks and the numbers compare across the
+ * fleet. On x86 the invariant-TSC bit is checked - a non-invariant TSC
+ * (pre-Nehalem, some VMs) drifts with frequency scaling and the tools should
+ * say so rather than publish garbage cpb.
+ */
+
+inline uint64_t BenchTicks(void) {
+#if defined(_MSC_VER)
+    return __rdtsc();
+#elif defined(__amd64__) || defined(__x86_64__)
+    uint64_t rax, rdx;
+    __asm__ __volatile__("rdtsc" : "=a"(rax), "=d"(rdx) : :);
+    return (rdx << 32) | rax;
+#elif defined(__aarch64__)
+    uint64_t value;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/* Whether the tick source is safe against frequency scaling */
+inline bool BenchTimerInvariant(void) {
+#if (defined(__amd64__) || defined(__x86_64__)) && !defined(_MSC_VER)
+    static const bool invariant = []() {
+        unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (!__get_cpuid(0x80000007u, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (edx & (1u << 8)) != 0; //invariant-TSC bit
+    }();
+    return invariant;
+#elif defined(_MSC_VER)
+    int regs[4] = {0, 0, 0, 0};
+    __cpuid(regs, (int) 0x80000007u);
+    return (regs[3] & (1 << 8)) != 0;
+#else
+    return true; //cntvct_el0 and steady_clock are constant-rate by contract
+#endif
+}
+
+/* Calibrated tick rate; measured once against steady_clock */
+inline double BenchTicksPerNanosecond(void) {
+#if defined(__aarch64__)
+    static const double rate = []() {
+        uint64_t frequency;
+        __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(frequency));
+        return (double) frequency / 1e9; //architecturally reported, no sampling needed
+    }();
+    return rate;
+#else
+    static const double rate = []() {
+        using namespace std::chrono;
+        steady_clock::time_point wall_start = steady_clock::now();
+        uint64_t tick_start = BenchTicks();
+        // ~20 ms busy window: long enough to drown jitter, short enough to
+        // be paid once per process
+        while (duration_cast<microseconds>(steady_clock::now() - wall_start).count() < 20000) {
+        }
+        uint64_t ticks = BenchTicks() - tick_start;
+        double ns = (double) duration_cast<nanoseconds>(steady_clock::now() - wall_start).count();
+        return (double) ticks / ns;
+    }();
+    return rate;
+#endif
+}
+
+inline const char* BenchTimerSource(void) {
+#if defined(__amd64__) || defined(__x86_64__) || defined(_MSC_VER)
+    return BenchTimerInvariant() ? "tsc (invariant)" : "tsc (NOT invariant - cpb unreliable under frequency scaling)";
+#elif defined(__aarch64__)
+    return "cntvct_el0";
+#else
+    return "steady_clock";
+#endif
+}
+
+#endif
@@ -10,10 +10,153 @@
  */
 
 // #include "kat.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "../Argon2/kat.h"
 
+#if !defined(_WIN32)
+/* mmaps @path read-only; returns NULL and zero length when unavailable */
+static const char* MapFile(const char* path, size_t* length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        *length = 0;
+        return NULL;
+    }
+    void* map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    *length = (size_t) st.st_size;
+    return (const char*) map;
+}
+
+/* Line number and content around @offset, for the divergence report */
+static std::string LineAt(const char* data, size_t length, size_t offset, size_t* line_number) {
+    size_t line = 1;
+    size_t start = 0;
+    for (size_t i = 0; i < offset && i < length; ++i) {
+        if (data[i] == '\n') {
+            ++line;
+            start = i + 1;
+        }
+    }
+    size_t end = start;
+    while (end < length && data[end] != '\n') {
+        ++end;
+    }
+    *line_number = line;
+    return std::string(data + start, end - start);
+}
+
+/*
+ * Generates @type's vectors into a scratch file and compares them against
+ * <golden_dir>/<type>.txt in-process: both files mapped, one memcmp, early
+ * exit with the first divergent line. Replaces a make + diff round trip per
+ * type when validating an optimization patch.
+ */
+static int CheckTypeAgainstGolden(const std::string& golden_dir, const char* type) {
+    std::string scratch = std::string("kat-") + type + ".check";
+    remove(scratch.c_str());
+    SetKatFileOverride(scratch.c_str());
+    GenerateTestVectors(type);
+    SetKatFileOverride(NULL);
+
+    std::string golden_path = golden_dir + "/" + type + ".txt";
+    size_t generated_length = 0, golden_length = 0;
+    const char* generated = MapFile(scratch.c_str(), &generated_length);
+    const char* golden = MapFile(golden_path.c_str(), &golden_length);
+    int result = 1;
+    if (generated == NULL) {
+        printf("%s: FAILED - cannot map generated %s\n", type, scratch.c_str());
+    } else if (golden == NULL) {
+        printf("%s: FAILED - cannot map golden %s\n", type, golden_path.c_str());
+    } else {
+        size_t common = (generated_length < golden_length) ? generated_length : golden_length;
+        size_t offset = common;
+        if (common != 0 && memcmp(generated, golden, common) != 0) {
+            // locate the first differing byte only when there is one
+            for (offset = 0; generated[offset] == golden[offset]; ++offset) {
+            }
+        }
+        if (offset == common && generated_length == golden_length) {
+            printf("%s: OK (%zu bytes)\n", type, golden_length);
+            result = 0;
+            remove(scratch.c_str());
+        } else if (offset == common) {
+            printf("%s: FAILED - lengths differ (generated %zu, golden %zu)\n",
+                    type, generated_length, golden_length);
+        } else {
+            size_t line = 0;
+            std::string got = LineAt(generated, generated_length, offset, &line);
+            std::string want = LineAt(golden, golden_length, offset, &line);
+            printf("%s: FAILED at byte %zu (line %zu)\n  generated: %s\n  golden:    %s\n",
+                    type, offset, line, got.c_str(), want.c_str());
+        }
+    }
+    if (generated != NULL) {
+        munmap((void*) generated, generated_length);
+    }
+    if (golden != NULL) {
+        munmap((void*) golden, golden_length);
+    }
+    return result;
+}
+#endif
+
+/*
+ * "all" regenerates the four per-type logs concurrently (kat-Argon2d.log,
+ * kat-Argon2i.log, ...), one generation per thread with a per-thread KAT file
+ * - the inner loop of validating a kernel change against TestVectors/.
+ * Any other argument generates that single type into the shared
+ * kernel-bound log, as before.
+ */
 int main(int argc, char *argv[]) {
     const char *type = (argc > 1) ? argv[1] : "i";
+#if !defined(_WIN32)
+    if (0 == std::string("check").compare(type)) {
+        // argon2-kat check <TestVectors-dir>: native in-process verification
+        std::string golden_dir = (argc > 2) ? argv[2] : "../../TestVectors";
+        static const char* kat_types[4] = {"Argon2d", "Argon2i", "Argon2id", "Argon2ds"};
+        int failures = 0;
+        for (int i = 0; i < 4; ++i) {
+            failures += CheckTypeAgainstGolden(golden_dir, kat_types[i]);
+        }
+        return (failures == 0) ? ARGON2_OK : 1;
+    }
+#endif
+    if (0 == std::string("all").compare(type)) {
+        static const char* kat_types[4] = {"Argon2d", "Argon2i", "Argon2id", "Argon2ds"};
+        std::vector<std::thread> generators;
+        for (int i = 0; i < 4; ++i) {
+            generators.push_back(std::thread([i]() {
+                std::string file = std::string("kat-") + kat_types[i] + ".log";
+                remove(file.c_str());
+                SetKatFileOverride(file.c_str());
+                GenerateTestVectors(kat_types[i]);
+            }));
+        }
+        for (size_t i = 0; i < generators.size(); ++i) {
+            generators[i].join();
+        }
+        return ARGON2_OK;
+    }
     GenerateTestVectors(type);
     return ARGON2_OK;
 }
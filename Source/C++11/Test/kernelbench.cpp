@@ -0,0 +1,103 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "../Argon2/argon2.h"
+#include "../Argon2/argon2-core.h"
+#include "benchtimer.h"
+
+/*
+ * FillBlock microbenchmark: times the compression function in isolation,
+ * free of scheduling, address generation and allocator effects that
+ * whole-hash numbers fold in. Reports cycles/block for:
+ *   hot   - prev/ref/next resident in L1, the pure-compute ceiling
+ *   cold  - ref blocks strided through an LLC-busting array, the
+ *           bandwidth-limited floor the real fill runs between
+ * each with and without the Argon2ds S-box chain. The kernel under test is
+ * the runtime-dispatched one; set ARGON2_KERNEL=ref|sse|avx2|avx512 and
+ * rerun to compare (single-percent kernel regressions show here that
+ * whole-hash noise swallows).
+ */
+
+static const uint32_t COLD_BLOCKS = 1 << 18; //256 MB, well past any LLC
+
+static double BenchHot(uint32_t iterations, const uint64_t* sbox) {
+    block prev(1), ref(2), next;
+    uint64_t start = BenchTicks();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        FillOneBlock(&prev, &ref, &next, sbox);
+        prev = next; //serialize: the chain is the honest latency
+    }
+    uint64_t cycles = BenchTicks() - start;
+    return (double) cycles / iterations;
+}
+
+static double BenchCold(block* arena, uint32_t iterations, const uint64_t* sbox) {
+    block prev(1), next;
+    // Large-stride walk: consecutive refs land in different pages and ways,
+    // like the data-dependent walk of a multi-GB instance
+    uint32_t index = 0;
+    uint64_t start = BenchTicks();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        index = (index + 9973) & (COLD_BLOCKS - 1); //odd stride, full period
+        FillOneBlock(&prev, &arena[index], &next, sbox);
+        prev = next;
+    }
+    uint64_t cycles = BenchTicks() - start;
+    return (double) cycles / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t iterations = (argc > 1) ? (uint32_t) strtoul(argv[1], NULL, 10) : 200000;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    printf("kernel: %s, %u iterations per variant, timer: %s (%.3f ticks/ns)\n",
+            Argon2KernelName(), iterations, BenchTimerSource(), BenchTicksPerNanosecond());
+
+    // The Sbox content is irrelevant for timing; pattern-fill it
+    uint64_t* sbox = new uint64_t[ARGON2_SBOX_SIZE];
+    for (uint32_t i = 0; i < ARGON2_SBOX_SIZE; ++i) {
+        sbox[i] = 0x9E3779B97F4A7C15ull * (i + 1);
+    }
+
+    block* arena = NULL;
+    int alloc = AllocateMemory(&arena, COLD_BLOCKS);
+    if (ARGON2_OK != alloc) {
+        fprintf(stderr, "cold arena allocation failed: %s\n", ErrorMessage(alloc));
+        delete[] sbox;
+        return 1;
+    }
+    memset(arena, 3, (size_t) COLD_BLOCKS * ARGON2_BLOCK_SIZE); //fault it in
+
+    BenchHot(iterations / 10 + 1, NULL); //warmup
+    double hot = BenchHot(iterations, NULL);
+    double hot_sbox = BenchHot(iterations, sbox);
+    double cold = BenchCold(arena, iterations, NULL);
+    double cold_sbox = BenchCold(arena, iterations, sbox);
+
+    double per_ns = BenchTicksPerNanosecond();
+    printf("hot   (L1-resident ref):      %8.1f ticks/block (%7.1f ns)   %8.1f with Sbox\n",
+            hot, hot / per_ns, hot_sbox);
+    printf("cold  (256 MB strided refs):  %8.1f ticks/block (%7.1f ns)   %8.1f with Sbox\n",
+            cold, cold / per_ns, cold_sbox);
+
+    FreeMemory(arena);
+    delete[] sbox;
+    return ARGON2_OK;
+}
@@ -0,0 +1,112 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <vector>
+
+#include "../Argon2/argon2.h"
+#include "../Argon2/argon2-core.h"
+
+/*
+ * Reference-distance histogram: derives the data-independent address stream
+ * (the one Argon2i and the first half of Argon2id actually execute) from the
+ * parameters alone via PrimeSegmentAddresses() and histograms the distance
+ * between each block and its reference in log2 buckets, per pass. The
+ * cumulative share under a cache-size threshold answers directly whether
+ * references at a parameter point hit LLC-resident recent blocks or cold
+ * DRAM - which is what decides if prefetch and non-temporal stores pay off
+ * at 64 MB vs 1 GB. Argon2d's stream is data-dependent and cannot be derived
+ * without running the hash; its IndexAlpha mapping is the same, so the
+ * Argon2i profile is the planning proxy.
+ */
+
+int main(int argc, char* argv[]) {
+    uint32_t m_cost = (argc > 1) ? (uint32_t) strtoul(argv[1], NULL, 10) : 65536;
+    uint32_t lanes = (argc > 2) ? (uint32_t) strtoul(argv[2], NULL, 10) : 1;
+    uint32_t t_cost = (argc > 3) ? (uint32_t) strtoul(argv[3], NULL, 10) : 1;
+    uint32_t llc_kib = (argc > 4) ? (uint32_t) strtoul(argv[4], NULL, 10) : 32768;
+    if (lanes == 0) {
+        lanes = 1;
+    }
+    if (t_cost == 0) {
+        t_cost = 1;
+    }
+
+    uint32_t memory_blocks = m_cost;
+    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * lanes) {
+        memory_blocks = 2 * ARGON2_SYNC_POINTS * lanes;
+    }
+    uint32_t segment_length = memory_blocks / (lanes * ARGON2_SYNC_POINTS);
+    memory_blocks = segment_length * (lanes * ARGON2_SYNC_POINTS);
+
+    printf("m_cost %u KiB (%u blocks), %u lanes, %u passes; LLC threshold %u KiB\n",
+            m_cost, memory_blocks, lanes, t_cost, llc_kib);
+
+    // Geometry-only instance; address generation never touches block memory
+    Argon2_instance_t instance(NULL, Argon2_i, t_cost, memory_blocks, lanes, 1, false);
+
+    std::vector<uint32_t> offsets(segment_length);
+    const uint32_t kBuckets = 33; //log2 of distance in blocks, 0..32
+    for (uint32_t pass = 0; pass < t_cost; ++pass) {
+        uint64_t histogram[kBuckets];
+        memset(histogram, 0, sizeof (histogram));
+        uint64_t total = 0;
+        uint64_t within_llc = 0;
+        uint64_t llc_blocks = (uint64_t) llc_kib; //1 KiB per block
+        for (uint8_t slice = 0; slice < ARGON2_SYNC_POINTS; ++slice) {
+            for (uint32_t lane = 0; lane < lanes; ++lane) {
+                PrimeSegmentAddresses(&instance,
+                        Argon2_position_t(pass, lane, slice, 0), &offsets[0]);
+                uint32_t start = (pass == 0 && slice == 0) ? 2 : 0;
+                uint32_t base = lane * instance.lane_length
+                        + (uint32_t) slice * segment_length;
+                for (uint32_t i = start; i < segment_length; ++i) {
+                    uint64_t current = base + i;
+                    uint64_t reference = offsets[i];
+                    uint64_t distance = (current > reference)
+                            ? current - reference : reference - current;
+                    uint32_t bucket = 0;
+                    while ((1ull << (bucket + 1)) <= distance && bucket + 1 < kBuckets - 1) {
+                        ++bucket;
+                    }
+                    if (distance == 0) {
+                        bucket = 0;
+                    }
+                    ++histogram[bucket];
+                    ++total;
+                    if (distance <= llc_blocks) {
+                        ++within_llc;
+                    }
+                }
+            }
+        }
+        printf("pass %u: %llu references, %.1f%% within %u KiB of the current block\n",
+                pass, (unsigned long long) total,
+                100.0 * within_llc / (total ? total : 1), llc_kib);
+        for (uint32_t b = 0; b < kBuckets; ++b) {
+            if (histogram[b] == 0) {
+                continue;
+            }
+            double share = 100.0 * histogram[b] / total;
+            printf("  2^%-2u blocks (%7.1f MiB): %6.2f%% ", b,
+                    (double) (1ull << b) / 1024.0, share);
+            int bars = (int) (share / 2.0 + 0.5);
+            for (int x = 0; x < bars; ++x) {
+                putchar('#');
+            }
+            putchar('\n');
+        }
+    }
+    return ARGON2_OK;
+}
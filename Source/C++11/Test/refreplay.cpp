@@ -0,0 +1,224 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <chrono>
+#include <vector>
+
+#include "../Argon2/argon2.h"
+#include "../Argon2/argon2-core.h"
+
+/*
+ * Reference-stream record and replay:
+ *
+ *   argon2-refreplay record <file> [m_cost] [lanes] [t_cost]
+ *       derives the data-independent reference stream (the Argon2i/first-half
+ *       Argon2id pattern) and writes it delta-encoded: positions are implicit
+ *       in fill order, so only the zigzag-varint distance to each reference
+ *       is stored (~2 bytes per block instead of 8).
+ *
+ *   argon2-refreplay replay <file> [reps]
+ *       re-executes just the memory-access pattern against an allocated
+ *       array - prev and ref are read, the current block is written as their
+ *       XOR, no BlaMka - and reports the achieved bandwidth. The delta
+ *       against a real hash of the same parameters separates memory-system
+ *       time from compute time, so layout experiments (huge pages,
+ *       interleaving) evaluate in seconds instead of full-hash benchmarks.
+ */
+
+static const char REPLAY_MAGIC[8] = {'A', 'r', 'g', 'o', 'n', 'R', 'S', '1'};
+
+static void PutVarint(FILE* f, uint64_t value) {
+    while (value >= 0x80) {
+        fputc((int) (value | 0x80) & 0xFF, f);
+        value >>= 7;
+    }
+    fputc((int) value, f);
+}
+
+static uint64_t GetVarint(const uint8_t*& cursor, const uint8_t* end) {
+    uint64_t value = 0;
+    uint32_t shift = 0;
+    while (cursor < end) {
+        uint8_t byte = *cursor++;
+        value |= (uint64_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
+
+static uint64_t Zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t Unzigzag(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+static int Record(const char* path, uint32_t m_cost, uint32_t lanes, uint32_t t_cost) {
+    uint32_t memory_blocks = m_cost;
+    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * lanes) {
+        memory_blocks = 2 * ARGON2_SYNC_POINTS * lanes;
+    }
+    uint32_t segment_length = memory_blocks / (lanes * ARGON2_SYNC_POINTS);
+    memory_blocks = segment_length * (lanes * ARGON2_SYNC_POINTS);
+
+    Argon2_instance_t instance(NULL, Argon2_i, t_cost, memory_blocks, lanes, 1, false);
+
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    uint8_t header[8 + 3 * 4];
+    memcpy(header, REPLAY_MAGIC, 8);
+    memcpy(header + 8, &memory_blocks, 4);
+    memcpy(header + 12, &lanes, 4);
+    memcpy(header + 16, &t_cost, 4);
+    fwrite(header, sizeof (header), 1, f);
+
+    std::vector<uint32_t> offsets(segment_length);
+    uint64_t references = 0;
+    for (uint32_t pass = 0; pass < t_cost; ++pass) {
+        for (uint8_t slice = 0; slice < ARGON2_SYNC_POINTS; ++slice) {
+            for (uint32_t lane = 0; lane < lanes; ++lane) {
+                PrimeSegmentAddresses(&instance,
+                        Argon2_position_t(pass, lane, slice, 0), &offsets[0]);
+                uint32_t start = (pass == 0 && slice == 0) ? 2 : 0;
+                uint32_t base = lane * instance.lane_length
+                        + (uint32_t) slice * segment_length;
+                for (uint32_t i = start; i < segment_length; ++i) {
+                    int64_t delta = (int64_t) (base + i) - (int64_t) offsets[i];
+                    PutVarint(f, Zigzag(delta));
+                    ++references;
+                }
+            }
+        }
+    }
+    long bytes = ftell(f);
+    fclose(f);
+    printf("recorded %llu references, %ld bytes (%.2f bytes/reference)\n",
+            (unsigned long long) references, bytes, (double) bytes / references);
+    return 0;
+}
+
+static int Replay(const char* path, uint32_t reps) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    std::vector<uint8_t> data((size_t) size);
+    if (size < (long) (8 + 12) || fread(&data[0], (size_t) size, 1, f) != 1
+            || memcmp(&data[0], REPLAY_MAGIC, 8) != 0) {
+        fprintf(stderr, "not a reference-stream file\n");
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+    uint32_t memory_blocks, lanes, t_cost;
+    memcpy(&memory_blocks, &data[8], 4);
+    memcpy(&lanes, &data[12], 4);
+    memcpy(&t_cost, &data[16], 4);
+    if (lanes == 0 || t_cost == 0 || memory_blocks == 0
+            || memory_blocks % (lanes * ARGON2_SYNC_POINTS) != 0
+            || memory_blocks > (uint32_t) 1 << 24 /*16 GB cap for a replay tool*/) {
+        fprintf(stderr, "implausible geometry in %s\n", path);
+        return 1;
+    }
+    uint32_t lane_length = memory_blocks / lanes;
+    uint32_t segment_length = lane_length / ARGON2_SYNC_POINTS;
+
+    block* memory = NULL;
+    int alloc = AllocateMemory(&memory, memory_blocks);
+    if (ARGON2_OK != alloc) {
+        fprintf(stderr, "allocation failed: %s\n", ErrorMessage(alloc));
+        return 1;
+    }
+    memset(memory, 1, (size_t) memory_blocks * ARGON2_BLOCK_SIZE);
+
+    printf("replaying %u blocks x %u passes x %u reps (%u lanes)\n",
+            memory_blocks, t_cost, reps, lanes);
+    double best_ms = 0;
+    for (uint32_t rep = 0; rep < reps; ++rep) {
+        const uint8_t* cursor = &data[8 + 12];
+        const uint8_t* end = &data[0] + data.size();
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        for (uint32_t pass = 0; pass < t_cost; ++pass) {
+            for (uint8_t slice = 0; slice < ARGON2_SYNC_POINTS; ++slice) {
+                for (uint32_t lane = 0; lane < lanes; ++lane) {
+                    uint32_t start = (pass == 0 && slice == 0) ? 2 : 0;
+                    uint32_t base = lane * lane_length + (uint32_t) slice * segment_length;
+                    for (uint32_t i = start; i < segment_length; ++i) {
+                        uint32_t current = base + i;
+                        int64_t decoded = (int64_t) current
+                                - Unzigzag(GetVarint(cursor, end));
+                        // Corrupt or truncated streams must not index out of
+                        // the array; fall back to the previous block
+                        uint32_t reference = (decoded >= 0 && decoded < (int64_t) memory_blocks
+                                && decoded != (int64_t) current)
+                                ? (uint32_t) decoded
+                                : (current != 0 ? current - 1 : 0);
+                        uint32_t previous = (current % lane_length != 0)
+                                ? current - 1 : current + lane_length - 1;
+                        // The fill's memory traffic without its compute
+                        block::XorInto(memory[previous], memory[reference], memory[current]);
+                    }
+                }
+            }
+        }
+        double ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - t0).count();
+        if (best_ms == 0 || ms < best_ms) {
+            best_ms = ms;
+        }
+    }
+    // Read prev + read ref + write curr = 3 KB of traffic per block
+    double bytes = (double) memory_blocks * t_cost * 3.0 * ARGON2_BLOCK_SIZE;
+    printf("memory pattern: %.3f ms best, %.2f GB/s effective\n",
+            best_ms, bytes / (best_ms / 1000.0) / 1e9);
+    FreeMemory(memory);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && 0 == strcmp(argv[1], "record")) {
+        uint32_t m_cost = (argc > 3) ? (uint32_t) strtoul(argv[3], NULL, 10) : 65536;
+        uint32_t lanes = (argc > 4) ? (uint32_t) strtoul(argv[4], NULL, 10) : 1;
+        uint32_t t_cost = (argc > 5) ? (uint32_t) strtoul(argv[5], NULL, 10) : 1;
+        if (lanes == 0) {
+            lanes = 1;
+        }
+        if (t_cost == 0) {
+            t_cost = 1;
+        }
+        return Record(argv[2], m_cost, lanes, t_cost);
+    }
+    if (argc >= 3 && 0 == strcmp(argv[1], "replay")) {
+        uint32_t reps = (argc > 3) ? (uint32_t) strtoul(argv[3], NULL, 10) : 3;
+        if (reps == 0) {
+            reps = 1;
+        }
+        return Replay(argv[2], reps);
+    }
+    printf("Usage: %s record <file> [m_cost_kib] [lanes] [t_cost]\n", argv[0]);
+    printf("       %s replay <file> [reps]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,126 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+
+#include "../Argon2/argon2.h"
+
+/*
+ * Long-lived hashing server: reads one request per line from stdin and
+ * answers on stdout, keeping the worker pool and the memory arena warm across
+ * requests - tooling stops paying process spawn plus a cold multi-MB
+ * allocation per password. Frame it over a unix socket with socat or systemd
+ * socket activation if stdin framing is not enough.
+ *
+ * Protocol (whitespace-separated, one request per line):
+ *   hash <type> <t_cost> <m_cost_kib> <lanes> <password> <salt>
+ *       -> "ok <encoded-hash>" or "err <code> <message>"
+ *   verify <encoded-hash> <password>
+ *       -> "ok", "mismatch" or "err <code> <message>"
+ *   quit
+ * Passwords and salts are taken verbatim (no quoting); this is an internal
+ * tool protocol, not an internet-facing one.
+ */
+
+static uint32_t TypeFromName(const std::string& name) {
+    if (name == "d") return 0;
+    if (name == "i") return 1;
+    if (name == "id") return 2;
+    if (name == "ds") return 4;
+    return (uint32_t) -1;
+}
+
+int main(void) {
+    Argon2_Arena arena; //kept warm for the life of the server
+    char line[4096];
+
+    setvbuf(stdout, NULL, _IOLBF, 0); //line-buffered answers for pipe framing
+
+    while (fgets(line, sizeof (line), stdin) != NULL) {
+        char command[16] = {0};
+        if (sscanf(line, "%15s", command) != 1) {
+            continue; //blank line
+        }
+
+        if (0 == strcmp(command, "quit")) {
+            break;
+        }
+
+        if (0 == strcmp(command, "hash")) {
+            char type_name[8] = {0};
+            unsigned t_cost = 0, m_cost = 0, lanes = 0;
+            char password[1024] = {0};
+            char salt[1024] = {0};
+            if (sscanf(line, "%*s %7s %u %u %u %1023s %1023s",
+                    type_name, &t_cost, &m_cost, &lanes, password, salt) != 6) {
+                printf("err %d malformed hash request\n", ARGON2_INCORRECT_PARAMETER);
+                continue;
+            }
+            uint32_t type = TypeFromName(type_name);
+            if (type == (uint32_t) -1) {
+                printf("err %d unknown type\n", ARGON2_INCORRECT_TYPE);
+                continue;
+            }
+            uint8_t out[32];
+            Argon2_Context context(out, sizeof (out),
+                    (uint8_t*) password, (uint32_t) strlen(password),
+                    (uint8_t*) salt, (uint32_t) strlen(salt),
+                    NULL, 0, NULL, 0,
+                    t_cost, m_cost, lanes, lanes,
+                    NULL, NULL, false, false, false, false,
+                    NULL, 0, NULL, ARGON2_PRIORITY_INTERACTIVE, NULL, NULL, &arena);
+            int result;
+            switch (type) {
+                case 0: result = Argon2d(&context); break;
+                case 1: result = Argon2i(&context); break;
+                case 2: result = Argon2id(&context); break;
+                default: result = Argon2ds(&context); break;
+            }
+            if (ARGON2_OK != result) {
+                printf("err %d %s\n", result, ErrorMessage(result));
+                continue;
+            }
+            char encoded[512];
+            result = Argon2EncodeHash(encoded, sizeof (encoded), &context, type);
+            if (ARGON2_OK != result) {
+                printf("err %d %s\n", result, ErrorMessage(result));
+                continue;
+            }
+            printf("ok %s\n", encoded);
+            continue;
+        }
+
+        if (0 == strcmp(command, "verify")) {
+            char encoded[512] = {0};
+            char password[1024] = {0};
+            if (sscanf(line, "%*s %511s %1023s", encoded, password) != 2) {
+                printf("err %d malformed verify request\n", ARGON2_INCORRECT_PARAMETER);
+                continue;
+            }
+            int result = Argon2VerifyEncoded(encoded, password, strlen(password));
+            if (ARGON2_OK == result) {
+                printf("ok\n");
+            } else if (ARGON2_VERIFY_MISMATCH == result) {
+                printf("mismatch\n");
+            } else {
+                printf("err %d %s\n", result, ErrorMessage(result));
+            }
+            continue;
+        }
+
+        printf("err %d unknown command\n", ARGON2_INCORRECT_PARAMETER);
+    }
+
+    return 0;
+}
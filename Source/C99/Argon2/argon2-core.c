@@ -29,6 +29,7 @@
 
 #include "argon2.h"
 #include "argon2-core.h"
+#include "argon2-threads.h"
 #include "kat.h"
 
 
@@ -235,47 +236,18 @@ void FillMemoryBlocks(Argon2_instance_t* instance) {
             GenerateSbox(instance);
         }
         for (uint8_t s = 0; s < ARGON2_SYNC_POINTS; ++s) {
-            //1. Allocating space for threads
-            pthread_t* thread = malloc(sizeof(pthread_t)*(instance->lanes));
-            Argon2_thread_data* thr_data = malloc(sizeof(Argon2_thread_data)*(instance->lanes));
-            pthread_attr_t attr;
-            int rc;
-            void* status;
-            pthread_attr_init(&attr);
-            pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_JOINABLE);
-
-            //2. Calling threads 
-            for (uint32_t l = 0; l < instance->lanes; ++l) {
-                //2.1 Join a thread if limit is exceeded
-                if(l>=instance->threads){
-                    rc=pthread_join(thread[l-instance->threads],&status);
-                    if (rc) {
-                        printf("ERROR; return code from pthread_join() is %d\n", rc);
-                        exit(-1);
-                    }
-                }
-
-                //2.2 Create thread
-                Argon2_position_t position = {r,l,s,0};
-                thr_data[l].instance_ptr = instance;//preparing the thread input
-                memcpy(&(thr_data[l].pos), &position, sizeof(Argon2_position_t));
-                rc =pthread_create(&thread[l],&attr,FillSegmentThr,(void*)&thr_data[l]);
-
-
-                //FillSegment(instance, position);  //Non-thread equivalent of the lines above
-            }
-
-            //3. Joining remaining threads
-            for (uint32_t l = instance->lanes - instance->threads; l < instance->lanes; ++l) {
-                rc=pthread_join(thread[l],&status);
-                if (rc) {
-                    printf("ERROR; return code from pthread_join() is %d\n", rc);
-                    exit(-1);
+            if (instance->threads <= 1 || instance->lanes <= 1) {
+                // Single-threaded: fill in the caller, no pool round trip
+                for (uint32_t l = 0; l < instance->lanes; ++l) {
+                    Argon2_position_t position = {r, l, s, 0};
+                    FillSegment(instance, position);
                 }
+            } else {
+                // Pooled workers, one batched call per slice: the previous
+                // code paid two mallocs and up to `lanes` pthread_create/join
+                // round trips here, per slice of every pass
+                Argon2PoolFillSlice(instance, r, s);
             }
-            free(thread);
-            pthread_attr_destroy(&attr);
-            free(thr_data);
         }
         if(instance->print_internals){
             InternalKat(instance, r); // Print all memory blocks
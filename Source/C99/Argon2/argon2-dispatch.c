@@ -0,0 +1,86 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "argon2.h"
+#include "argon2-core.h"
+
+/*
+ * Runtime kernel dispatch for the optimized build, mirroring the C++11
+ * tree: argon2-opt-core.c is compiled once per instruction-set tier (SSE2
+ * baseline, SSSE3+SSE4.1, AVX) and the best one the CPU supports is bound on
+ * first use - one distro binary built for baseline x86-64 no longer loses
+ * the SSE4.1 rotate loads or AVX on capable hosts, and modern cores get the
+ * 256-bit round (four G functions per instruction).
+ * ARGON2_KERNEL=ssse3|sse41|avx|avx2 forces a tier. (XOP is not tiered: AMD
+ * dropped it and __builtin_cpu_supports cannot probe it portably.)
+ */
+
+void FillSegment_ssse3(const Argon2_instance_t* instance, Argon2_position_t position);
+void GenerateSbox_ssse3(Argon2_instance_t* instance);
+void FillSegment_sse41(const Argon2_instance_t* instance, Argon2_position_t position);
+void GenerateSbox_sse41(Argon2_instance_t* instance);
+void FillSegment_avx(const Argon2_instance_t* instance, Argon2_position_t position);
+void GenerateSbox_avx(Argon2_instance_t* instance);
+void FillSegment_avx2(const Argon2_instance_t* instance, Argon2_position_t position);
+void GenerateSbox_avx2(Argon2_instance_t* instance);
+
+const char* ARGON2_KAT_FILENAME = "kat-argon2-opt.log";
+
+typedef struct Argon2_kernel_ {
+    const char* name;
+    void (*fill_segment)(const Argon2_instance_t*, Argon2_position_t);
+    void (*generate_sbox)(Argon2_instance_t*);
+} Argon2_kernel;
+
+static const Argon2_kernel kernel_ssse3 = {"ssse3", &FillSegment_ssse3, &GenerateSbox_ssse3};
+static const Argon2_kernel kernel_sse41 = {"sse41", &FillSegment_sse41, &GenerateSbox_sse41};
+static const Argon2_kernel kernel_avx = {"avx", &FillSegment_avx, &GenerateSbox_avx};
+static const Argon2_kernel kernel_avx2 = {"avx2", &FillSegment_avx2, &GenerateSbox_avx2};
+
+static const Argon2_kernel* selected_kernel = NULL;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static void SelectKernel(void) {
+    const Argon2_kernel* chosen = &kernel_ssse3;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if (__builtin_cpu_supports("avx2")) {
+        chosen = &kernel_avx2;
+    } else if (__builtin_cpu_supports("avx")) {
+        chosen = &kernel_avx;
+    } else if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3")) {
+        chosen = &kernel_sse41;
+    }
+#endif
+    const char* forced = getenv("ARGON2_KERNEL");
+    if (forced != NULL) {
+        if (0 == strcmp(forced, "ssse3")) chosen = &kernel_ssse3;
+        if (0 == strcmp(forced, "sse41")) chosen = &kernel_sse41;
+        if (0 == strcmp(forced, "avx")) chosen = &kernel_avx;
+        if (0 == strcmp(forced, "avx2")) chosen = &kernel_avx2;
+    }
+    selected_kernel = chosen;
+}
+
+static const Argon2_kernel* ActiveKernel(void) {
+    pthread_once(&kernel_once, SelectKernel); /* C has no magic statics */
+    return selected_kernel;
+}
+
+void FillSegment(const Argon2_instance_t* instance, Argon2_position_t position) {
+    ActiveKernel()->fill_segment(instance, position);
+}
+
+void GenerateSbox(Argon2_instance_t* instance) {
+    ActiveKernel()->generate_sbox(instance);
+}
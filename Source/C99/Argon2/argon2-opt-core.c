@@ -14,6 +14,22 @@
 #include <string.h>
 #include <stdlib.h>
 
+/*
+ * Runtime kernel tiers: the dispatch build (argon2-dispatch.c) compiles this
+ * translation unit once per instruction-set tier with ARGON2_KERNEL_SUFFIX
+ * set, renaming the exported functions so one binary carries every tier and
+ * picks the best at load. Defined before the headers so their declarations
+ * rename along with the definitions.
+ */
+#ifdef ARGON2_KERNEL_SUFFIX
+#define ARGON2_PASTE2(name, suffix) name##suffix
+#define ARGON2_PASTE(name, suffix) ARGON2_PASTE2(name, suffix)
+#define FillBlock ARGON2_PASTE(FillBlock, ARGON2_KERNEL_SUFFIX)
+#define GenerateAddresses ARGON2_PASTE(GenerateAddresses, ARGON2_KERNEL_SUFFIX)
+#define FillSegment ARGON2_PASTE(FillSegment, ARGON2_KERNEL_SUFFIX)
+#define GenerateSbox ARGON2_PASTE(GenerateSbox, ARGON2_KERNEL_SUFFIX)
+#endif
+
 #if !defined(_MSC_VER)
 #include <x86intrin.h>
 #else
@@ -34,14 +50,78 @@
 #include "../Blake2/blake2.h"
 
 
-/* The KAT file name */
+#ifndef ARGON2_KERNEL_SUFFIX
+/* The KAT file name (the dispatch build defines it once, in the dispatcher) */
 const char* ARGON2_KAT_FILENAME = "kat-argon2-opt.log";
+#endif
 
 
 #define r16  (_mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9))
 #define r24 (_mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10))
 
-__m128i t0, t1;
+/* Round-macro scratch: thread-local, since concurrent FillSegment workers
+ * would otherwise clobber each other's temporaries whenever the optimizer
+ * does not keep these in registers */
+static __thread __m128i t0, t1;
+
+#if defined(__AVX2__)
+#include "../Blake2/blake2-round-mka-avx2.h"
+
+/*
+ * 256-bit FillBlock for the avx2 tier: the 1 KB block is 32 ymm values and
+ * four G functions run per instruction. Unaligned loads/stores against the
+ * caller's 16-byte-aligned state buffer and the malloc'd block array; the
+ * working set lives in registers between them.
+ */
+void FillBlock(__m128i* state128, const uint8_t *ref_block, uint8_t *next_block, const uint64_t* Sbox) {
+    __m256i state[ARGON2_QWORDS_IN_BLOCK / 2];
+    __m256i block_XY[ARGON2_QWORDS_IN_BLOCK / 2];
+    uint8_t* state_bytes = (uint8_t*) state128;
+
+    for (uint32_t i = 0; i < ARGON2_QWORDS_IN_BLOCK / 2; i++) {
+        __m256i loaded_state = _mm256_loadu_si256((const __m256i*) (state_bytes + 32 * i));
+        __m256i loaded_ref = _mm256_loadu_si256((const __m256i*) (ref_block + 32 * i));
+        block_XY[i] = state[i] = _mm256_xor_si256(loaded_state, loaded_ref);
+    }
+
+    uint64_t x = 0;
+    if (Sbox != NULL) {
+        x = *(uint64_t*) block_XY ^ ((uint64_t*) block_XY)[2 * ARGON2_QWORDS_IN_BLOCK - 1];
+        for (int i = 0; i < 6 * 16; ++i) {
+            uint32_t x1 = x >> 32;
+            uint32_t x2 = x & 0xFFFFFFFF;
+            uint64_t y = Sbox[x1 & ARGON2_SBOX_MASK];
+            uint64_t z = Sbox[(x2 & ARGON2_SBOX_MASK) + ARGON2_SBOX_SIZE / 2];
+            x = (uint64_t) x1 * (uint64_t) x2;
+            x += y;
+            x ^= z;
+        }
+    }
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        BLAKE2_ROUND_1_AVX2(state[8 * i + 0], state[8 * i + 4], state[8 * i + 1], state[8 * i + 5],
+                state[8 * i + 2], state[8 * i + 6], state[8 * i + 3], state[8 * i + 7]);
+    }
+    for (uint32_t i = 0; i < 4; ++i) {
+        BLAKE2_ROUND_2_AVX2(state[0 + i], state[4 + i], state[8 + i], state[12 + i],
+                state[16 + i], state[20 + i], state[24 + i], state[28 + i]);
+    }
+
+    for (uint32_t i = 0; i < ARGON2_QWORDS_IN_BLOCK / 2; i++) {
+        state[i] = _mm256_xor_si256(state[i], block_XY[i]);
+    }
+    if (Sbox != NULL) {
+        state[0] = _mm256_add_epi64(state[0], _mm256_set_epi64x(0, 0, 0, x));
+        state[ARGON2_QWORDS_IN_BLOCK / 2 - 1] = _mm256_add_epi64(
+                state[ARGON2_QWORDS_IN_BLOCK / 2 - 1], _mm256_set_epi64x(x, 0, 0, 0));
+    }
+    for (uint32_t i = 0; i < ARGON2_QWORDS_IN_BLOCK / 2; i++) {
+        _mm256_storeu_si256((__m256i*) (state_bytes + 32 * i), state[i]);
+        _mm256_storeu_si256((__m256i*) (next_block + 32 * i), state[i]);
+    }
+}
+
+#else /* 128-bit tiers */
 
 void FillBlock(__m128i* state, const uint8_t *ref_block, uint8_t *next_block, const uint64_t* Sbox) {
     __m128i block_XY[ARGON2_QWORDS_IN_BLOCK];
@@ -132,6 +212,8 @@ void FillBlock(__m128i* state, const uint8_t *ref_block, uint8_t *next_block, co
     }
 }
 
+#endif /* __AVX2__ */
+
 void GenerateAddresses(const Argon2_instance_t* instance, const Argon2_position_t* position, uint64_t* pseudo_rands) {
     block zero_block, address_block,input_block;
     InitBlockValue(&zero_block,0);
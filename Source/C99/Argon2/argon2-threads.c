@@ -0,0 +1,117 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "argon2-threads.h"
+
+/*
+ * One batch at a time: FillMemoryBlocks() is the only caller and slices are
+ * serialized by the sync points, so the pool state is a single shared batch
+ * descriptor. Workers pull implicit lane indices from it; at most
+ * batch_limit segments run concurrently, preserving the sliding-window
+ * semantics of the pthread_create/join code this replaces.
+ */
+static pthread_mutex_t batch_owner = PTHREAD_MUTEX_INITIALIZER; /* one batch in flight */
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+
+static uint32_t pool_workers = 0; /* threads alive */
+static Argon2_instance_t* batch_instance = NULL;
+static uint32_t batch_pass = 0;
+static uint8_t batch_slice = 0;
+static uint32_t batch_next_lane = 0; /* next lane index to hand out */
+static uint32_t batch_lanes = 0;
+static uint32_t batch_running = 0;
+static uint32_t batch_remaining = 0; /* segments not yet completed */
+static uint32_t batch_limit = 0;
+
+static void* PoolWorker(void* unused) {
+    (void) unused;
+    pthread_mutex_lock(&pool_mutex);
+    for (;;) {
+        while (batch_instance == NULL || batch_next_lane >= batch_lanes
+                || batch_running >= batch_limit) {
+            pthread_cond_wait(&pool_work, &pool_mutex);
+        }
+        uint32_t lane = batch_next_lane++;
+        ++batch_running;
+        Argon2_instance_t* instance = batch_instance;
+        Argon2_position_t position = {batch_pass, lane, batch_slice, 0};
+        pthread_mutex_unlock(&pool_mutex);
+
+        FillSegment(instance, position);
+
+        pthread_mutex_lock(&pool_mutex);
+        --batch_running;
+        --batch_remaining;
+        if (batch_remaining == 0) {
+            pthread_cond_signal(&pool_done);
+        } else {
+            /* a slot freed up; another worker may take the next lane */
+            pthread_cond_signal(&pool_work);
+        }
+    }
+    return NULL;
+}
+
+static void EnsureWorkers(uint32_t count) {
+    /* caller holds pool_mutex */
+    while (pool_workers < count) {
+        pthread_t worker;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        int rc = pthread_create(&worker, &attr, PoolWorker, NULL);
+        pthread_attr_destroy(&attr);
+        if (rc) {
+            printf("ERROR; return code from pthread_create() is %d\n", rc);
+            exit(-1);
+        }
+        ++pool_workers;
+    }
+}
+
+void Argon2PoolFillSlice(Argon2_instance_t* instance, uint32_t pass, uint8_t slice) {
+    if (instance == NULL || instance->lanes == 0) {
+        return;
+    }
+    uint32_t limit = (instance->threads < instance->lanes)
+            ? instance->threads : instance->lanes;
+    if (limit == 0) {
+        limit = 1;
+    }
+
+    /* Concurrent hashes submit batches one at a time: the descriptor below is
+     * shared, and unlike the per-call thread arrays this replaces, it must
+     * not be written by two submitters at once. Slices of concurrent hashes
+     * interleave at batch granularity. */
+    pthread_mutex_lock(&batch_owner);
+    pthread_mutex_lock(&pool_mutex);
+    EnsureWorkers(limit);
+    batch_instance = instance;
+    batch_pass = pass;
+    batch_slice = slice;
+    batch_next_lane = 0;
+    batch_lanes = instance->lanes;
+    batch_remaining = instance->lanes;
+    batch_running = 0;
+    batch_limit = limit;
+    pthread_cond_broadcast(&pool_work);
+    while (batch_remaining != 0) {
+        pthread_cond_wait(&pool_done, &pool_mutex);
+    }
+    batch_instance = NULL;
+    pthread_mutex_unlock(&pool_mutex);
+    pthread_mutex_unlock(&batch_owner);
+}
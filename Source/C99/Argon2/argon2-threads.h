@@ -0,0 +1,35 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+
+#ifndef __ARGON2_THREADS_H__
+#define __ARGON2_THREADS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "argon2.h"
+#include "argon2-core.h"
+
+/*
+ * Persistent worker pool for the slice fan-out, mirroring the pooled
+ * executor of the C++11 tree: workers are spawned once and reused, and a
+ * slice is one batched call with no per-slice allocation - the previous
+ * FillMemoryBlocks() paid two mallocs and up to `lanes` pthread_create/join
+ * round trips per slice of every pass, which dwarfs the fill work at small
+ * m_cost.
+ *
+ * Runs the segments of one slice on the pool, at most @threads at a time
+ * (lane tasks are implicit indices, so nothing is allocated per call), and
+ * returns when the whole slice is filled. Worker threads are created on
+ * first use and kept for the life of the process.
+ */
+void Argon2PoolFillSlice(Argon2_instance_t* instance, uint32_t pass, uint8_t slice);
+
+#endif
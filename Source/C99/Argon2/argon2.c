@@ -12,7 +12,9 @@
 
 #include "stdint.h" 
 #include "stdbool.h"
+#include <pthread.h>
 #include <string.h>
+#include <stdlib.h>
 #include "stdio.h"
 
 #include "argon2.h"
@@ -150,6 +152,85 @@ int Argon2ds(Argon2_Context* context) {
     return Argon2Core(context, Argon2_ds);
 }
 
+/*
+ * Reused block region for Argon2VerifyBatch: the allocator callbacks carry
+ * no user pointer, so the region is process-global and a mutex serializes
+ * batches. Grown when a larger m_cost comes along, kept for the life of the process.
+ */
+static pthread_mutex_t batch_region_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t* batch_region = NULL;
+static size_t batch_region_bytes = 0;
+
+static int BatchRegionAllocate(uint8_t** memory, size_t bytes_to_allocate) {
+    if (batch_region == NULL || batch_region_bytes < bytes_to_allocate) {
+        free(batch_region);
+        batch_region = malloc(bytes_to_allocate);
+        batch_region_bytes = (batch_region != NULL) ? bytes_to_allocate : 0;
+    }
+    if (batch_region == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    *memory = batch_region;
+    return ARGON2_OK;
+}
+
+static void BatchRegionFree(uint8_t* memory, size_t bytes_to_allocate) {
+    (void) memory; /* kept for the next item */
+    (void) bytes_to_allocate;
+}
+
+/* Data-independent comparison: every byte is examined regardless of where
+ * the first difference sits */
+static int ConstantTimeEquals(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < n; ++i) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+int Argon2VerifyBatch(Argon2_BatchVerifyItem* items, uint32_t count,
+        uint32_t type, uint32_t t_cost, uint32_t m_cost, uint32_t lanes, uint32_t threads) {
+    if (items == NULL) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    int first_error = ARGON2_OK;
+    pthread_mutex_lock(&batch_region_mutex);
+    for (uint32_t i = 0; i < count; ++i) {
+        Argon2_BatchVerifyItem* item = &items[i];
+        uint8_t computed_tag[64];
+        if (item->expected_tag == NULL || item->taglen == 0
+                || item->taglen > sizeof (computed_tag)) {
+            item->result = ARGON2_INCORRECT_PARAMETER;
+        } else {
+            Argon2_Context context = {computed_tag, item->taglen,
+                (uint8_t*) item->pwd, item->pwdlen,
+                item->salt, item->saltlen,
+                NULL, 0, NULL, 0,
+                t_cost, m_cost, lanes, threads,
+                BatchRegionAllocate, BatchRegionFree,
+                false, false, false, false};
+            item->result = Argon2Core(&context, (Argon2_type) type);
+            if (ARGON2_OK == item->result) {
+                item->result = ConstantTimeEquals(computed_tag, item->expected_tag, item->taglen)
+                        ? ARGON2_OK : ARGON2_VERIFY_MISMATCH;
+            }
+            /* volatile pointer so the wipe of the stack tag survives -O3 */
+            {
+                volatile uint8_t* p = computed_tag;
+                for (size_t b = 0; b < sizeof (computed_tag); ++b) {
+                    p[b] = 0;
+                }
+            }
+        }
+        if (ARGON2_OK != item->result && ARGON2_OK == first_error) {
+            first_error = item->result;
+        }
+    }
+    pthread_mutex_unlock(&batch_region_mutex);
+    return first_error;
+}
+
 int VerifyD(Argon2_Context* context, const char *hash) {
     if (0 == context->outlen || NULL == hash) {
         return ARGON2_OUT_PTR_MISMATCH;
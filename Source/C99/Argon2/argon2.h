@@ -116,6 +116,8 @@ typedef enum _Argon2_ErrorCodes {
     ARGON2_THREADS_TOO_FEW = 28,
     ARGON2_THREADS_TOO_MANY = 29,
 
+    ARGON2_VERIFY_MISMATCH = 30, //computed tag differs from the expected one
+
     ARGON2_ERROR_CODES_LENGTH /* Do NOT remove; Do NOT add error codes after this error code */
 } Argon2_ErrorCodes;
 
@@ -244,6 +246,36 @@ extern int Argon2id(Argon2_Context* context);
  */
 extern int VerifyD(Argon2_Context* context, const char *hash);
 
+/*
+ * One credential in a batch verification: hashed with the batch parameters
+ * and compared against @expected_tag in constant time. @result receives the
+ * per-item outcome (ARGON2_OK, ARGON2_VERIFY_MISMATCH, or an error code).
+ */
+typedef struct _Argon2_BatchVerifyItem {
+    const uint8_t* pwd;
+    uint32_t pwdlen;
+    const uint8_t* salt;
+    uint32_t saltlen;
+    const uint8_t* expected_tag;
+    uint32_t taglen;
+    int result;
+} Argon2_BatchVerifyItem;
+
+/*
+ * Verifies a burst of credentials against one parameter set through a single
+ * reused block array: the per-call malloc/free of Initialize() - most of the
+ * hashing cost at m_cost around 16 MB - is paid once for the whole batch.
+ * Tag comparisons are constant-time. Batches serialize against each other
+ * (the reused region is process-global); give concurrent bursts their own
+ * process or accept the queueing.
+ * @param items Array of @count items; per-item outcomes land in item->result
+ * @param type Argon2 type code (0 = d, 1 = i, 2 = id, 4 = ds - the
+ *        Argon2_type enum, which lives in argon2-core.h)
+ * @return ARGON2_OK when every item verified, else the first non-OK result
+ */
+extern int Argon2VerifyBatch(Argon2_BatchVerifyItem* items, uint32_t count,
+        uint32_t type, uint32_t t_cost, uint32_t m_cost, uint32_t lanes, uint32_t threads);
+
 /*
  * Get the associated error message for given error code
  * @return  The error message associated with the given error code
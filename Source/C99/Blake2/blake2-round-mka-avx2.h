@@ -0,0 +1,132 @@
+/*
+ * Argon2 source code package
+ *
+ * This work is licensed under a Creative Commons CC0 1.0 License/Waiver.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication along with
+ * this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+#ifndef __BLAKE2_ROUND_MKA_AVX2_C99_H__
+#define __BLAKE2_ROUND_MKA_AVX2_C99_H__
+
+#include <immintrin.h>
+
+/*
+ * 256-bit BlaMka round: four G functions run per instruction, the 1 KB block
+ * is processed as 32 ymm registers. Rotations by 16/24 go through vpshufb,
+ * 32 through vpshufd, 63 through shift+add.
+ */
+
+#define rotr32_256(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+#define rotr24_256(x) _mm256_shuffle_epi8((x), _mm256_setr_epi8( \
+        3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, \
+        3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10))
+#define rotr16_256(x) _mm256_shuffle_epi8((x), _mm256_setr_epi8( \
+        2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, \
+        2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9))
+#define rotr63_256(x) _mm256_xor_si256(_mm256_srli_epi64((x), 63), _mm256_add_epi64((x), (x)))
+
+/* BlaMka mixing: a + b + 2 * trunc(a) * trunc(b), four lanes at once */
+static inline __m256i fBlaMka256(__m256i x, __m256i y) {
+    const __m256i z = _mm256_mul_epu32(x, y);
+    return _mm256_add_epi64(_mm256_add_epi64(x, y), _mm256_add_epi64(z, z));
+}
+
+#define G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1) \
+    do { \
+        A0 = fBlaMka256(A0, B0); \
+        A1 = fBlaMka256(A1, B1); \
+        D0 = rotr32_256(_mm256_xor_si256(D0, A0)); \
+        D1 = rotr32_256(_mm256_xor_si256(D1, A1)); \
+        C0 = fBlaMka256(C0, D0); \
+        C1 = fBlaMka256(C1, D1); \
+        B0 = rotr24_256(_mm256_xor_si256(B0, C0)); \
+        B1 = rotr24_256(_mm256_xor_si256(B1, C1)); \
+    } while ((void)0, 0)
+
+#define G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1) \
+    do { \
+        A0 = fBlaMka256(A0, B0); \
+        A1 = fBlaMka256(A1, B1); \
+        D0 = rotr16_256(_mm256_xor_si256(D0, A0)); \
+        D1 = rotr16_256(_mm256_xor_si256(D1, A1)); \
+        C0 = fBlaMka256(C0, D0); \
+        C1 = fBlaMka256(C1, D1); \
+        B0 = rotr63_256(_mm256_xor_si256(B0, C0)); \
+        B1 = rotr63_256(_mm256_xor_si256(B1, C1)); \
+    } while ((void)0, 0)
+
+/* Row-major groups: diagonals live within each register, rotate in place */
+#define DIAGONALIZE_1_AVX2(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        B0 = _mm256_permute4x64_epi64(B0, _MM_SHUFFLE(0, 3, 2, 1)); \
+        C0 = _mm256_permute4x64_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2)); \
+        D0 = _mm256_permute4x64_epi64(D0, _MM_SHUFFLE(2, 1, 0, 3)); \
+        B1 = _mm256_permute4x64_epi64(B1, _MM_SHUFFLE(0, 3, 2, 1)); \
+        C1 = _mm256_permute4x64_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2)); \
+        D1 = _mm256_permute4x64_epi64(D1, _MM_SHUFFLE(2, 1, 0, 3)); \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_1_AVX2(A0, B0, C0, D0, A1, B1, C1, D1) \
+    do { \
+        B0 = _mm256_permute4x64_epi64(B0, _MM_SHUFFLE(2, 1, 0, 3)); \
+        C0 = _mm256_permute4x64_epi64(C0, _MM_SHUFFLE(1, 0, 3, 2)); \
+        D0 = _mm256_permute4x64_epi64(D0, _MM_SHUFFLE(0, 3, 2, 1)); \
+        B1 = _mm256_permute4x64_epi64(B1, _MM_SHUFFLE(2, 1, 0, 3)); \
+        C1 = _mm256_permute4x64_epi64(C1, _MM_SHUFFLE(1, 0, 3, 2)); \
+        D1 = _mm256_permute4x64_epi64(D1, _MM_SHUFFLE(0, 3, 2, 1)); \
+    } while ((void)0, 0)
+
+/* Column-major groups: diagonals straddle register pairs, shuffle across */
+#define DIAGONALIZE_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1) \
+    do { \
+        __m256i tmp1 = _mm256_blend_epi32(B0, B1, 0xCC); \
+        __m256i tmp2 = _mm256_blend_epi32(B0, B1, 0x33); \
+        B1 = _mm256_permute4x64_epi64(tmp1, _MM_SHUFFLE(2, 3, 0, 1)); \
+        B0 = _mm256_permute4x64_epi64(tmp2, _MM_SHUFFLE(2, 3, 0, 1)); \
+        tmp1 = C0; \
+        C0 = C1; \
+        C1 = tmp1; \
+        tmp1 = _mm256_blend_epi32(D0, D1, 0xCC); \
+        tmp2 = _mm256_blend_epi32(D0, D1, 0x33); \
+        D0 = _mm256_permute4x64_epi64(tmp1, _MM_SHUFFLE(2, 3, 0, 1)); \
+        D1 = _mm256_permute4x64_epi64(tmp2, _MM_SHUFFLE(2, 3, 0, 1)); \
+    } while ((void)0, 0)
+
+#define UNDIAGONALIZE_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1) \
+    do { \
+        __m256i tmp1 = _mm256_blend_epi32(B0, B1, 0xCC); \
+        __m256i tmp2 = _mm256_blend_epi32(B0, B1, 0x33); \
+        B0 = _mm256_permute4x64_epi64(tmp1, _MM_SHUFFLE(2, 3, 0, 1)); \
+        B1 = _mm256_permute4x64_epi64(tmp2, _MM_SHUFFLE(2, 3, 0, 1)); \
+        tmp1 = C0; \
+        C0 = C1; \
+        C1 = tmp1; \
+        tmp1 = _mm256_blend_epi32(D0, D1, 0xCC); \
+        tmp2 = _mm256_blend_epi32(D0, D1, 0x33); \
+        D1 = _mm256_permute4x64_epi64(tmp1, _MM_SHUFFLE(2, 3, 0, 1)); \
+        D0 = _mm256_permute4x64_epi64(tmp2, _MM_SHUFFLE(2, 3, 0, 1)); \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1) \
+    do { \
+        G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+        G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+        DIAGONALIZE_1_AVX2(A0, B0, C0, D0, A1, B1, C1, D1); \
+        G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+        G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+        UNDIAGONALIZE_1_AVX2(A0, B0, C0, D0, A1, B1, C1, D1); \
+    } while ((void)0, 0)
+
+#define BLAKE2_ROUND_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1) \
+    do { \
+        G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+        G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+        DIAGONALIZE_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+        G1_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+        G2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+        UNDIAGONALIZE_2_AVX2(A0, A1, B0, B1, C0, C1, D0, D1); \
+    } while ((void)0, 0)
+
+#endif
@@ -1,4 +1,5 @@
 
+#include <x86intrin.h>
 #include "stdio.h"
 #include "stdint.h"
 #include <time.h>
@@ -4,6 +4,7 @@
 
 
 
+#include <cstdlib>
 #include <stdio.h>
 
 
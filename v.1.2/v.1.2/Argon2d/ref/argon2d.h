@@ -50,7 +50,7 @@ const int TOO_MANY_LANES = -17;
 
 //#define KAT
 //#define KAT_INTERNAL
-const char* KAT_FILENAME = "kat-argon2d.log";
+const char* const KAT_FILENAME = "kat-argon2d.log";
 
 
 #define _MEASURE    //Whether we measure timings
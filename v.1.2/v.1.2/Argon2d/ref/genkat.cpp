@@ -1,4 +1,5 @@
 
+#include <x86intrin.h>
 #include "stdio.h"
 #include "stdint.h"
 #include <time.h>
@@ -46,7 +47,7 @@ void GenKat()
 						clock_t start = clock();
 						i2 = __rdtscp(&ui2);
 #endif
-						Argon2dRef(out, outlen, zero_array, p_len, one_array, s_len, NULL, 0, NULL, 0, t_cost, m_cost, thr);
+						Argon2d(out, outlen, zero_array, p_len, one_array, s_len, NULL, 0, NULL, 0, t_cost, m_cost, thr);
 #ifdef _MEASURE
 						i3 = __rdtscp(&ui3);
 						clock_t finish = clock();
@@ -96,7 +97,7 @@ void Benchmark()  //Benchmarks Argon with salt length 16, password length 128, t
 			i2 = __rdtscp(&ui2);
 #endif
 
-			Argon2dRef(out, outlen, zero_array, inlen, one_array, saltlen, NULL, 0, NULL, 0, t_cost, m_cost, thread_n);
+			Argon2d(out, outlen, zero_array, inlen, one_array, saltlen, NULL, 0, NULL, 0, t_cost, m_cost, thread_n);
 
 #ifdef _MEASURE
 			i3 = __rdtscp(&ui3);